@@ -0,0 +1,127 @@
+#include "harness.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <fmt/core.h>
+
+namespace {
+
+// Two-sided 95% Student-t quantiles for 1 to 30 degrees of freedom
+const double T_QUANTILES[] = {
+    12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+    2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+    2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042
+};
+
+double tQuantile(size_t degreesOfFreedom) {
+    if (degreesOfFreedom == 0) {
+        return 0.0;
+    }
+    return degreesOfFreedom <= 30 ? T_QUANTILES[degreesOfFreedom - 1] : 1.96;
+}
+
+double quartile(const std::vector<double>& sorted, double q) {
+    double position = q * static_cast<double>(sorted.size() - 1);
+    size_t below = static_cast<size_t>(position);
+    size_t above = std::min(below + 1, sorted.size() - 1);
+    double fraction = position - static_cast<double>(below);
+    return sorted[below] + (sorted[above] - sorted[below]) * fraction;
+}
+
+}
+
+BenchResult summarize(const std::string& name, size_t itemsPerOp, std::vector<double> sampleNs) {
+    BenchResult result;
+    result.name = name;
+    result.itemsPerOp = itemsPerOp;
+    if (sampleNs.empty()) {
+        return result;
+    }
+
+    std::sort(sampleNs.begin(), sampleNs.end());
+    double q1 = quartile(sampleNs, 0.25);
+    double q3 = quartile(sampleNs, 0.75);
+    double low = q1 - 1.5 * (q3 - q1);
+    double high = q3 + 1.5 * (q3 - q1);
+
+    std::vector<double> kept;
+    for (double sample : sampleNs) {
+        if (sample >= low && sample <= high) {
+            kept.push_back(sample);
+        }
+    }
+    result.samples = kept.size();
+    result.rejected = sampleNs.size() - kept.size();
+
+    double sum = 0.0;
+    for (double sample : kept) {
+        sum += sample;
+    }
+    double n = static_cast<double>(kept.size());
+    result.meanNs = sum / n;
+    double squaredDeviation = 0.0;
+    for (double sample : kept) {
+        squaredDeviation += (sample - result.meanNs) * (sample - result.meanNs);
+    }
+    result.sdNs = kept.size() > 1 ? std::sqrt(squaredDeviation / (n - 1.0)) : 0.0;
+    result.ciNs = tQuantile(kept.size() - 1) * result.sdNs / std::sqrt(n);
+    result.minNs = kept.front();
+    return result;
+}
+
+void writeBaseline(const std::string& path, const std::vector<BenchResult>& results) {
+    std::ofstream file(path);
+    if (!file) {
+        throw std::runtime_error(fmt::format("Failed to write baseline: {}", path));
+    }
+    file << "{\"benchmarks\":[";
+    for (size_t i = 0; i < results.size(); ++i) {
+        const BenchResult& result = results[i];
+        file << fmt::format("{}\n  {{\"name\":\"{}\",\"mean_ns\":{:.3f},\"ci_ns\":{:.3f},\"sd_ns\":{:.3f},\"samples\":{}}}",
+            i == 0 ? "" : ",", result.name, result.meanNs, result.ciNs, result.sdNs, result.samples);
+    }
+    file << "\n]}\n";
+}
+
+std::map<std::string, BaselineEntry> readBaseline(const std::string& path) {
+    std::ifstream file(path);
+    if (!file) {
+        throw std::runtime_error(fmt::format("Failed to read baseline: {}", path));
+    }
+    std::stringstream buffer;
+    buffer << file.rdbuf();
+    std::string text = buffer.str();
+
+    // Only what writeBaseline produces: one flat object per benchmark
+    auto numberAfter = [&](const std::string& key, size_t from, size_t to) {
+        size_t at = text.find("\"" + key + "\":", from);
+        if (at == std::string::npos || at > to) {
+            return 0.0;
+        }
+        return std::stod(text.substr(at + key.size() + 3));
+    };
+
+    std::map<std::string, BaselineEntry> entries;
+    size_t position = 0;
+    while ((position = text.find("{\"name\":\"", position)) != std::string::npos) {
+        size_t nameBegin = position + 9;
+        size_t nameEnd = text.find('"', nameBegin);
+        size_t objectEnd = text.find('}', nameEnd);
+        if (nameEnd == std::string::npos || objectEnd == std::string::npos) {
+            break;
+        }
+        BaselineEntry entry;
+        entry.meanNs = numberAfter("mean_ns", nameEnd, objectEnd);
+        entry.ciNs = numberAfter("ci_ns", nameEnd, objectEnd);
+        entries[text.substr(nameBegin, nameEnd - nameBegin)] = entry;
+        position = objectEnd;
+    }
+    return entries;
+}
+
+bool isRegression(const BenchResult& result, const BaselineEntry& baseline, double threshold) {
+    return result.meanNs - result.ciNs > (baseline.meanNs + baseline.ciNs) * (1.0 + threshold);
+}
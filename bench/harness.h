@@ -0,0 +1,93 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <map>
+#include <string>
+#include <vector>
+
+inline const void* volatile benchSink = nullptr;
+
+// Keeps the compiler from discarding a value that is never used
+template <typename T>
+void doNotOptimize(const T& value) {
+    benchSink = &value;
+    std::atomic_signal_fence(std::memory_order_seq_cst);
+}
+
+struct BenchConfig {
+    std::chrono::milliseconds warmup{ 100 };
+    int samples = 30;
+    std::chrono::microseconds minSampleTime{ 2000 };  // Each sample repeats the op at least this long
+};
+
+struct BenchResult {
+    std::string name;
+    size_t itemsPerOp = 1;  // Balls, vertices or draws handled by one op
+    size_t samples = 0;     // Kept after outlier rejection
+    size_t rejected = 0;
+    double meanNs = 0.0;    // Per op
+    double sdNs = 0.0;
+    double ciNs = 0.0;      // Half-width of the 95% confidence interval of the mean
+    double minNs = 0.0;
+};
+
+// Per-op times of each sample -> statistics. Samples outside Tukey's fences
+// (1.5 IQR beyond the quartiles) are dropped as interference before the mean,
+// standard deviation and Student-t confidence interval are computed.
+BenchResult summarize(const std::string& name, size_t itemsPerOp, std::vector<double> sampleNs);
+
+// Times `op` after a warmup: calibrates a repeat count so one sample lasts at
+// least minSampleTime, then takes `samples` samples.
+template <typename Op>
+BenchResult runBench(const BenchConfig& config, const std::string& name, size_t itemsPerOp, Op&& op) {
+    using Clock = std::chrono::steady_clock;
+
+    auto warmupEnd = Clock::now() + config.warmup;
+    size_t repeats = 1;
+    while (Clock::now() < warmupEnd) {
+        auto begin = Clock::now();
+        for (size_t i = 0; i < repeats; ++i) {
+            op();
+        }
+        if (Clock::now() - begin < config.minSampleTime) {
+            repeats *= 2;
+        }
+    }
+    for (;;) {
+        auto begin = Clock::now();
+        for (size_t i = 0; i < repeats; ++i) {
+            op();
+        }
+        if (Clock::now() - begin >= config.minSampleTime) {
+            break;
+        }
+        repeats *= 2;
+    }
+
+    std::vector<double> sampleNs;
+    for (int sample = 0; sample < config.samples; ++sample) {
+        auto begin = Clock::now();
+        for (size_t i = 0; i < repeats; ++i) {
+            op();
+        }
+        auto elapsed = std::chrono::duration<double, std::nano>(Clock::now() - begin).count();
+        sampleNs.push_back(elapsed / static_cast<double>(repeats));
+    }
+    return summarize(name, itemsPerOp, std::move(sampleNs));
+}
+
+struct BaselineEntry {
+    double meanNs = 0.0;
+    double ciNs = 0.0;
+};
+
+void writeBaseline(const std::string& path, const std::vector<BenchResult>& results);
+// Reads a file written by writeBaseline; throws when it cannot be opened
+std::map<std::string, BaselineEntry> readBaseline(const std::string& path);
+
+// A regression is a slowdown beyond `threshold` (0.05 = 5%) that survives the
+// noise: even the low end of the new confidence interval is slower than the
+// high end of the baseline's, scaled by the threshold.
+bool isRegression(const BenchResult& result, const BaselineEntry& baseline, double threshold);
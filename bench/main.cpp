@@ -0,0 +1,320 @@
+﻿#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <fmt/core.h>
+
+#include "harness.h"
+#include "obstacles.h"
+#include "render_data.h"
+#include "simulation.h"
+#include "spatial_grid.h"
+#include "verify.h"
+
+namespace {
+
+const size_t BALL_COUNT = 4096;
+const float WALL_RADIUS = 0.8f;
+const float DELTA_TIME = 1.0f / 60.0f;
+
+const char* USAGE =
+    "Usage: BrainrotBench [options]\n"
+    "  --filter TEXT        run only benchmarks whose name contains TEXT\n"
+    "  --samples N          samples per benchmark (default 30)\n"
+    "  --save FILE          write the results as a JSON baseline\n"
+    "  --baseline FILE      compare against a JSON baseline; exit 1 on regression\n"
+    "  --threshold PERCENT  slowdown that counts as a regression (default 5)\n"
+    "  --verify [TICKS]     instead of timing, check every update path against the\n"
+    "                       reference for TICKS ticks (default 600), and the stepper's\n"
+    "                       merge, rule and species modes across worker counts and\n"
+    "                       neighbor lists against grid queries; exit 1 on divergence\n"
+    "  --tolerance EPS      per-field difference --verify accepts (default 0, bit-exact)";
+
+struct Benchmark {
+    std::string name;
+    size_t itemsPerOp;
+    std::function<void()> op;
+};
+
+// Balls spread over the disk, with `hitFraction` of them just past the wall so
+// the wall pass takes the bounce branch for them, in random order
+std::vector<Ball> ballsWithHits(double hitFraction, uint32_t seed) {
+    std::mt19937 gen(seed);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    std::vector<Ball> balls(BALL_COUNT);
+    for (size_t i = 0; i < balls.size(); ++i) {
+        Ball& ball = balls[i];
+        bool hit = static_cast<double>(i) < hitFraction * static_cast<double>(balls.size());
+        float angle = unit(gen) * 6.2831853f;
+        float distance = hit ? WALL_RADIUS : std::sqrt(unit(gen)) * (WALL_RADIUS - 2.0f * BALL_RADIUS);
+        ball.x = distance * std::cos(angle);
+        ball.y = distance * std::sin(angle);
+        ball.dx = unit(gen) - 0.5f;
+        ball.dy = unit(gen) - 0.5f;
+        ball.addedMomentum = 1.05f;
+        setColorAt(ball, ball.x, ball.y, WALL_RADIUS);
+    }
+    std::shuffle(balls.begin(), balls.end(), gen);
+    return balls;
+}
+
+std::vector<Benchmark> allBenchmarks() {
+    std::vector<Benchmark> benchmarks;
+
+    // The balls drift off as the op repeats; integration has no branches, so timing does not depend on it
+    auto moving = std::make_shared<std::vector<Ball>>(ballsWithHits(0.0, 1));
+    benchmarks.push_back({ "integrate", BALL_COUNT, [moving] {
+        for (auto& ball : *moving) {
+            integrateBall(ball, DELTA_TIME * SIMULATION_SPEED, GRAVITY);
+        }
+        doNotOptimize(moving->front());
+    } });
+
+    // Bounces are applied to a copy so every op sees the same hit pattern
+    for (double hitFraction : { 0.0, 0.01, 0.1, 0.5 }) {
+        auto balls = std::make_shared<std::vector<Ball>>(ballsWithHits(hitFraction, 2));
+        benchmarks.push_back({ fmt::format("wall/hits-{}%", hitFraction * 100.0), BALL_COUNT, [balls] {
+            float sum = 0.0f;
+            for (const auto& original : *balls) {
+                float distanceFromCenter = std::sqrt(original.x * original.x + original.y * original.y);
+                if (distanceFromCenter + BALL_RADIUS > WALL_RADIUS) {
+                    Ball ball = original;
+                    bounceOffWall(ball, WALL_RADIUS, distanceFromCenter, 0x1234u, CENTER_BIAS);
+                    sum += ball.dx;
+                }
+            }
+            doNotOptimize(sum);
+        } });
+    }
+
+    auto colored = std::make_shared<std::vector<Ball>>(ballsWithHits(0.0, 3));
+    benchmarks.push_back({ "color", BALL_COUNT, [colored] {
+        for (auto& ball : *colored) {
+            setColorAt(ball, ball.x, ball.y, WALL_RADIUS);
+            limitSpeed(ball);
+        }
+        doNotOptimize(colored->front());
+    } });
+
+    auto parents = std::make_shared<std::vector<Ball>>(ballsWithHits(0.1, 4));
+    auto duplicates = std::make_shared<SpawnBuffer>();
+    benchmarks.push_back({ "spawn/duplicates", BALL_COUNT / 10, [parents, duplicates] {
+        duplicates->clear();
+        for (size_t i = 0; i < BALL_COUNT / 10; ++i) {
+            duplicates->push_back(createDuplicateBall((*parents)[i], DUPLICATE_MOMENTUM));
+        }
+        doNotOptimize(duplicates->back());
+    } });
+
+    auto kernelBalls = std::make_shared<std::vector<Ball>>(ballsWithHits(0.01, 5));
+    auto kernelDuplicates = std::make_shared<SpawnBuffer>();
+    auto tick = std::make_shared<uint64_t>(0);
+    benchmarks.push_back({ "kernel/update-range", BALL_COUNT, [kernelBalls, kernelDuplicates, tick] {
+        kernelDuplicates->clear();
+        updateBallRange(kernelBalls->data(), kernelBalls->size(), WALL_RADIUS, DELTA_TIME,
+            tickSeed(1, (*tick)++), *kernelDuplicates);
+        doNotOptimize(kernelBalls->front());
+    } });
+
+    // One calm tick of grid maintenance, with a few percent of the balls changing cell: the grid follows
+    // the balls back and forth between the two states
+    auto before = std::make_shared<std::vector<Ball>>(ballsWithHits(0.0, 8));
+    auto after = std::make_shared<std::vector<Ball>>(*before);
+    for (auto& ball : *after) {
+        integrateBall(ball, 0.25f * DELTA_TIME * SIMULATION_SPEED, GRAVITY);
+    }
+    for (bool incremental : { false, true }) {
+        auto grid = std::make_shared<SpatialGrid>(WALL_RADIUS, 4.0f * BALL_RADIUS);
+        grid->build(before->data(), before->size());
+        auto flip = std::make_shared<bool>(false);
+        benchmarks.push_back({ incremental ? "grid/update" : "grid/rebuild", BALL_COUNT,
+            [before, after, grid, flip, incremental] {
+            const auto& balls = (*flip = !*flip) ? *after : *before;
+            if (incremental) {
+                grid->update(balls.data(), balls.size());
+            }
+            else {
+                grid->build(balls.data(), balls.size());
+            }
+            doNotOptimize(grid->cellEnd(0));
+        } });
+    }
+
+    // Same peg spacing over a growing area: the per-ball cost should not follow the peg count
+    for (int side : { 10, 100 }) {
+        const float spacing = 0.05f;
+        float half = 0.5f * spacing * static_cast<float>(side);
+        std::vector<Obstacle> pegs;
+        for (int row = 0; row < side; ++row) {
+            for (int column = 0; column < side; ++column) {
+                float x = (static_cast<float>(column) + 0.5f) * spacing - half;
+                float y = (static_cast<float>(row) + 0.5f) * spacing - half;
+                pegs.push_back({ x, y, x, y, 0.005f });
+            }
+        }
+        auto field = std::make_shared<ObstacleField>(std::move(pegs));
+        auto scattered = std::make_shared<std::vector<Ball>>(ballsWithHits(0.0, 7));
+        for (auto& ball : *scattered) {
+            ball.x *= half / WALL_RADIUS;
+            ball.y *= half / WALL_RADIUS;
+        }
+        benchmarks.push_back({ fmt::format("obstacles/pegs-{}", side * side), BALL_COUNT, [field, scattered] {
+            int hits = 0;
+            for (const auto& original : *scattered) {
+                Ball ball = original;
+                hits += field->collide(ball) ? 1 : 0;
+            }
+            doNotOptimize(hits);
+        } });
+    }
+
+    for (int segments : { 32, 100 }) {
+        benchmarks.push_back({ fmt::format("vertices/circle-{}", segments), static_cast<size_t>(segments + 1), [segments] {
+            VertexBuffer vertices = createCircleVertices(BALL_RADIUS, segments);
+            doNotOptimize(vertices.back());
+        } });
+    }
+
+    benchmarks.push_back({ "rng/random-ball", 1, [] {
+        Ball ball = createRandomBall(WALL_RADIUS);
+        doNotOptimize(ball);
+    } });
+    benchmarks.push_back({ "rng/ball-at", 1, [] {
+        Ball ball = createBallAt(0.1f, 0.2f, WALL_RADIUS);
+        doNotOptimize(ball);
+    } });
+    auto bulk = std::make_shared<std::vector<Ball>>(BALL_COUNT);
+    auto stream = std::make_shared<uint64_t>(0);
+    benchmarks.push_back({ "rng/random-balls", BALL_COUNT, [bulk, stream] {
+        createRandomBalls(bulk->data(), bulk->size(), WALL_RADIUS, (*stream)++);
+        doNotOptimize(bulk->back());
+    } });
+
+    auto store = std::make_shared<BallStore>(BallStore::partitioned(0));
+    for (const auto& ball : ballsWithHits(0.0, 6)) {
+        store->slabs[0].balls.push_back(ball);
+    }
+    auto instances = std::make_shared<InstanceBuffer>();
+    benchmarks.push_back({ "pack/instances", BALL_COUNT, [store, instances] {
+        packInstances(*store, *instances);
+        doNotOptimize(instances->back());
+    } });
+
+    return benchmarks;
+}
+
+}
+
+int main(int argc, char* argv[])
+{
+    BenchConfig config;
+    std::string filter;
+    std::string savePath;
+    std::string baselinePath;
+    double threshold = 0.05;
+    bool verify = false;
+    VerifyConfig verifyConfig;
+    try {
+        for (int i = 1; i < argc; ++i) {
+            std::string arg = argv[i];
+            bool hasValue = i + 1 < argc;
+            if (arg == "--filter" && hasValue) {
+                filter = argv[++i];
+            }
+            else if (arg == "--samples" && hasValue) {
+                config.samples = std::max(2, std::stoi(argv[++i]));
+            }
+            else if (arg == "--save" && hasValue) {
+                savePath = argv[++i];
+            }
+            else if (arg == "--baseline" && hasValue) {
+                baselinePath = argv[++i];
+            }
+            else if (arg == "--threshold" && hasValue) {
+                threshold = std::stod(argv[++i]) / 100.0;
+            }
+            else if (arg == "--verify") {
+                verify = true;
+                if (hasValue && argv[i + 1][0] != '-') {
+                    verifyConfig.ticks = std::max(1, std::stoi(argv[++i]));
+                }
+            }
+            else if (arg == "--tolerance" && hasValue) {
+                verifyConfig.tolerance = std::stof(argv[++i]);
+            }
+            else {
+                throw std::runtime_error(fmt::format("Unknown or incomplete option: {}", arg));
+            }
+        }
+    }
+    catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        std::cerr << USAGE << std::endl;
+        return 2;
+    }
+
+    if (verify) {
+        int failures = runVerify(verifyConfig);
+        if (failures > 0) {
+            fmt::print("{} update path(s) diverged from the reference\n", failures);
+            return 1;
+        }
+        return 0;
+    }
+
+    std::map<std::string, BaselineEntry> baseline;
+    if (!baselinePath.empty()) {
+        try {
+            baseline = readBaseline(baselinePath);
+        }
+        catch (const std::exception& e) {
+            std::cerr << e.what() << std::endl;
+            return 2;
+        }
+    }
+
+    fmt::print("{:<22} {:>12} {:>10} {:>10} {:>8} {:>12} {:>9}\n",
+        "benchmark", "ns/op", "+-95%", "ns/item", "outliers", "baseline", "change");
+    std::vector<BenchResult> results;
+    int regressions = 0;
+    for (auto& benchmark : allBenchmarks()) {
+        if (!filter.empty() && benchmark.name.find(filter) == std::string::npos) {
+            continue;
+        }
+        BenchResult result = runBench(config, benchmark.name, benchmark.itemsPerOp, benchmark.op);
+        results.push_back(result);
+
+        std::string comparison;
+        auto found = baseline.find(result.name);
+        if (found != baseline.end() && found->second.meanNs > 0.0) {
+            double change = 100.0 * (result.meanNs / found->second.meanNs - 1.0);
+            bool regressed = isRegression(result, found->second, threshold);
+            regressions += regressed ? 1 : 0;
+            comparison = fmt::format("{:>12.1f} {:>+8.1f}%{}", found->second.meanNs, change, regressed ? " REGRESSION" : "");
+        }
+        fmt::print("{:<22} {:>12.1f} {:>10.1f} {:>10.2f} {:>8} {}\n",
+            result.name, result.meanNs, result.ciNs, result.meanNs / static_cast<double>(result.itemsPerOp),
+            result.rejected, comparison);
+    }
+
+    if (!savePath.empty()) {
+        try {
+            writeBaseline(savePath, results);
+        }
+        catch (const std::exception& e) {
+            std::cerr << e.what() << std::endl;
+            return 2;
+        }
+    }
+    if (regressions > 0) {
+        fmt::print("{} benchmark(s) regressed by more than {:.0f}%\n", regressions, threshold * 100.0);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,581 @@
+#include "verify.h"
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <memory>
+#include <random>
+#include <span>
+#include <string>
+#include <vector>
+#include <fmt/core.h>
+
+#include "ball_stepper.h"
+#include "neighbor_list.h"
+#include "numa.h"
+#include "profiler.h"
+#include "rules.h"
+#include "scheduler.h"
+#include "simulation.h"
+#include "spatial_grid.h"
+#include "species.h"
+#include "state_hash.h"
+#include "thread_pool.h"
+
+namespace {
+
+const float WALL_RADIUS = 0.8f;
+const float DELTA_TIME = 1.0f / 60.0f;
+const uint32_t SESSION_SEED = 0x2545f491u;
+const size_t CHUNK_BALLS = 1500;  // Splits the chunked path so the cap crosses chunk borders
+
+// Advances `balls` by one tick and returns the wall hits
+using UpdatePath = std::function<size_t(std::vector<Ball>& balls, uint32_t seed, const SimParams& params)>;
+
+struct Scenario {
+    std::string name;
+    size_t ballCount;
+    int ticks;  // Upper bound; large populations make the reference quadratic
+};
+
+std::vector<Ball> seededBalls(size_t count, uint32_t seed) {
+    std::mt19937 gen(seed);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    std::vector<Ball> balls(count);
+    for (auto& ball : balls) {
+        float angle = unit(gen) * 6.2831853f;
+        float distance = std::sqrt(unit(gen)) * (WALL_RADIUS - BALL_RADIUS);
+        ball.x = distance * std::cos(angle);
+        ball.y = distance * std::sin(angle);
+        ball.dx = unit(gen) * 0.5f - 0.25f;
+        ball.dy = unit(gen) * 0.5f - 0.25f;
+        ball.addedMomentum = 1.05f;
+        setColorAt(ball, ball.x, ball.y, WALL_RADIUS);
+    }
+    return balls;
+}
+
+// Parameters change partway through so both defaults and overrides are covered
+SimParams paramsAt(int tick) {
+    SimParams params;
+    if (tick % 200 >= 100) {
+        params.gravity = 0.6f;
+        params.centerBias = 0.8f;
+    }
+    return params;
+}
+
+// updateBallRange over fixed-size chunks, applying the cap in chunk order
+size_t chunkedUpdate(std::vector<Ball>& balls, uint32_t seed, const SimParams& params) {
+    std::vector<SpawnBuffer> duplicates((balls.size() + CHUNK_BALLS - 1) / CHUNK_BALLS);
+    size_t wallHits = 0;
+    for (size_t chunk = 0; chunk < duplicates.size(); ++chunk) {
+        size_t begin = chunk * CHUNK_BALLS;
+        wallHits += updateBallRange(balls.data() + begin, std::min(CHUNK_BALLS, balls.size() - begin),
+            WALL_RADIUS, DELTA_TIME, seed, duplicates[chunk], params);
+    }
+    size_t budget = MAX_BALLS > balls.size() ? MAX_BALLS - balls.size() : 0;
+    for (const auto& chunk : duplicates) {
+        size_t accepted = std::min(budget, chunk.size());
+        balls.insert(balls.end(), chunk.begin(), chunk.begin() + accepted);
+        budget -= accepted;
+    }
+    return wallHits;
+}
+
+Task<void> stepInto(BallStepper& stepper, const BallStore& previous, BallStore& next, uint32_t seed,
+    SimParams params, size_t& wallHits) {
+    wallHits = co_await stepper.step(previous, next, {}, WALL_RADIUS, DELTA_TIME, seed, params);
+}
+
+// The pooled stepper with one slab; with several slabs the cap is applied in
+// slab order, which is not the reference order
+struct StepperPath {
+    ThreadPool pool;
+    Profiler profiler;
+    NumaTopology topology;
+    BallStepper stepper;
+    BallStore stores[2];
+
+    explicit StepperPath(unsigned workers)
+        : pool(workers), stepper(pool, profiler, topology) {
+        stores[0] = BallStore::partitioned(0);
+        stores[1] = BallStore::partitioned(0);
+    }
+
+    size_t update(std::vector<Ball>& balls, uint32_t seed, const SimParams& params) {
+        stores[0].slabs[0].balls.assign(balls.begin(), balls.end());
+        size_t wallHits = 0;
+        auto done = std::make_shared<Event>(pool);
+        launch(stepInto(stepper, stores[0], stores[1], seed, params, wallHits), done);
+        done->wait();
+        balls.assign(stores[1].slabs[0].balls.begin(), stores[1].slabs[0].balls.end());
+        return wallHits;
+    }
+};
+
+// A BallStepper mode whose result must not depend on the number of workers
+struct StepperScenario {
+    std::string name;
+    size_t ballCount;
+    int ticks;
+    std::string species;  // As for --species
+    std::vector<Rule> rules;
+    bool coalesce = false;
+    bool deletes = false;       // Delete brushes every 7th tick
+    bool trackHandles = false;  // Checks every ball's handle after each tick
+};
+
+Task<void> populateStore(BallStepper& stepper, BallStore& store, size_t count) {
+    co_await stepper.populate(store, count, WALL_RADIUS, SESSION_SEED);
+}
+
+Task<void> stepStore(BallStepper& stepper, const BallStore& previous, BallStore& next, uint32_t seed,
+    SimParams params, std::vector<Brush> brushes) {
+    co_await stepper.step(previous, next, {}, WALL_RADIUS, DELTA_TIME, seed, params, std::move(brushes));
+}
+
+// Two overlapping deletes and a third elsewhere, so slabs lose balls from
+// the middle and the balls behind the first one removed move up
+std::vector<Brush> deleteBrushesAt(int tick) {
+    if (tick % 7 != 3) {
+        return {};
+    }
+    Brush brush;
+    brush.tool = BrushTool::Delete;
+    brush.x = 0.3f;
+    brush.y = -0.2f;
+    brush.radius = 0.2f;
+    std::vector<Brush> brushes = { brush, brush };
+    brush.x = -0.4f;
+    brushes.push_back(brush);
+    return brushes;
+}
+
+// The stepper in a scenario's mode on its own pool, with one slab per species
+struct ScenarioStepper {
+    ThreadPool pool;
+    Profiler profiler;
+    NumaTopology topology;
+    BallStepper stepper;
+    BallStore stores[2];
+    int current = 0;
+    bool coalesce;
+    bool deletes;
+    bool trackHandles;
+
+    ScenarioStepper(unsigned workers, const StepperScenario& scenario)
+        : pool(workers), stepper(pool, profiler, topology), coalesce(scenario.coalesce), deletes(scenario.deletes),
+          trackHandles(scenario.trackHandles) {
+        stepper.setSpecies(parseSpecies(scenario.species));
+        if (!scenario.rules.empty()) {
+            stepper.setRules(compileRules(scenario.rules, stepper.getSpecies()));
+        }
+        stepper.setTrackHandles(trackHandles);
+        int speciesCount = static_cast<int>(stepper.getSpecies().size());
+        stores[0] = BallStore::partitioned(0, speciesCount);
+        stores[1] = BallStore::partitioned(0, speciesCount);
+        run(populateStore(stepper, stores[0], scenario.ballCount));
+    }
+
+    void step(int tick) {
+        SimParams params = paramsAt(tick);
+        params.coalesce = coalesce;
+        run(stepStore(stepper, stores[current], stores[1 - current], tickSeed(SESSION_SEED, static_cast<uint64_t>(tick)),
+            params, deletes ? deleteBrushesAt(tick) : std::vector<Brush>{}));
+        current = 1 - current;
+    }
+
+    void run(Task<void> task) {
+        auto done = std::make_shared<Event>(pool);
+        launch(std::move(task), done);
+        done->wait();
+    }
+
+    const BallStore& store() const { return stores[current]; }
+};
+
+// Hash of a store, optionally with every ball's color left out
+uint64_t storeHash(const BallStore& store, bool colors) {
+    if (colors) {
+        return hashStore(store);
+    }
+    std::vector<Ball> balls;
+    for (const auto& slab : store.slabs) {
+        balls.insert(balls.end(), slab.balls.begin(), slab.balls.end());
+    }
+    for (auto& ball : balls) {
+        ball.r = ball.g = ball.b = 0.0f;
+    }
+    return hashBalls(balls.data(), balls.size());
+}
+
+// Prints where two stores first differ
+void describeDivergence(const BallStore& expected, const BallStore& actual, const std::string& expectedName,
+    const std::string& pathName) {
+    for (size_t i = 0; i < std::min(expected.slabs.size(), actual.slabs.size()); ++i) {
+        const auto& expectedBalls = expected.slabs[i].balls;
+        const auto& actualBalls = actual.slabs[i].balls;
+        if (expectedBalls.size() != actualBalls.size()) {
+            fmt::print("  slab {} balls: {} {}, {} {}\n", i, expectedName, expectedBalls.size(), pathName,
+                actualBalls.size());
+            return;
+        }
+        size_t index = firstDivergence(expectedBalls.data(), actualBalls.data(), expectedBalls.size(), 0.0f);
+        if (index < expectedBalls.size()) {
+            fmt::print("  slab {} first diverging ball {}\n    {:<9} {}\n    {:<9} {}\n", i, index,
+                expectedName, describeBall(expectedBalls[index]), pathName, describeBall(actualBalls[index]));
+            return;
+        }
+    }
+}
+
+// Empty when every ball's handle resolves to its slab and index and no other
+// handle is live; otherwise the first problem found
+std::string handleProblem(const ScenarioStepper& path) {
+    const BallStore& store = path.store();
+    const BallHandles& handles = path.stepper.getHandles();
+    for (size_t s = 0; s < store.slabs.size(); ++s) {
+        const BallSlab& slab = store.slabs[s];
+        if (slab.handles.size() != slab.balls.size()) {
+            return fmt::format("slab {} has {} handles for {} balls", s, slab.handles.size(), slab.balls.size());
+        }
+        for (size_t b = 0; b < slab.handles.size(); ++b) {
+            BallHandles::Location location;
+            if (!handles.find(slab.handles[b], location)) {
+                return fmt::format("handle {:x} of slab {} ball {} is not live", slab.handles[b], s, b);
+            }
+            if (location.slab != s || location.index != b) {
+                return fmt::format("handle {:x} of slab {} ball {} resolves to slab {} ball {}", slab.handles[b], s,
+                    b, location.slab, location.index);
+            }
+        }
+    }
+    if (handles.size() != store.size()) {
+        return fmt::format("{} live handles for {} balls", handles.size(), store.size());
+    }
+    return "";
+}
+
+// Hash of every slab's handles in ball order
+uint64_t handleHash(const BallStore& store) {
+    uint64_t hash = 1469598103934665603ull;
+    for (const auto& slab : store.slabs) {
+        for (BallHandle handle : slab.handles) {
+            hash = (hash ^ handle) * 1099511628211ull;
+        }
+    }
+    return hash;
+}
+
+// Steps two steppers side by side and compares their stores bit for bit after
+// populating and after every tick, and their handles when they track them
+bool verifySteppers(const std::string& name, ScenarioStepper& expected, const std::string& expectedName,
+    ScenarioStepper& actual, const std::string& pathName, int ticks, bool colors = true) {
+    for (int tick = 0; tick <= ticks; ++tick) {
+        if (tick > 0) {
+            expected.step(tick - 1);
+            actual.step(tick - 1);
+        }
+        if (storeHash(expected.store(), colors) != storeHash(actual.store(), colors)) {
+            fmt::print("FAIL {} / {}: diverged {}\n", name, pathName,
+                tick == 0 ? "after populating" : fmt::format("at tick {}", tick - 1));
+            describeDivergence(expected.store(), actual.store(), expectedName, pathName);
+            return false;
+        }
+        if (!expected.trackHandles) {
+            continue;
+        }
+        std::string when = tick == 0 ? "after populating" : fmt::format("at tick {}", tick - 1);
+        for (const auto& [path, label] : { std::pair{ &expected, expectedName }, std::pair{ &actual, pathName } }) {
+            std::string problem = handleProblem(*path);
+            if (!problem.empty()) {
+                fmt::print("FAIL {} / {}: {} {}\n", name, label, problem, when);
+                return false;
+            }
+        }
+        if (handleHash(expected.store()) != handleHash(actual.store())) {
+            fmt::print("FAIL {} / {}: handles diverged {}\n", name, pathName, when);
+            return false;
+        }
+    }
+    fmt::print("ok   {} / {}: {} ticks, {} balls, hash {:016x}\n", name, pathName, ticks,
+        actual.store().size(), storeHash(actual.store(), colors));
+    return true;
+}
+
+// The scenario on one worker against config.workers
+bool verifyWorkers(const StepperScenario& scenario, const VerifyConfig& config) {
+    ScenarioStepper single(1, scenario);
+    ScenarioStepper pooled(config.workers, scenario);
+    return verifySteppers(scenario.name, single, "1 worker", pooled, fmt::format("{} workers", config.workers),
+        std::min(config.ticks, scenario.ticks));
+}
+
+// The scenario with neighbor lists against a grid query for every ball
+bool verifyNeighborLists(const StepperScenario& scenario, const VerifyConfig& config) {
+    ScenarioStepper grid(config.workers, scenario);
+    grid.stepper.setNeighborLists(false);
+    ScenarioStepper lists(config.workers, scenario);
+    return verifySteppers(scenario.name, grid, "grid", lists, "neighbor lists", std::min(config.ticks, scenario.ticks));
+}
+
+bool findsPairs(const StepperScenario& scenario) {
+    return scenario.coalesce || std::any_of(scenario.rules.begin(), scenario.rules.end(), [](const Rule& rule) {
+        return rule.trigger == RuleTrigger::Contact;
+    });
+}
+
+// The balls touching balls[i] among `candidates`, ascending
+void touching(const std::vector<Ball>& balls, size_t i, std::span<const uint32_t> candidates,
+    std::vector<uint32_t>& out) {
+    out.clear();
+    for (uint32_t j : candidates) {
+        float dx = balls[j].x - balls[i].x;
+        float dy = balls[j].y - balls[i].y;
+        float contact = balls[i].radius + balls[j].radius;
+        if (j != i && dx * dx + dy * dy < contact * contact) {
+            out.push_back(j);
+        }
+    }
+    std::sort(out.begin(), out.end());
+}
+
+// Each cell's ball indices, ascending
+std::vector<std::vector<uint32_t>> cellContents(const SpatialGrid& grid) {
+    int cells = grid.cellsPerSide() * grid.cellsPerSide();
+    std::vector<std::vector<uint32_t>> contents(static_cast<size_t>(cells));
+    for (int cell = 0; cell < cells; ++cell) {
+        contents[cell].assign(grid.entries() + grid.cellStart(cell), grid.entries() + grid.cellEnd(cell));
+        std::sort(contents[cell].begin(), contents[cell].end());
+    }
+    return contents;
+}
+
+// Keeps one grid current with update() while balls move and duplicates spawn,
+// and checks after every tick that each cell holds the balls a fresh build()
+// files there. Every 50th tick mirrors the balls, so nearly all of them change
+// cell and update() has to give up and rebuild.
+bool verifyGridUpdates(const VerifyConfig& config) {
+    const std::string name = "grid-updates-600";
+    const float cellSize = 4.0f * BALL_RADIUS;
+    std::vector<Ball> balls = seededBalls(600, SESSION_SEED);
+    SpatialGrid updated(WALL_RADIUS, cellSize);
+    SpatialGrid fresh(WALL_RADIUS, cellSize);
+    int ticks = std::min(config.ticks, 400);
+    int inPlace = 0;
+    int appended = 0;
+    int rebuilt = 0;
+    for (int tick = 0; tick < ticks; ++tick) {
+        size_t previous = balls.size();
+        updateBalls(balls, WALL_RADIUS, DELTA_TIME / 4.0f, tickSeed(SESSION_SEED, static_cast<uint64_t>(tick)),
+            paramsAt(tick));
+        if (tick % 50 == 49) {
+            for (Ball& ball : balls) {
+                ball.x = -ball.x;
+            }
+        }
+        if (updated.update(balls.data(), balls.size())) {
+            rebuilt++;
+        }
+        else {
+            inPlace++;
+            appended += balls.size() > previous ? 1 : 0;
+        }
+
+        fresh.build(balls.data(), balls.size());
+        auto expected = cellContents(fresh);
+        auto actual = cellContents(updated);
+        for (size_t cell = 0; cell < expected.size(); ++cell) {
+            if (actual[cell] != expected[cell]) {
+                fmt::print("FAIL {} / grid update: cell {} at tick {} holds {} balls, a build files {}\n",
+                    name, cell, tick, actual[cell].size(), expected[cell].size());
+                return false;
+            }
+        }
+    }
+    if (inPlace == 0 || appended == 0 || rebuilt == 0) {
+        fmt::print("FAIL {} / grid update: {} ticks updated in place, {} of them with new balls, {} rebuilt\n",
+            name, inPlace, appended, rebuilt);
+        return false;
+    }
+    fmt::print("ok   {} / grid update: {} ticks, {} in place, {} with new balls, {} rebuilt, {} balls\n",
+        name, ticks, inPlace, appended, rebuilt, balls.size());
+    return true;
+}
+
+// Keeps skinned neighbor lists over balls moving in short ticks, rebuilt only
+// once they go stale, and checks after every tick that they give every ball
+// the same touching neighbors as a grid query. The stepper scenarios rarely
+// reuse lists, since their ball counts keep changing.
+bool verifyNeighborPairs(const VerifyConfig& config) {
+    const std::string name = "neighbor-pairs-3000";
+    std::vector<Ball> balls = seededBalls(3000, SESSION_SEED);
+    SpatialGrid listGrid;
+    SpatialGrid grid;
+    NeighborList lists;
+    std::vector<uint32_t> scratch, fromLists, fromGrid;
+    int ticks = std::min(config.ticks, 200);
+    int reused = 0;
+    size_t pairs = 0;
+    for (int tick = 0; tick < ticks; ++tick) {
+        updateBalls(balls, WALL_RADIUS, DELTA_TIME / 4.0f, tickSeed(SESSION_SEED, static_cast<uint64_t>(tick)),
+            paramsAt(tick));
+        const Ball* data = balls.data();
+        float maxRadius = 0.0f;
+        for (const Ball& ball : balls) {
+            maxRadius = std::max(maxRadius, ball.radius);
+        }
+        float cellSize = std::max(4.0f * BALL_RADIUS, 2.0f * maxRadius);
+        if (lists.stale(balls.size(), lists.drift(data, 0, balls.size()))) {
+            listGrid.reset(WALL_RADIUS, cellSize);
+            listGrid.build(data, balls.size());
+            lists.prepare(data, balls.size(), maxRadius, NEIGHBOR_SKIN, listGrid);
+            for (size_t block = 0; block < lists.blockCount(); ++block) {
+                lists.buildBlock(data, block);
+            }
+        }
+        else {
+            reused++;
+        }
+
+        grid.reset(WALL_RADIUS, cellSize);
+        grid.build(data, balls.size());
+        for (size_t i = 0; i < balls.size(); ++i) {
+            touching(balls, i, lists.of(data, i, scratch), fromLists);
+            scratch.clear();
+            grid.query(data, balls[i].x, balls[i].y, balls[i].radius + maxRadius, scratch);
+            touching(balls, i, scratch, fromGrid);
+            if (fromLists != fromGrid) {
+                fmt::print("FAIL {} / neighbor lists: ball {} at tick {} touches {} balls, the grid finds {}\n",
+                    name, i, tick, fromLists.size(), fromGrid.size());
+                return false;
+            }
+            pairs += fromGrid.size();
+        }
+    }
+    if (reused == 0) {
+        fmt::print("FAIL {} / neighbor lists: never reused in {} ticks\n", name, ticks);
+        return false;
+    }
+    fmt::print("ok   {} / neighbor lists: {} ticks, {} reused, {} touching pairs\n", name, ticks, reused, pairs / 2);
+    return true;
+}
+
+Rule makeRule(RuleTrigger trigger, RuleAction action, float chance = 1.0f) {
+    Rule rule;
+    rule.trigger = trigger;
+    rule.action = action;
+    rule.chance = chance;
+    return rule;
+}
+
+// A wall hit turns a ball of `species` into `target`
+Rule makeRecolor(const std::string& species, const std::string& target, float chance) {
+    Rule rule = makeRule(RuleTrigger::WallHit, RuleAction::Recolor, chance);
+    rule.species = species;
+    rule.target = target;
+    return rule;
+}
+
+// Returns true when the path matched the reference on every tick
+bool verifyPath(const Scenario& scenario, const std::string& pathName, const UpdatePath& update,
+    const VerifyConfig& config) {
+    std::vector<Ball> expected = seededBalls(scenario.ballCount, SESSION_SEED);
+    std::vector<Ball> actual = expected;
+    int ticks = std::min(config.ticks, scenario.ticks);
+    for (int tick = 0; tick < ticks; ++tick) {
+        uint32_t seed = tickSeed(SESSION_SEED, static_cast<uint64_t>(tick));
+        SimParams params = paramsAt(tick);
+        size_t expectedHits = updateBalls(expected, WALL_RADIUS, DELTA_TIME, seed, params);
+        size_t actualHits = update(actual, seed, params);
+
+        bool sameHash = hashBalls(expected.data(), expected.size()) == hashBalls(actual.data(), actual.size());
+        if (sameHash && expectedHits == actualHits) {
+            continue;
+        }
+        size_t common = std::min(expected.size(), actual.size());
+        size_t index = firstDivergence(expected.data(), actual.data(), common, config.tolerance);
+        if (index == common && expected.size() == actual.size() && expectedHits == actualHits) {
+            continue;  // Within tolerance
+        }
+
+        fmt::print("FAIL {} / {}: diverged at tick {}\n", scenario.name, pathName, tick);
+        if (expectedHits != actualHits) {
+            fmt::print("  wall hits: reference {}, {} {}\n", expectedHits, pathName, actualHits);
+        }
+        if (expected.size() != actual.size()) {
+            fmt::print("  balls: reference {}, {} {}\n", expected.size(), pathName, actual.size());
+        }
+        if (index < common) {
+            fmt::print("  first diverging ball {}\n    reference {}\n    {:<9} {}\n",
+                index, describeBall(expected[index]), pathName, describeBall(actual[index]));
+        }
+        return false;
+    }
+    fmt::print("ok   {} / {}: {} ticks, {} balls, hash {:016x}\n", scenario.name, pathName, ticks,
+        actual.size(), hashBalls(actual.data(), actual.size()));
+    return true;
+}
+
+}
+
+int runVerify(const VerifyConfig& config) {
+    // Below the cap duplicates are spawned every tick; above it the chunked paths split the population
+    std::vector<Scenario> scenarios = {
+        { "spawning-600", 600, config.ticks },
+        { "capped-5000", 5000, 20 },
+    };
+
+    StepperPath stepperPath(config.workers);
+    std::vector<std::pair<std::string, UpdatePath>> paths = {
+        { "chunked", chunkedUpdate },
+        { "stepper", [&](std::vector<Ball>& balls, uint32_t seed, const SimParams& params) {
+            return stepperPath.update(balls, seed, params);
+        } },
+    };
+
+    int failures = 0;
+    for (const auto& scenario : scenarios) {
+        for (const auto& [name, update] : paths) {
+            failures += verifyPath(scenario, name, update, config) ? 0 : 1;
+        }
+    }
+
+    // Merges, rule kernels and species slabs are split over workers; none may change the result
+    std::vector<StepperScenario> stepperScenarios = {
+        { "merge-20000", 20000, 100, "classic", {}, true },
+        { "rules-600", 600, 200, "classic", { makeRule(RuleTrigger::WallHit, RuleAction::Duplicate) } },
+        { "contact-rules-3000", 3000, 100, "classic", {
+            makeRule(RuleTrigger::WallHit, RuleAction::Duplicate),
+            makeRule(RuleTrigger::Contact, RuleAction::Despawn, 0.05f) } },
+        { "species-600", 600, 200, "classic,floaty,heavy:0.5,sterile", {} },
+        // Handles follow balls that brushes delete, rules despawn or move
+        // between slabs, and merges remove
+        { "handles-1500", 1500, 200, "classic,heavy", {
+            makeRule(RuleTrigger::WallHit, RuleAction::Duplicate),
+            makeRule(RuleTrigger::Contact, RuleAction::Despawn, 0.05f),
+            makeRecolor("classic", "heavy", 0.3f),
+            makeRecolor("heavy", "classic", 0.3f) }, false, true, true },
+        { "handle-merges-3000", 3000, 100, "classic,heavy", {}, true, true, true },
+    };
+    for (const auto& scenario : stepperScenarios) {
+        failures += verifyWorkers(scenario, config) ? 0 : 1;
+        if (findsPairs(scenario)) {
+            failures += verifyNeighborLists(scenario, config) ? 0 : 1;
+        }
+    }
+    failures += verifyNeighborPairs(config) ? 0 : 1;
+    failures += verifyGridUpdates(config) ? 0 : 1;
+
+    // A table holding only "wall-hit duplicate" moves balls exactly like the
+    // built-in rule; its duplicates keep their parent's color for one tick
+    StepperScenario builtIn = { "duplicate-table-600", 600, 300, "classic", {} };
+    StepperScenario table = builtIn;
+    table.rules = { makeRule(RuleTrigger::WallHit, RuleAction::Duplicate) };
+    ScenarioStepper builtInStepper(config.workers, builtIn);
+    ScenarioStepper tableStepper(config.workers, table);
+    failures += verifySteppers(builtIn.name, builtInStepper, "built-in", tableStepper, "rule table",
+        std::min(config.ticks, builtIn.ticks), false) ? 0 : 1;
+    return failures;
+}
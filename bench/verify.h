@@ -0,0 +1,19 @@
+#pragma once
+
+#include <cstdint>
+
+struct VerifyConfig {
+    int ticks = 600;
+    float tolerance = 0.0f;  // Per-field absolute difference allowed; 0 = bit-exact
+    unsigned workers = 4;    // Pool size for the BallStepper path
+};
+
+// Runs the reference update and every alternative update path from the same
+// seeded balls and compares their states after every tick, then steps the
+// BallStepper modes the reference does not cover (coalescence, rule tables,
+// several species) on one worker and on `workers` and compares those, and
+// the modes that find touching pairs with neighbor lists and with a grid
+// query per ball. Prints
+// the first diverging tick and ball of each path that disagrees. Returns the
+// number of paths that diverged.
+int runVerify(const VerifyConfig& config);
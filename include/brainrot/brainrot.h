@@ -0,0 +1,107 @@
+#pragma once
+
+// C interface to the ball simulation, for embedding it in other renderers and
+// harnesses. A world owns its balls and worker threads; views into it are
+// borrowed and stay valid until the next call that changes the world. Calls on
+// one world must not overlap. Functions returning int return BRAINROT_OK or a
+// negative error code; brainrot_last_error() describes the last failure on the
+// calling thread.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(BRAINROT_SHARED) && defined(_WIN32)
+#  ifdef BRAINROT_BUILDING
+#    define BRAINROT_API __declspec(dllexport)
+#  else
+#    define BRAINROT_API __declspec(dllimport)
+#  endif
+#elif defined(BRAINROT_SHARED)
+#  define BRAINROT_API __attribute__((visibility("default")))
+#else
+#  define BRAINROT_API
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define BRAINROT_OK 0
+#define BRAINROT_ERROR_ARGUMENT -1
+#define BRAINROT_ERROR_INTERNAL -2
+
+typedef struct brainrot_world brainrot_world;
+
+typedef struct brainrot_world_config {
+    float wall_radius;  // Radius of the circular wall (default 0.9)
+    uint32_t seed;  // Seeds brainrot_spawn_random and the bounce jitter
+    uint32_t threads;  // Worker threads; 0 = one per hardware thread
+} brainrot_world_config;
+
+// Strided view of `count` elements: element i starts at
+// (const char*)data + i * stride and holds `components` consecutive floats
+typedef struct brainrot_view {
+    const float* data;
+    size_t count;
+    size_t stride;  // Bytes between consecutive elements
+    size_t components;
+} brainrot_view;
+
+typedef struct brainrot_hit {
+    uint32_t ball;  // Index into the views after the tick
+    float x, y;  // Point on the wall
+    float speed;  // Speed at impact
+} brainrot_hit;
+
+// Called once per tick that had wall hits, with all of them. `hits` is only
+// valid during the call.
+typedef void (*brainrot_hit_callback)(void* user_data, uint64_t tick, const brainrot_hit* hits, size_t count);
+
+BRAINROT_API void brainrot_world_config_init(brainrot_world_config* config);
+
+// Returns NULL on failure
+BRAINROT_API brainrot_world* brainrot_world_create(const brainrot_world_config* config);
+BRAINROT_API void brainrot_world_destroy(brainrot_world* world);
+
+// A world holds at most 2^24 balls; spawns past that fail with BRAINROT_ERROR_ARGUMENT
+
+// Adds `count` balls spread uniformly over the disk, generated in parallel
+BRAINROT_API int brainrot_spawn_random(brainrot_world* world, size_t count);
+// Adds `count` balls at (x, y) with small random velocities, moved inside the wall if needed
+BRAINROT_API int brainrot_spawn_at(brainrot_world* world, float x, float y, size_t count);
+
+// Advances the world by `ticks` ticks of `delta_time` seconds each
+BRAINROT_API int brainrot_step(brainrot_world* world, uint32_t ticks, float delta_time);
+
+BRAINROT_API int brainrot_set_gravity(brainrot_world* world, float gravity);
+BRAINROT_API int brainrot_set_center_bias(brainrot_world* world, float center_bias);
+// Nonzero: balls that run into each other merge into one at their center of
+// mass, moving with their mass-weighted velocity. A merged ball's radius is
+// capped at 0.2, so mass and momentum past the cap are lost.
+BRAINROT_API int brainrot_set_coalesce(brainrot_world* world, int enabled);
+
+// Pass NULL to unregister
+BRAINROT_API int brainrot_set_hit_callback(brainrot_world* world, brainrot_hit_callback callback, void* user_data);
+
+BRAINROT_API size_t brainrot_ball_count(const brainrot_world* world);
+BRAINROT_API uint64_t brainrot_tick(const brainrot_world* world);
+
+// Handles name a ball for as long as it exists, while its index moves as balls
+// merge, despawn or spawn. 0 is never a handle; brainrot_ball_handle returns it
+// for an index out of range.
+BRAINROT_API uint32_t brainrot_ball_handle(const brainrot_world* world, size_t index);
+// Stores the current index of the ball named by `handle`; BRAINROT_ERROR_ARGUMENT
+// once the ball is gone
+BRAINROT_API int brainrot_find_ball(const brainrot_world* world, uint32_t handle, size_t* index);
+
+// Borrowed views into the balls: x, y / dx, dy / r, g, b / radius
+BRAINROT_API brainrot_view brainrot_positions(const brainrot_world* world);
+BRAINROT_API brainrot_view brainrot_velocities(const brainrot_world* world);
+BRAINROT_API brainrot_view brainrot_colors(const brainrot_world* world);
+BRAINROT_API brainrot_view brainrot_radii(const brainrot_world* world);
+
+BRAINROT_API const char* brainrot_last_error(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,154 @@
+#include "affinity.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <utility>
+#include <fmt/core.h>
+
+namespace {
+
+int readInt(const std::filesystem::path& path, int fallback) {
+    std::ifstream file(path);
+    int value;
+    return file >> value ? value : fallback;
+}
+
+std::string cpuListText(const std::vector<int>& cpus) {
+    if (cpus.empty()) {
+        return "any";
+    }
+    std::string text;
+    for (int cpu : cpus) {
+        text += (text.empty() ? "" : ",") + std::to_string(cpu);
+    }
+    return text;
+}
+
+}
+
+CpuTopology CpuTopology::detect() {
+    const std::filesystem::path cpuRoot("/sys/devices/system/cpu");
+
+    std::ifstream onlineFile(cpuRoot / "online");
+    std::string online;
+    std::getline(onlineFile, online);
+    std::vector<int> cpus = parseCpuList(online);
+    if (cpus.empty()) {
+        unsigned count = std::max(1u, std::thread::hardware_concurrency());
+        for (unsigned cpu = 0; cpu < count; ++cpu) {
+            cpus.push_back(static_cast<int>(cpu));
+        }
+    }
+
+    // Group logical CPUs by (package, core) keeping the order of their first CPU
+    std::map<std::pair<int, int>, size_t> coreIndex;
+    CpuTopology topology;
+    for (int cpu : cpus) {
+        auto topologyDir = cpuRoot / ("cpu" + std::to_string(cpu)) / "topology";
+        int package = readInt(topologyDir / "physical_package_id", 0);
+        int core = readInt(topologyDir / "core_id", cpu);
+
+        auto key = std::make_pair(package, core);
+        auto found = coreIndex.find(key);
+        if (found == coreIndex.end()) {
+            coreIndex[key] = topology.cores.size();
+            topology.cores.push_back({ package, core, { cpu } });
+        }
+        else {
+            topology.cores[found->second].cpus.push_back(cpu);
+        }
+    }
+    return topology;
+}
+
+size_t CpuTopology::cpuCount() const {
+    size_t count = 0;
+    for (const auto& core : cores) {
+        count += core.cpus.size();
+    }
+    return count;
+}
+
+std::string AffinityPlan::describe() const {
+    std::vector<int> physicsCpus;
+    for (const auto& worker : physics) {
+        physicsCpus.insert(physicsCpus.end(), worker.cpus.begin(), worker.cpus.end());
+    }
+    return fmt::format("render: {} | audio: {} | background: {} | physics: {} workers on {}",
+        cpuListText(render), cpuListText(audio), cpuListText(background),
+        physics.size(), cpuListText(physicsCpus));
+}
+
+AffinityPlan planAffinity(const CpuTopology& cpus, const AffinityConfig& config, const NumaTopology* numa) {
+    AffinityPlan plan;
+    auto physicsWorker = [numa](std::vector<int> workerCpus) {
+        WorkerPlacement placement;
+        placement.node = numa && !workerCpus.empty() ? numa->nodeOfCpu(workerCpus.front()) : -1;
+        placement.cpus = std::move(workerCpus);
+        return placement;
+    };
+
+    if (!config.enabled) {
+        for (unsigned i = 0; i < ThreadPool::defaultWorkerCount(); ++i) {
+            plan.physics.push_back(physicsWorker({}));
+        }
+        if (numa) {
+            // Keep node binding from the NUMA topology alone
+            ThreadPool::placeOnNodes(*numa, plan.physics);
+        }
+        return plan;
+    }
+
+    // Too few cores to isolate anything: leave the scheduler in charge
+    const auto& cores = cpus.cores;
+    if (cores.size() >= 3) {
+        size_t firstPhysics = 1;
+        size_t endPhysics = cores.size();
+        plan.render = { cores.front().cpus.front() };
+        if (cores.size() >= 4) {
+            plan.audio = { cores.back().cpus.front() };
+            endPhysics--;
+        }
+        if (cores.front().cpus.size() > 1) {
+            plan.background = { cores.front().cpus[1] };
+        }
+        else if (!plan.audio.empty() && cores.back().cpus.size() > 1) {
+            plan.background = { cores.back().cpus[1] };
+        }
+
+        for (size_t i = firstPhysics; i < endPhysics; ++i) {
+            const auto& core = cores[i];
+            size_t threads = config.physicsOnSmtSiblings ? core.cpus.size() : 1;
+            for (size_t t = 0; t < threads; ++t) {
+                plan.physics.push_back(physicsWorker({ core.cpus[t] }));
+            }
+        }
+    }
+
+    if (!config.renderCpus.empty()) {
+        plan.render = config.renderCpus;
+    }
+    if (!config.audioCpus.empty()) {
+        plan.audio = config.audioCpus;
+    }
+    if (!config.backgroundCpus.empty()) {
+        plan.background = config.backgroundCpus;
+    }
+    if (!config.physicsCpus.empty()) {
+        plan.physics.clear();
+        for (int cpu : config.physicsCpus) {
+            plan.physics.push_back(physicsWorker({ cpu }));
+        }
+    }
+    if (plan.physics.empty()) {
+        for (unsigned i = 0; i < ThreadPool::defaultWorkerCount(); ++i) {
+            plan.physics.push_back(physicsWorker({}));
+        }
+        if (numa) {
+            ThreadPool::placeOnNodes(*numa, plan.physics);
+        }
+    }
+    return plan;
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "numa.h"
+#include "thread_pool.h"
+
+// One physical core and its SMT siblings
+struct CpuCore {
+    int package = 0;
+    int core = 0;
+    std::vector<int> cpus;  // Logical CPUs, first one is the primary thread
+};
+
+// Core layout read from /sys/devices/system/cpu. Without that information every
+// logical CPU is treated as its own core.
+struct CpuTopology {
+    std::vector<CpuCore> cores;
+
+    static CpuTopology detect();
+    size_t cpuCount() const;
+};
+
+// User overrides; an empty list leaves the role to the automatic plan
+struct AffinityConfig {
+    bool enabled = true;
+    bool physicsOnSmtSiblings = false;
+    std::vector<int> renderCpus;
+    std::vector<int> audioCpus;
+    std::vector<int> physicsCpus;
+    std::vector<int> backgroundCpus;
+};
+
+// Where every thread we own runs. An empty CPU list means unpinned.
+struct AffinityPlan {
+    std::vector<int> render;
+    std::vector<int> audio;
+    std::vector<int> background;  // Asset decode, snapshot save, frame encode
+    std::vector<WorkerPlacement> physics;
+
+    std::string describe() const;
+};
+
+// Default plan: the render thread gets the first core to itself, audio the last
+// core, background work the render core's SMT sibling when there is one, and
+// physics one worker per remaining physical core. With a NUMA topology each
+// physics worker is bound to the node of its CPU.
+AffinityPlan planAffinity(const CpuTopology& cpus, const AffinityConfig& config, const NumaTopology* numa);
@@ -0,0 +1,59 @@
+#include "ball_handles.h"
+
+#include <stdexcept>
+#include <fmt/core.h>
+
+namespace {
+
+const uint32_t SLOT_MASK = (1u << BallHandles::SLOT_BITS) - 1;
+
+BallHandle pack(uint32_t slot, uint32_t generation) {
+    return generation << BallHandles::SLOT_BITS | slot;
+}
+
+}
+
+bool BallHandles::find(BallHandle handle, Location& location) const {
+    uint32_t slot = handle & SLOT_MASK;
+    if (slot >= slots.size() || !slots[slot].live || slots[slot].generation != handle >> SLOT_BITS) {
+        return false;
+    }
+    location = slots[slot].location;
+    return true;
+}
+
+BallHandle BallHandles::allocate(uint32_t slab, uint32_t index) {
+    uint32_t slot;
+    if (!freeSlots.empty()) {
+        slot = freeSlots.front();
+        freeSlots.pop_front();
+    }
+    else {
+        if (slots.size() >= CAPACITY) {
+            throw std::runtime_error(fmt::format("More than {} balls to hand out handles to", CAPACITY));
+        }
+        slot = static_cast<uint32_t>(slots.size());
+        slots.emplace_back();
+    }
+    Slot& s = slots[slot];
+    s.live = true;
+    s.location = { slab, index };
+    live++;
+    return pack(slot, s.generation);
+}
+
+void BallHandles::move(BallHandle handle, uint32_t slab, uint32_t index) {
+    slots[handle & SLOT_MASK].location = { slab, index };
+}
+
+void BallHandles::release(const std::vector<BallHandle>& gone) {
+    for (BallHandle handle : gone) {
+        uint32_t slot = handle & SLOT_MASK;
+        Slot& s = slots[slot];
+        s.live = false;
+        // Generation 0 is skipped, so NO_HANDLE stays invalid
+        s.generation = s.generation == 0xffu ? 1 : s.generation + 1;
+        freeSlots.push_back(slot);
+        live--;
+    }
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+#include "simulation.h"
+
+// Generational slot map from stable ball handles to where the balls live. A
+// handle packs a slot (low 24 bits) and the slot's generation (high 8 bits,
+// never 0, so NO_HANDLE never resolves). Freeing a slot bumps its generation
+// and queues it behind every other free slot, so a stale handle stops
+// resolving and can only alias a new ball after its slot went through 255
+// more balls.
+//
+// Handles are kept beside the balls in BallSlab::handles, so the balls stay
+// dense and no larger when nothing tracks them. Whatever moves or removes
+// balls updates the map for just those balls: allocate() for new balls,
+// move() for balls that changed slab or index and release() for balls that
+// are gone. move() calls on different handles may run in parallel; the
+// others must not overlap anything.
+class BallHandles {
+public:
+    static constexpr uint32_t SLOT_BITS = 24;
+    static constexpr size_t CAPACITY = size_t(1) << SLOT_BITS;  // Most live balls
+
+    struct Location {
+        uint32_t slab;
+        uint32_t index;
+    };
+
+    // O(1); false for NO_HANDLE and for handles of balls that are gone
+    bool find(BallHandle handle, Location& location) const;
+    size_t size() const { return live; }
+    size_t slotCount() const { return slots.size(); }
+
+    // Takes the oldest free slot, or a new one. Throws past 2^24 live balls.
+    BallHandle allocate(uint32_t slab, uint32_t index);
+    // `handle` must be live
+    void move(BallHandle handle, uint32_t slab, uint32_t index);
+    void release(const std::vector<BallHandle>& gone);
+
+private:
+    struct Slot {
+        uint32_t generation = 1;
+        bool live = false;
+        Location location{};
+    };
+
+    std::vector<Slot> slots;
+    std::deque<uint32_t> freeSlots;  // Oldest first
+    size_t live = 0;
+};
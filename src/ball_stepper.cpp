@@ -0,0 +1,756 @@
+#include "ball_stepper.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <stdexcept>
+#include <fmt/core.h>
+
+#include "metrics.h"
+#include "perf_counters.h"
+
+namespace {
+
+const size_t CHUNK_SIZE = 4096;  // Balls per task
+const size_t SPAWN_CHUNK_SIZE = 65536;  // Balls per spawn task, and per generator stream
+const float BRUSH_CELL_SIZE = 0.05f;  // Grid cell edge for brush queries, in world units
+const float MERGE_CELL_SIZE = 4.0f * BALL_RADIUS;  // Grown to the largest ball's diameter when needed
+
+// Fates of a ball under the rules; species indices are the non-negative values
+const int FATE_KEEP = -1;
+const int FATE_DESPAWN = -2;
+const int FATE_MOVED = -3;
+
+metrics::Gauge& ballCountMetric = metrics::registry().gauge("brainrot_balls", "Balls in the simulation");
+metrics::Counter& wallHitsMetric = metrics::registry().counter("brainrot_wall_hits_total", "Balls that hit the wall");
+metrics::Counter& duplicateSpawnsMetric = metrics::registry().counter("brainrot_duplicate_spawns_total",
+    "Balls spawned within the MAX_BALLS budget: duplicates on wall hits, or with a rule table its duplicates and split halves");
+metrics::Counter& brushBallsMetric = metrics::registry().counter("brainrot_brush_balls_total",
+    "Balls pushed, pulled, grabbed or deleted with the mouse");
+metrics::Counter& mergedBallsMetric = metrics::registry().counter("brainrot_merged_balls_total",
+    "Balls absorbed into another by coalescence");
+metrics::Counter& ruleDespawnsMetric = metrics::registry().counter("brainrot_rule_despawns_total",
+    "Balls removed by despawn rules");
+metrics::Counter& ruleRecolorsMetric = metrics::registry().counter("brainrot_rule_recolors_total",
+    "Balls moved to another species by recolor rules");
+metrics::Counter& neighborRebuildsMetric = metrics::registry().counter("brainrot_neighbor_list_rebuilds_total",
+    "Slab neighbor lists rebuilt because balls drifted past half the skin or were added or removed, or that fell back to grid queries");
+metrics::Counter& neighborReusesMetric = metrics::registry().counter("brainrot_neighbor_list_reuses_total",
+    "Ticks a slab's neighbor lists were reused without a rebuild");
+metrics::Histogram& tickTimeMetric = metrics::registry().histogram("brainrot_tick_seconds",
+    "Time to advance the simulation by one tick", 1e-9);
+
+}
+
+BallStepper::BallStepper(ThreadPool& pool, Profiler& profiler, const NumaTopology& topology)
+    : pool(pool), profiler(profiler), topology(topology) {
+    setSpecies({ speciesPreset("classic") });
+}
+
+void BallStepper::setSpecies(std::vector<Species> species) {
+    if (species.empty()) {
+        species.push_back(speciesPreset("classic"));
+    }
+    for (size_t i = 0; i < species.size(); ++i) {
+        for (size_t j = 0; j < i; ++j) {
+            if (species[i].name == species[j].name) {
+                throw std::runtime_error(fmt::format("Species {} is listed twice", species[i].name));
+            }
+        }
+    }
+    this->species = std::move(species);
+    spawnCredit.assign(this->species.size(), 0.0);
+    speciesMetrics.clear();
+    for (const auto& s : this->species) {
+        auto& registry = metrics::registry();
+        speciesMetrics.push_back({
+            &registry.gauge(fmt::format("brainrot_species_{}_balls", s.name), fmt::format("Balls of species {}", s.name)),
+            &registry.counter(fmt::format("brainrot_species_{}_step_nanoseconds_total", s.name),
+                fmt::format("Worker time spent stepping species {}", s.name))
+        });
+    }
+}
+
+size_t BallStepper::speciesOf(const BallSlab& slab) const {
+    return std::min(static_cast<size_t>(std::max(0, slab.species)), species.size() - 1);
+}
+
+size_t BallStepper::dealSpecies() {
+    // Smooth weighted round-robin: every species earns its share, the richest gets the ball and pays the total
+    double total = 0.0;
+    size_t best = 0;
+    for (size_t i = 0; i < species.size(); ++i) {
+        spawnCredit[i] += species[i].spawnShare;
+        total += species[i].spawnShare;
+        if (spawnCredit[i] > spawnCredit[best]) {
+            best = i;
+        }
+    }
+    spawnCredit[best] -= total;
+    return best;
+}
+
+Task<size_t> BallStepper::step(const BallStore& previous, BallStore& next, SpawnBuffer spawned,
+    float wallRadius, float deltaTime, uint32_t seed, SimParams params, std::vector<Brush> brushes) {
+    auto begin = std::chrono::steady_clock::now();
+    if (next.slabs.size() != previous.slabs.size()) {
+        next.slabs.resize(previous.slabs.size());
+    }
+
+    std::vector<SpawnBuffer> spawnedBySpecies(species.size());
+    if (species.size() == 1) {
+        spawnedBySpecies[0] = std::move(spawned);
+    }
+    else {
+        for (const auto& ball : spawned) {
+            spawnedBySpecies[dealSpecies()].push_back(ball);
+        }
+    }
+
+    // Each species' share goes to its smallest slab; a store without slabs for a species falls back to the smallest
+    const size_t NO_SLAB = static_cast<size_t>(-1);
+    size_t smallest = 0;
+    std::vector<size_t> spawnSlab(species.size(), NO_SLAB);
+    for (size_t i = 0; i < previous.slabs.size(); ++i) {
+        size_t size = previous.slabs[i].balls.size();
+        size_t& target = spawnSlab[speciesOf(previous.slabs[i])];
+        if (target == NO_SLAB || size < previous.slabs[target].balls.size()) {
+            target = i;
+        }
+        if (size < previous.slabs[smallest].balls.size()) {
+            smallest = i;
+        }
+    }
+    for (size_t s = 0; s < species.size(); ++s) {
+        if (spawnSlab[s] == NO_SLAB && !spawnedBySpecies[s].empty()) {
+            SpawnBuffer& fallback = spawnedBySpecies[speciesOf(previous.slabs[smallest])];
+            fallback.insert(fallback.end(), spawnedBySpecies[s].begin(), spawnedBySpecies[s].end());
+        }
+    }
+
+    // Copy each slab on its own node so the copy's pages are first touched there
+    std::vector<NodeTask> tasks;
+    for (size_t i = 0; i < previous.slabs.size(); ++i) {
+        int node = previous.slabs[i].node;
+        tasks.push_back({ node, [&, i, node] {
+            BallSlab& slab = next.slabs[i];
+            slab.node = node;
+            slab.species = previous.slabs[i].species;
+            slab.balls = previous.slabs[i].balls;
+            if (trackHandles) {
+                slab.handles = previous.slabs[i].handles;
+            }
+            else {
+                slab.handles.clear();
+            }
+            size_t s = speciesOf(slab);
+            if (i == spawnSlab[s]) {
+                slab.balls.insert(slab.balls.end(), spawnedBySpecies[s].begin(), spawnedBySpecies[s].end());
+            }
+        } });
+    }
+    co_await runTasks(pool, std::move(tasks));
+    if (trackHandles) {
+        trackNewBalls(next);
+    }
+
+    slabParams.resize(next.slabs.size());
+    for (size_t i = 0; i < next.slabs.size(); ++i) {
+        slabParams[i] = species[speciesOf(next.slabs[i])].apply(params);
+        // A rule table owns all spawning
+        if (!rules.empty()) {
+            slabParams[i].duplicateOnHit = false;
+        }
+    }
+
+    // Mouse brushes act on the copied state before it moves, each slab on its own node
+    if (!brushes.empty()) {
+        if (grids.size() != next.slabs.size()) {
+            grids.resize(next.slabs.size());
+        }
+        goneHandles.resize(next.slabs.size());
+        tasks.clear();
+        for (size_t i = 0; i < next.slabs.size(); ++i) {
+            tasks.push_back({ next.slabs[i].node, [&, i] {
+                BallSlab& slab = next.slabs[i];
+                grids[i].reset(wallRadius, BRUSH_CELL_SIZE);
+                maintainGrid(grids[i], slab.balls);
+                brushBallsMetric.add(applyBrushes(slab.balls, grids[i], brushes, deltaTime, slabParams[i],
+                    trackHandles ? &slab.handles : nullptr, &goneHandles[i]));
+                // Slots still hold the indices from before the brushes; balls ahead of the first deleted one stayed put
+                size_t first = slab.handles.size();
+                for (BallHandle handle : goneHandles[i]) {
+                    BallHandles::Location location;
+                    handles.find(handle, location);
+                    first = std::min<size_t>(first, location.index);
+                }
+                relocateHandles(slab, i, first);
+            } });
+        }
+        co_await runTasks(pool, std::move(tasks));
+        releaseGoneHandles();
+    }
+
+    chunks.clear();
+    for (size_t i = 0; i < next.slabs.size(); ++i) {
+        size_t slabSize = next.slabs[i].balls.size();
+        for (size_t begin = 0; begin < slabSize; begin += CHUNK_SIZE) {
+            chunks.push_back({ i, begin, std::min(CHUNK_SIZE, slabSize - begin), 0, 0, {}, {}, {}, {}, {} });
+        }
+    }
+
+    tasks.clear();
+    for (auto& chunk : chunks) {
+        tasks.push_back({ next.slabs[chunk.slab].node, [&, chunkPtr = &chunk] {
+            auto chunkBegin = std::chrono::steady_clock::now();
+            updateChunk(next, *chunkPtr, wallRadius, deltaTime, seed, slabParams[chunkPtr->slab]);
+            chunkPtr->nanoseconds = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - chunkBegin).count());
+        } });
+    }
+    co_await runTasks(pool, std::move(tasks));
+
+    if (!rules.empty()) {
+        co_await runRules(next, wallRadius, deltaTime, seed);
+    }
+
+    // Apply the population cap in slab and ball order
+    size_t population = next.size();
+    size_t budget = MAX_BALLS > population ? MAX_BALLS - population : 0;
+    size_t wallHits = 0;
+    size_t spawns = 0;
+    for (auto& chunk : chunks) {
+        size_t accepted = std::min(budget, chunk.duplicates.size());
+        chunk.duplicates.resize(accepted);
+        budget -= accepted;
+        spawns += accepted;
+        wallHits += chunk.wallHits;
+    }
+    profiler.add(Counter::BallSteps, population);
+    wallHitsMetric.add(wallHits);
+    duplicateSpawnsMetric.add(spawns);
+    ballCountMetric.set(static_cast<double>(population + spawns));
+
+    tasks.clear();
+    for (size_t i = 0; i < next.slabs.size(); ++i) {
+        tasks.push_back({ next.slabs[i].node, [&, i] {
+            auto& balls = next.slabs[i].balls;
+            for (const auto& chunk : chunks) {
+                if (chunk.slab == i) {
+                    balls.insert(balls.end(), chunk.duplicates.begin(), chunk.duplicates.end());
+                }
+            }
+        } });
+    }
+    co_await runTasks(pool, std::move(tasks));
+    if (trackHandles) {
+        trackNewBalls(next);
+    }
+
+    if (!rules.empty()) {
+        co_await settleRules(next);
+        ballCountMetric.set(static_cast<double>(next.size()));
+    }
+
+    if (params.coalesce) {
+        co_await coalesce(next, wallRadius);
+        ballCountMetric.set(static_cast<double>(next.size()));
+    }
+
+    std::vector<size_t> speciesBalls(species.size(), 0);
+    for (const auto& slab : next.slabs) {
+        speciesBalls[speciesOf(slab)] += slab.balls.size();
+    }
+    std::vector<uint64_t> speciesNanoseconds(species.size(), 0);
+    for (const auto& chunk : chunks) {
+        speciesNanoseconds[speciesOf(next.slabs[chunk.slab])] += chunk.nanoseconds;
+    }
+    for (size_t s = 0; s < species.size(); ++s) {
+        speciesMetrics[s].balls->set(static_cast<double>(speciesBalls[s]));
+        speciesMetrics[s].stepNanoseconds->add(speciesNanoseconds[s]);
+    }
+
+    // Hit indices refer to the balls after the tick, so they follow the rules and the merges
+    hits.clear();
+    if (recordHits) {
+        for (const auto& chunk : chunks) {
+            for (WallHit hit : chunk.hits) {
+                hit.ball += static_cast<uint32_t>(chunk.begin);
+                if (!rules.empty()) {
+                    hit.ball = ruleRemaps[chunk.slab][hit.ball];
+                    if (hit.ball == UINT32_MAX) {
+                        continue;
+                    }
+                }
+                if (params.coalesce) {
+                    hit.ball = mergeRemaps[chunk.slab][hit.ball];
+                }
+                hits.push_back(hit);
+            }
+        }
+    }
+
+    tickTimeMetric.record(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - begin).count()));
+    co_return wallHits;
+}
+
+Task<void> BallStepper::spawnRandom(Ball* balls, size_t count, float wallRadius, uint32_t seed, SimParams params) {
+    std::vector<NodeTask> tasks;
+    uint64_t chunk = 0;
+    fillChunks(tasks, -1, balls, count, wallRadius, seed, chunk, params);
+    co_await runTasks(pool, std::move(tasks));
+}
+
+Task<void> BallStepper::populate(BallStore& store, size_t count, float wallRadius, uint32_t seed, SimParams params) {
+    // Grow each slab on its node first; resizing zero-fills, which first-touches the pages
+    size_t slabCount = store.slabs.size();
+    std::vector<size_t> speciesCounts = splitByShare(count, species);
+    std::vector<size_t> speciesSlabs(species.size(), 0);
+    for (const auto& slab : store.slabs) {
+        speciesSlabs[speciesOf(slab)]++;
+    }
+    std::vector<size_t> seen(species.size(), 0);
+    std::vector<size_t> offsets(slabCount);
+    std::vector<NodeTask> tasks;
+    for (size_t i = 0; i < slabCount; ++i) {
+        size_t s = speciesOf(store.slabs[i]);
+        size_t k = seen[s]++;
+        size_t share = speciesCounts[s] / speciesSlabs[s] + (k < speciesCounts[s] % speciesSlabs[s] ? 1 : 0);
+        offsets[i] = store.slabs[i].balls.size();
+        tasks.push_back({ store.slabs[i].node, [&store, i, share] {
+            auto& balls = store.slabs[i].balls;
+            balls.resize(balls.size() + share);
+        } });
+    }
+    co_await runTasks(pool, std::move(tasks));
+
+    tasks.clear();
+    uint64_t chunk = 0;
+    for (size_t i = 0; i < slabCount; ++i) {
+        BallSlab& slab = store.slabs[i];
+        fillChunks(tasks, slab.node, slab.balls.data() + offsets[i], slab.balls.size() - offsets[i],
+            wallRadius, seed, chunk, params);
+    }
+    co_await runTasks(pool, std::move(tasks));
+    ballCountMetric.set(static_cast<double>(store.size()));
+    if (trackHandles) {
+        trackNewBalls(store);
+    }
+}
+
+void BallStepper::trackNewBalls(BallStore& store) {
+    // Handed out in slab and ball order, so every run gives the same balls the same handles
+    for (size_t i = 0; i < store.slabs.size(); ++i) {
+        BallSlab& slab = store.slabs[i];
+        for (size_t b = slab.handles.size(); b < slab.balls.size(); ++b) {
+            slab.handles.push_back(handles.allocate(static_cast<uint32_t>(i), static_cast<uint32_t>(b)));
+        }
+    }
+}
+
+void BallStepper::relocateHandles(const BallSlab& slab, size_t slabIndex, size_t begin) {
+    for (size_t b = begin; b < slab.handles.size(); ++b) {
+        handles.move(slab.handles[b], static_cast<uint32_t>(slabIndex), static_cast<uint32_t>(b));
+    }
+}
+
+void BallStepper::releaseGoneHandles() {
+    for (auto& gone : goneHandles) {
+        handles.release(gone);
+        gone.clear();
+    }
+}
+
+uint64_t BallStepper::streamSeed(uint32_t seed, uint64_t chunk) {
+    // Spread consecutive chunk indices over the whole generator state
+    uint64_t z = (static_cast<uint64_t>(seed) << 32 | 0x6a09e667u) + chunk * 0x9e3779b97f4a7c15ull;
+    z = (z ^ (z >> 33)) * 0xff51afd7ed558ccdull;
+    z = (z ^ (z >> 33)) * 0xc4ceb9fe1a85ec53ull;
+    return z ^ (z >> 33);
+}
+
+void BallStepper::fillChunks(std::vector<NodeTask>& tasks, int node, Ball* balls, size_t count, float wallRadius,
+    uint32_t seed, uint64_t& chunk, const SimParams& params) {
+    for (size_t begin = 0; begin < count; begin += SPAWN_CHUNK_SIZE) {
+        size_t chunkCount = std::min(SPAWN_CHUNK_SIZE, count - begin);
+        uint64_t stream = streamSeed(seed, chunk++);
+        tasks.push_back({ node, [balls = balls + begin, chunkCount, wallRadius, stream, &params] {
+            perf::Scope scope(perf::Phase::Spawn);
+            createRandomBalls(balls, chunkCount, wallRadius, stream, params);
+        } });
+    }
+}
+
+void BallStepper::maintainGrid(SpatialGrid& grid, const BallVector& balls) {
+    auto begin = std::chrono::steady_clock::now();
+    bool rebuilt = grid.update(balls.data(), balls.size());
+    uint64_t nanoseconds = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - begin).count());
+    profiler.add(rebuilt ? Counter::GridRebuilds : Counter::GridUpdates, 1);
+    profiler.add(rebuilt ? Counter::GridRebuildNanoseconds : Counter::GridUpdateNanoseconds, nanoseconds);
+}
+
+Task<void> BallStepper::refreshNeighbors(BallStore& store, std::vector<SpatialGrid>& slabGrids,
+    std::vector<NeighborList>& lists, std::vector<size_t> slabs, float wallRadius) {
+    size_t slabCount = store.slabs.size();
+    slabGrids.resize(slabCount);
+    lists.resize(slabCount);
+
+    // How far each slab's balls drifted since its lists were built, as a max over chunks
+    std::vector<std::vector<float>> drifts(slabCount);
+    std::vector<NodeTask> tasks;
+    for (size_t i : slabs) {
+        size_t slabSize = store.slabs[i].balls.size();
+        drifts[i].assign((slabSize + CHUNK_SIZE - 1) / CHUNK_SIZE, 0.0f);
+        for (size_t begin = 0; begin < slabSize; begin += CHUNK_SIZE) {
+            size_t end = std::min(slabSize, begin + CHUNK_SIZE);
+            tasks.push_back({ store.slabs[i].node, [&, i, begin, end] {
+                drifts[i][begin / CHUNK_SIZE] = lists[i].drift(store.slabs[i].balls.data(), begin, end);
+            } });
+        }
+    }
+    co_await runTasks(pool, std::move(tasks));
+
+    std::vector<size_t> stale;
+    for (size_t i : slabs) {
+        float maxDrift = drifts[i].empty() ? 0.0f : *std::max_element(drifts[i].begin(), drifts[i].end());
+        if (lists[i].stale(store.slabs[i].balls.size(), maxDrift)) {
+            stale.push_back(i);
+        }
+    }
+    neighborRebuildsMetric.add(stale.size());
+    neighborReusesMetric.add(slabs.size() - stale.size());
+    if (stale.empty()) {
+        co_return;
+    }
+
+    // Cells at least as wide as the largest ball, so a query stays within a few cells
+    tasks.clear();
+    for (size_t i : stale) {
+        tasks.push_back({ store.slabs[i].node, [&, i] {
+            const auto& balls = store.slabs[i].balls;
+            float maxRadius = BALL_RADIUS;
+            for (const auto& ball : balls) {
+                maxRadius = std::max(maxRadius, ball.radius);
+            }
+            slabGrids[i].reset(wallRadius, std::max(MERGE_CELL_SIZE, 2.0f * maxRadius));
+            maintainGrid(slabGrids[i], balls);
+            float skin = neighborLists ? lists[i].nextSkin() : 0.0f;
+            lists[i].prepare(balls.data(), balls.size(), maxRadius, skin, slabGrids[i]);
+        } });
+    }
+    co_await runTasks(pool, std::move(tasks));
+
+    tasks.clear();
+    for (size_t i : stale) {
+        for (size_t block = 0; block < lists[i].blockCount(); ++block) {
+            tasks.push_back({ store.slabs[i].node, [&, i, block] {
+                lists[i].buildBlock(store.slabs[i].balls.data(), block);
+            } });
+        }
+    }
+    co_await runTasks(pool, std::move(tasks));
+}
+
+Task<void> BallStepper::coalesce(BallStore& store, float wallRadius) {
+    size_t slabCount = store.slabs.size();
+    if (merges.size() != slabCount) {
+        merges = std::vector<MergeSets>(slabCount);
+        mergeRemaps.resize(slabCount);
+    }
+    goneHandles.resize(slabCount);
+
+    std::vector<size_t> slabs(slabCount);
+    for (size_t i = 0; i < slabCount; ++i) {
+        slabs[i] = i;
+    }
+    co_await refreshNeighbors(store, mergeGrids, mergeLists, std::move(slabs), wallRadius);
+
+    std::vector<NodeTask> tasks;
+    for (size_t i = 0; i < slabCount; ++i) {
+        tasks.push_back({ store.slabs[i].node, [&, i] {
+            merges[i].reset(store.slabs[i].balls.size());
+        } });
+    }
+    co_await runTasks(pool, std::move(tasks));
+
+    tasks.clear();
+    for (size_t i = 0; i < slabCount; ++i) {
+        size_t slabSize = store.slabs[i].balls.size();
+        for (size_t begin = 0; begin < slabSize; begin += CHUNK_SIZE) {
+            size_t end = std::min(slabSize, begin + CHUNK_SIZE);
+            tasks.push_back({ store.slabs[i].node, [&, i, begin, end] {
+                findMerges(store.slabs[i].balls.data(), begin, end, mergeLists[i], merges[i]);
+            } });
+        }
+    }
+    co_await runTasks(pool, std::move(tasks));
+
+    std::vector<size_t> absorbed(slabCount, 0);
+    tasks.clear();
+    for (size_t i = 0; i < slabCount; ++i) {
+        tasks.push_back({ store.slabs[i].node, [&, i] {
+            BallSlab& slab = store.slabs[i];
+            absorbed[i] = mergeSets(slab.balls, merges[i], mergeRemaps[i]);
+            if (!trackHandles || absorbed[i] == 0) {
+                return;
+            }
+            // Survivors take consecutive new indices; an absorbed ball maps to its set's survivor
+            const auto& remap = mergeRemaps[i];
+            size_t kept = 0;
+            size_t moved = remap.size();
+            for (size_t b = 0; b < remap.size(); ++b) {
+                if (remap[b] != kept) {
+                    goneHandles[i].push_back(slab.handles[b]);
+                    moved = std::min(moved, kept);
+                    continue;
+                }
+                slab.handles[kept++] = slab.handles[b];
+            }
+            slab.handles.resize(kept);
+            relocateHandles(slab, i, moved);
+        } });
+    }
+    co_await runTasks(pool, std::move(tasks));
+    releaseGoneHandles();
+
+    size_t total = 0;
+    for (size_t count : absorbed) {
+        total += count;
+    }
+    mergedBallsMetric.add(total);
+}
+
+void BallStepper::updateChunk(BallStore& store, Chunk& chunk, float wallRadius, float deltaTime, uint32_t seed,
+    const SimParams& params) {
+    BallSlab& slab = store.slabs[chunk.slab];
+    Ball* balls = slab.balls.data() + chunk.begin;
+
+    // Read and written once each; count it against the node that actually holds the pages.
+    // Finding that node is a syscall, so only when the counts are reported.
+    if (profiler.summarizing()) {
+        int homeNode = memoryNode(topology, balls);
+        if (homeNode < 0) {
+            homeNode = slab.node;
+        }
+        int workerNode = currentNode(topology);
+        uint64_t bytes = 2 * chunk.count * sizeof(Ball);
+        bool remote = homeNode >= 0 && workerNode >= 0 && homeNode != workerNode;
+        profiler.add(remote ? Counter::RemoteBytes : Counter::LocalBytes, bytes);
+    }
+
+    chunk.wallHits = updateBallRange(balls, chunk.count, wallRadius, deltaTime, seed, chunk.duplicates, params,
+        recordHits || !rules.empty() ? &chunk.hits : nullptr);
+}
+
+Task<void> BallStepper::runRules(BallStore& store, float wallRadius, float deltaTime, uint32_t seed) {
+    // A timer fires on the ticks that cross a multiple of its period
+    double before = ruleTime;
+    ruleTime += static_cast<double>(deltaTime) * SIMULATION_SPEED;
+    firedTimers.assign(species.size(), {});
+    for (size_t s = 0; s < species.size(); ++s) {
+        if (!rules.uses(s, RuleTrigger::Timer)) {
+            continue;
+        }
+        for (const auto& step : rules.of(s, RuleTrigger::Timer)) {
+            if (std::floor(ruleTime / step.period) > std::floor(before / step.period)) {
+                firedTimers[s].push_back(step);
+            }
+        }
+    }
+
+    // Contacts are found on the whole moved slab before any kernel changes a ball
+    std::vector<size_t> contactSlabs;
+    for (size_t i = 0; i < store.slabs.size(); ++i) {
+        if (rules.uses(speciesOf(store.slabs[i]), RuleTrigger::Contact)) {
+            contactSlabs.push_back(i);
+        }
+    }
+    std::vector<NodeTask> tasks;
+    if (!contactSlabs.empty()) {
+        co_await refreshNeighbors(store, contactGrids, contactLists, std::move(contactSlabs), wallRadius);
+        for (auto& chunk : chunks) {
+            if (!rules.uses(speciesOf(store.slabs[chunk.slab]), RuleTrigger::Contact)) {
+                continue;
+            }
+            tasks.push_back({ store.slabs[chunk.slab].node, [&, chunkPtr = &chunk] {
+                const Ball* balls = store.slabs[chunkPtr->slab].balls.data();
+                const NeighborList& neighbors = contactLists[chunkPtr->slab];
+                thread_local std::vector<uint32_t> nearby;
+                for (size_t i = chunkPtr->begin; i < chunkPtr->begin + chunkPtr->count; ++i) {
+                    const Ball& ball = balls[i];
+                    for (uint32_t j : neighbors.of(balls, i, nearby)) {
+                        float dx = balls[j].x - ball.x;
+                        float dy = balls[j].y - ball.y;
+                        float contact = ball.radius + balls[j].radius;
+                        if (dx * dx + dy * dy < contact * contact) {
+                            chunkPtr->contacts.push_back(static_cast<uint32_t>(i));
+                            break;
+                        }
+                    }
+                }
+            } });
+        }
+        co_await runTasks(pool, std::move(tasks));
+        tasks.clear();
+    }
+
+    // No chunk can keep more spawns than the budget left after this tick's
+    // despawns, which is at most MAX_BALLS
+    size_t spawnRoom = MAX_BALLS;
+    if (!rules.despawns) {
+        spawnRoom = MAX_BALLS > store.size() ? MAX_BALLS - store.size() : 0;
+    }
+    for (auto& chunk : chunks) {
+        tasks.push_back({ store.slabs[chunk.slab].node, [&, chunkPtr = &chunk] {
+            applyRules(store, *chunkPtr, seed, spawnRoom);
+        } });
+    }
+    co_await runTasks(pool, std::move(tasks));
+}
+
+void BallStepper::applyRules(BallStore& store, Chunk& chunk, uint32_t seed, size_t spawnRoom) {
+    size_t s = speciesOf(store.slabs[chunk.slab]);
+    Ball* balls = store.slabs[chunk.slab].balls.data();
+    RuleEffects& effects = chunk.effects;
+    effects.clear();
+    effects.spawns = &chunk.duplicates;
+    effects.spawnRoom = spawnRoom;
+
+    // Every trigger hands its kernels one index batch
+    if (rules.uses(s, RuleTrigger::WallHit)) {
+        chunk.selected.clear();
+        for (const auto& hit : chunk.hits) {
+            chunk.selected.push_back(static_cast<uint32_t>(chunk.begin) + hit.ball);
+        }
+        runRuleSteps(rules.of(s, RuleTrigger::WallHit), balls, chunk.selected.data(), chunk.selected.size(), seed,
+            effects);
+    }
+    if (!firedTimers[s].empty()) {
+        chunk.selected.resize(chunk.count);
+        for (size_t i = 0; i < chunk.count; ++i) {
+            chunk.selected[i] = static_cast<uint32_t>(chunk.begin + i);
+        }
+        runRuleSteps(firedTimers[s], balls, chunk.selected.data(), chunk.selected.size(), seed, effects);
+    }
+    if (!chunk.contacts.empty()) {
+        runRuleSteps(rules.of(s, RuleTrigger::Contact), balls, chunk.contacts.data(), chunk.contacts.size(), seed,
+            effects);
+    }
+}
+
+Task<void> BallStepper::settleRules(BallStore& store) {
+    size_t slabCount = store.slabs.size();
+    fates.resize(slabCount);
+    ruleRemaps.resize(slabCount);
+
+    // Recolored balls go to their new species' smallest slab, or stay when it has none
+    const size_t NO_SLAB = static_cast<size_t>(-1);
+    std::vector<size_t> targetSlab(species.size(), NO_SLAB);
+    for (size_t i = 0; i < slabCount; ++i) {
+        size_t& target = targetSlab[speciesOf(store.slabs[i])];
+        if (target == NO_SLAB || store.slabs[i].balls.size() < store.slabs[target].balls.size()) {
+            target = i;
+        }
+    }
+
+    // Despawning wins over recoloring, and the first recolor over later ones
+    std::vector<NodeTask> tasks;
+    for (size_t i = 0; i < slabCount; ++i) {
+        tasks.push_back({ store.slabs[i].node, [&, i] {
+            auto& fate = fates[i];
+            fate.assign(store.slabs[i].balls.size(), FATE_KEEP);
+            for (const auto& chunk : chunks) {
+                if (chunk.slab != i) {
+                    continue;
+                }
+                // The budget keeps a prefix of each chunk's spawns, so the dropped halves are the last splits;
+                // undone newest first, their parents get back their mass and heading
+                const auto& splits = chunk.effects.splits;
+                for (auto split = splits.rbegin(); split != splits.rend() && split->spawn >= chunk.duplicates.size();
+                    ++split) {
+                    Ball& parent = store.slabs[i].balls[split->ball];
+                    parent.radius = split->radius;
+                    parent.dx = split->dx;
+                    parent.dy = split->dy;
+                }
+                for (const auto& conversion : chunk.effects.converted) {
+                    if (fate[conversion.ball] == FATE_KEEP && targetSlab[conversion.species] != NO_SLAB) {
+                        fate[conversion.ball] = conversion.species;
+                    }
+                }
+                for (uint32_t ball : chunk.effects.despawned) {
+                    fate[ball] = FATE_DESPAWN;
+                }
+            }
+        } });
+    }
+    co_await runTasks(pool, std::move(tasks));
+
+    // Gathered in slab and chunk order, so every run places them the same way
+    std::vector<SpawnBuffer> incoming(slabCount);
+    std::vector<HandleVector> incomingHandles(slabCount);
+    size_t recolored = 0;
+    for (const auto& chunk : chunks) {
+        auto& fate = fates[chunk.slab];
+        for (const auto& conversion : chunk.effects.converted) {
+            if (fate[conversion.ball] == conversion.species) {
+                size_t target = targetSlab[conversion.species];
+                incoming[target].push_back(store.slabs[chunk.slab].balls[conversion.ball]);
+                if (trackHandles) {
+                    incomingHandles[target].push_back(store.slabs[chunk.slab].handles[conversion.ball]);
+                }
+                fate[conversion.ball] = FATE_MOVED;
+                recolored++;
+            }
+        }
+    }
+
+    std::vector<size_t> despawned(slabCount, 0);
+    goneHandles.resize(slabCount);
+    tasks.clear();
+    for (size_t i = 0; i < slabCount; ++i) {
+        tasks.push_back({ store.slabs[i].node, [&, i] {
+            BallSlab& slab = store.slabs[i];
+            auto& balls = slab.balls;
+            const auto& fate = fates[i];
+            auto& remap = ruleRemaps[i];
+            remap.resize(balls.size());
+            size_t kept = 0;
+            size_t moved = balls.size();
+            for (size_t b = 0; b < balls.size(); ++b) {
+                if (fate[b] != FATE_KEEP) {
+                    despawned[i] += fate[b] == FATE_DESPAWN ? 1 : 0;
+                    if (trackHandles && fate[b] == FATE_DESPAWN) {
+                        goneHandles[i].push_back(slab.handles[b]);
+                    }
+                    remap[b] = UINT32_MAX;
+                    moved = std::min(moved, kept);
+                    continue;
+                }
+                remap[b] = static_cast<uint32_t>(kept);
+                if (trackHandles) {
+                    slab.handles[kept] = slab.handles[b];
+                }
+                balls[kept++] = balls[b];
+            }
+            balls.resize(kept);
+            balls.insert(balls.end(), incoming[i].begin(), incoming[i].end());
+            if (trackHandles) {
+                slab.handles.resize(kept);
+                slab.handles.insert(slab.handles.end(), incomingHandles[i].begin(), incomingHandles[i].end());
+                relocateHandles(slab, i, std::min(moved, kept));
+            }
+        } });
+    }
+    co_await runTasks(pool, std::move(tasks));
+    releaseGoneHandles();
+
+    size_t total = 0;
+    for (size_t count : despawned) {
+        total += count;
+    }
+    ruleDespawnsMetric.add(total);
+    ruleRecolorsMetric.add(recolored);
+}
@@ -0,0 +1,144 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "ball_handles.h"
+#include "coalescence.h"
+#include "interaction.h"
+#include "metrics.h"
+#include "neighbor_list.h"
+#include "numa.h"
+#include "profiler.h"
+#include "rules.h"
+#include "scheduler.h"
+#include "simulation.h"
+#include "species.h"
+#include "spatial_grid.h"
+#include "thread_pool.h"
+
+// Advances a BallStore on the pool. Work on each slab is queued on the node
+// that owns it, so its workers stay on local memory and only steal other
+// nodes' chunks when they run out of their own.
+class BallStepper {
+public:
+    BallStepper(ThreadPool& pool, Profiler& profiler, const NumaTopology& topology);
+
+    // Copies `previous` into `next` slab by slab, deals `spawned` out to the
+    // species and adds each share to the species' smallest slab, applies
+    // `brushes` and advances `next` by one tick, every slab under its species' rules. Gives the same result as the reference
+    // update when there is a single slab. With params.coalesce, touching balls of a slab are then
+    // merged. Returns the number of wall hits.
+    Task<size_t> step(const BallStore& previous, BallStore& next, SpawnBuffer spawned,
+        float wallRadius, float deltaTime, uint32_t seed, SimParams params = {}, std::vector<Brush> brushes = {});
+
+    // Fills balls[0, count) with random balls inside the container of `params`
+    // on the pool. Every chunk draws from its own generator stream derived from
+    // `seed`, so the result does not depend on the thread count.
+    Task<void> spawnRandom(Ball* balls, size_t count, float wallRadius, uint32_t seed, SimParams params = {});
+
+    // Adds `count` random balls to the store, split over the species by spawn
+    // share and then evenly over each species' slabs. Each slab is grown and
+    // filled by its own node's workers.
+    Task<void> populate(BallStore& store, size_t count, float wallRadius, uint32_t seed, SimParams params = {});
+
+    // Species indexed by BallSlab::species; stores passed in must be partitioned
+    // for this many species. Registers per-species population and cost metrics,
+    // so names must be unique; throws otherwise.
+    void setSpecies(std::vector<Species> species);
+    const std::vector<Species>& getSpecies() const { return species; }
+
+    // Replaces the built-in duplicate-on-wall-hit rule with a compiled rule
+    // table; an empty program restores it. Compile it against getSpecies().
+    void setRules(RuleProgram rules) { this->rules = std::move(rules); }
+
+    // When on, step() and populate() keep a stable handle on every ball in
+    // BallSlab::handles and getHandles() resolves it to the ball's slab and
+    // index in the store they last wrote. Only the balls that are added,
+    // moved or removed cost anything. Read it between steps.
+    void setTrackHandles(bool track) { trackHandles = track; }
+    const BallHandles& getHandles() const { return handles; }
+    // Hands out handles to the balls appended to the store's slabs since
+    // step() or populate() last wrote it
+    void trackNewBalls(BallStore& store);
+
+    // When off, coalescence and contact rules query the grid for every ball
+    // each tick instead of reusing neighbor lists; both find the same pairs
+    void setNeighborLists(bool enabled) { neighborLists = enabled; }
+
+    // When on, step() also collects every wall hit, in slab and ball order
+    void setRecordHits(bool record) { recordHits = record; }
+    const std::vector<WallHit>& lastHits() const { return hits; }
+
+private:
+    struct Chunk {
+        size_t slab;
+        size_t begin;
+        size_t count;
+        size_t wallHits;
+        uint64_t nanoseconds;
+        SpawnBuffer duplicates;
+        std::vector<WallHit> hits;
+        std::vector<uint32_t> contacts;  // Slab indices of the chunk's balls touching another ball
+        std::vector<uint32_t> selected;
+        RuleEffects effects;
+    };
+
+    struct SpeciesMetrics {
+        metrics::Gauge* balls;
+        metrics::Counter* stepNanoseconds;
+    };
+
+    static uint64_t streamSeed(uint32_t seed, uint64_t chunk);
+    size_t speciesOf(const BallSlab& slab) const;
+    size_t dealSpecies();
+    void fillChunks(std::vector<NodeTask>& tasks, int node, Ball* balls, size_t count, float wallRadius,
+        uint32_t seed, uint64_t& chunk, const SimParams& params);
+
+    void updateChunk(BallStore& store, Chunk& chunk, float wallRadius, float deltaTime, uint32_t seed,
+        const SimParams& params);
+    // Updates `grid` in place when few balls changed cell and rebuilds it otherwise, timing either
+    void maintainGrid(SpatialGrid& grid, const BallVector& balls);
+    // Rebuilds the grids and neighbor lists of those of `slabs` whose balls drifted too far, in parallel blocks
+    Task<void> refreshNeighbors(BallStore& store, std::vector<SpatialGrid>& slabGrids, std::vector<NeighborList>& lists,
+        std::vector<size_t> slabs, float wallRadius);
+    // Finds the merges of every slab in parallel chunks, then collapses them slab by slab
+    Task<void> coalesce(BallStore& store, float wallRadius);
+    // Runs the rule kernels on every chunk; spawns land in the chunk's duplicates
+    Task<void> runRules(BallStore& store, float wallRadius, float deltaTime, uint32_t seed);
+    void applyRules(BallStore& store, Chunk& chunk, uint32_t seed, size_t spawnRoom);
+    // Removes despawned balls and moves recolored ones to their new species, slab by slab
+    Task<void> settleRules(BallStore& store);
+    // Records the index of every ball of the slab from `begin` on after a compaction moved them
+    void relocateHandles(const BallSlab& slab, size_t slabIndex, size_t begin);
+    // Frees the slots of the balls that goneHandles collected
+    void releaseGoneHandles();
+
+    ThreadPool& pool;
+    Profiler& profiler;
+    const NumaTopology& topology;
+    std::vector<Chunk> chunks;
+    std::vector<Species> species;
+    std::vector<SpeciesMetrics> speciesMetrics;
+    std::vector<double> spawnCredit;  // Smooth weighted round-robin state of dealSpecies
+    std::vector<SimParams> slabParams;  // This tick's parameters under each slab's species
+    std::vector<SpatialGrid> grids;  // Per slab, for brush queries; kept across ticks and updated in place
+    std::vector<SpatialGrid> mergeGrids;  // Per slab, for coalescence; kept across ticks and updated in place
+    std::vector<NeighborList> mergeLists;  // Per slab, built from mergeGrids and reused while the balls stay close
+    std::vector<MergeSets> merges;
+    std::vector<std::vector<uint32_t>> mergeRemaps;  // Old to new ball index, per slab
+    RuleProgram rules;
+    double ruleTime = 0.0;  // Simulated time that drives timer rules
+    std::vector<std::vector<RuleStep>> firedTimers;  // Per species, this tick
+    std::vector<SpatialGrid> contactGrids;  // Per slab, for contact rules
+    std::vector<NeighborList> contactLists;
+    std::vector<std::vector<int>> fates;  // Per slab and ball: KEEP, DESPAWN, MOVED or the species to move to
+    std::vector<std::vector<uint32_t>> ruleRemaps;  // Old to new ball index, per slab
+    bool trackHandles = false;
+    BallHandles handles;
+    std::vector<std::vector<BallHandle>> goneHandles;  // Per slab, balls removed by the current pass
+    bool recordHits = false;
+    std::vector<WallHit> hits;
+    bool neighborLists = true;
+};
@@ -0,0 +1,260 @@
+#include <brainrot/brainrot.h>
+
+#include <exception>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <fmt/core.h>
+
+#include "ball_stepper.h"
+#include "numa.h"
+#include "profiler.h"
+#include "scheduler.h"
+#include "simulation.h"
+#include "thread_pool.h"
+
+struct brainrot_world {
+    float wallRadius;
+    uint32_t seed;
+    uint64_t tick = 0;
+    uint64_t spawnCalls = 0;
+    SimParams params;
+    ThreadPool pool;
+    Profiler profiler;
+    NumaTopology topology;  // Empty: a world keeps its balls in one unowned slab
+    BallStepper stepper;
+    BallStore states[2] = { BallStore::partitioned(0), BallStore::partitioned(0) };
+    int current = 0;
+    brainrot_hit_callback hitCallback = nullptr;
+    void* hitUserData = nullptr;
+    std::vector<brainrot_hit> hits;
+
+    brainrot_world(const brainrot_world_config& config)
+        : wallRadius(config.wall_radius), seed(config.seed),
+          pool(config.threads > 0 ? config.threads : ThreadPool::defaultWorkerCount()),
+          stepper(pool, profiler, topology) {
+        stepper.setTrackHandles(true);
+    }
+
+    BallVector& balls() { return states[current].slabs[0].balls; }
+    const BallVector& balls() const { return states[current].slabs[0].balls; }
+    const HandleVector& handles() const { return states[current].slabs[0].handles; }
+};
+
+namespace {
+
+const uint32_t SPAWN_SEED = 0x3c6ef372u;
+
+thread_local std::string lastError;
+
+// Every ball of a world needs a handle
+void checkRoom(const brainrot_world& world, size_t count) {
+    if (count > BallHandles::CAPACITY - world.balls().size()) {
+        throw std::invalid_argument(fmt::format("count {} would take the world past {} balls", count,
+            BallHandles::CAPACITY));
+    }
+}
+
+Task<void> captureErrors(Task<void> task, std::exception_ptr& error) {
+    try {
+        co_await std::move(task);
+    }
+    catch (...) {
+        error = std::current_exception();
+    }
+}
+
+// Runs a task on the world's pool and blocks until it completes, rethrowing its exception
+void runOnPool(brainrot_world& world, Task<void> task) {
+    std::exception_ptr error;
+    auto done = std::make_shared<Event>(world.pool);
+    launch(captureErrors(std::move(task), error), done);
+    done->wait();
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+Task<void> stepOnce(brainrot_world& world, float deltaTime) {
+    BallStore& previous = world.states[world.current];
+    BallStore& next = world.states[1 - world.current];
+    co_await world.stepper.step(previous, next, {}, world.wallRadius, deltaTime,
+        tickSeed(world.seed, world.tick), world.params);
+}
+
+// Converts exceptions at the API boundary into error codes
+template <typename Function>
+int guarded(brainrot_world* world, Function&& function) {
+    if (!world) {
+        lastError = "world is null";
+        return BRAINROT_ERROR_ARGUMENT;
+    }
+    try {
+        function(*world);
+        return BRAINROT_OK;
+    }
+    catch (const std::invalid_argument& e) {
+        lastError = e.what();
+        return BRAINROT_ERROR_ARGUMENT;
+    }
+    catch (const std::exception& e) {
+        lastError = e.what();
+        return BRAINROT_ERROR_INTERNAL;
+    }
+}
+
+brainrot_view viewOf(const brainrot_world* world, size_t offset, size_t components) {
+    if (!world || world->balls().empty()) {
+        return { nullptr, 0, sizeof(Ball), components };
+    }
+    const auto* first = reinterpret_cast<const char*>(world->balls().data()) + offset;
+    return { reinterpret_cast<const float*>(first), world->balls().size(), sizeof(Ball), components };
+}
+
+}
+
+extern "C" {
+
+void brainrot_world_config_init(brainrot_world_config* config) {
+    if (config) {
+        config->wall_radius = 0.9f;
+        config->seed = 1;
+        config->threads = 0;
+    }
+}
+
+brainrot_world* brainrot_world_create(const brainrot_world_config* config) {
+    brainrot_world_config defaults;
+    brainrot_world_config_init(&defaults);
+    const brainrot_world_config& chosen = config ? *config : defaults;
+    if (!(chosen.wall_radius > BALL_RADIUS)) {
+        lastError = fmt::format("wall_radius must be larger than the ball radius {}", BALL_RADIUS);
+        return nullptr;
+    }
+    try {
+        return new brainrot_world(chosen);
+    }
+    catch (const std::exception& e) {
+        lastError = e.what();
+        return nullptr;
+    }
+}
+
+void brainrot_world_destroy(brainrot_world* world) {
+    delete world;
+}
+
+int brainrot_spawn_random(brainrot_world* world, size_t count) {
+    return guarded(world, [count](brainrot_world& w) {
+        checkRoom(w, count);
+        uint32_t seed = tickSeed(w.seed ^ SPAWN_SEED, w.spawnCalls++);
+        runOnPool(w, w.stepper.populate(w.states[w.current], count, w.wallRadius, seed));
+    });
+}
+
+int brainrot_spawn_at(brainrot_world* world, float x, float y, size_t count) {
+    return guarded(world, [=](brainrot_world& w) {
+        checkRoom(w, count);
+        auto& balls = w.balls();
+        balls.reserve(balls.size() + count);
+        for (size_t i = 0; i < count; ++i) {
+            balls.push_back(createBallAt(x, y, w.wallRadius));
+        }
+        w.stepper.trackNewBalls(w.states[w.current]);
+    });
+}
+
+int brainrot_step(brainrot_world* world, uint32_t ticks, float delta_time) {
+    return guarded(world, [=](brainrot_world& w) {
+        if (!(delta_time >= 0.0f)) {
+            throw std::invalid_argument("delta_time must not be negative");
+        }
+        w.stepper.setRecordHits(w.hitCallback != nullptr);
+        for (uint32_t i = 0; i < ticks; ++i) {
+            runOnPool(w, stepOnce(w, delta_time));
+            w.current = 1 - w.current;
+            w.tick++;
+
+            if (w.hitCallback && !w.stepper.lastHits().empty()) {
+                w.hits.clear();
+                for (const auto& hit : w.stepper.lastHits()) {
+                    w.hits.push_back({ hit.ball, hit.x, hit.y, hit.speed });
+                }
+                w.hitCallback(w.hitUserData, w.tick, w.hits.data(), w.hits.size());
+            }
+        }
+    });
+}
+
+int brainrot_set_gravity(brainrot_world* world, float gravity) {
+    return guarded(world, [=](brainrot_world& w) { w.params.gravity = gravity; });
+}
+
+int brainrot_set_center_bias(brainrot_world* world, float center_bias) {
+    return guarded(world, [=](brainrot_world& w) {
+        if (!(center_bias >= 0.0f && center_bias <= 1.0f)) {
+            throw std::invalid_argument("center_bias must be between 0 and 1");
+        }
+        w.params.centerBias = center_bias;
+    });
+}
+
+int brainrot_set_coalesce(brainrot_world* world, int enabled) {
+    return guarded(world, [=](brainrot_world& w) { w.params.coalesce = enabled != 0; });
+}
+
+int brainrot_set_hit_callback(brainrot_world* world, brainrot_hit_callback callback, void* user_data) {
+    return guarded(world, [=](brainrot_world& w) {
+        w.hitCallback = callback;
+        w.hitUserData = user_data;
+    });
+}
+
+size_t brainrot_ball_count(const brainrot_world* world) {
+    return world ? world->balls().size() : 0;
+}
+
+uint32_t brainrot_ball_handle(const brainrot_world* world, size_t index) {
+    return world && index < world->balls().size() ? world->handles()[index] : NO_HANDLE;
+}
+
+int brainrot_find_ball(const brainrot_world* world, uint32_t handle, size_t* index) {
+    if (!world || !index) {
+        lastError = "world and index must not be null";
+        return BRAINROT_ERROR_ARGUMENT;
+    }
+    BallHandles::Location location;
+    if (!world->stepper.getHandles().find(handle, location)) {
+        lastError = fmt::format("handle {:#x} does not name a live ball", handle);
+        return BRAINROT_ERROR_ARGUMENT;
+    }
+    *index = location.index;
+    return BRAINROT_OK;
+}
+
+uint64_t brainrot_tick(const brainrot_world* world) {
+    return world ? world->tick : 0;
+}
+
+brainrot_view brainrot_positions(const brainrot_world* world) {
+    return viewOf(world, offsetof(Ball, x), 2);
+}
+
+brainrot_view brainrot_velocities(const brainrot_world* world) {
+    return viewOf(world, offsetof(Ball, dx), 2);
+}
+
+brainrot_view brainrot_colors(const brainrot_world* world) {
+    return viewOf(world, offsetof(Ball, r), 3);
+}
+
+brainrot_view brainrot_radii(const brainrot_world* world) {
+    return viewOf(world, offsetof(Ball, radius), 1);
+}
+
+const char* brainrot_last_error(void) {
+    return lastError.c_str();
+}
+
+}
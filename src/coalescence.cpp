@@ -0,0 +1,133 @@
+#include "coalescence.h"
+
+#include <algorithm>
+#include <cmath>
+
+void MergeSets::reset(size_t count) {
+    if (count > capacity) {
+        parents = std::make_unique<std::atomic<uint32_t>[]>(count);
+        capacity = count;
+    }
+    for (size_t i = 0; i < count; ++i) {
+        parents[i].store(static_cast<uint32_t>(i), std::memory_order_relaxed);
+    }
+}
+
+uint32_t MergeSets::find(uint32_t a) {
+    // Path halving; a failed exchange only means another thread shortened the path first
+    for (;;) {
+        uint32_t parent = parents[a].load(std::memory_order_relaxed);
+        if (parent == a) {
+            return a;
+        }
+        uint32_t grandparent = parents[parent].load(std::memory_order_relaxed);
+        if (grandparent != parent) {
+            parents[a].compare_exchange_weak(parent, grandparent, std::memory_order_relaxed);
+        }
+        a = grandparent;
+    }
+}
+
+void MergeSets::unite(uint32_t a, uint32_t b) {
+    for (;;) {
+        a = find(a);
+        b = find(b);
+        if (a == b) {
+            return;
+        }
+        if (a < b) {
+            std::swap(a, b);
+        }
+        // Fails when `a` stopped being a root in the meantime; retry from the new roots
+        uint32_t expected = a;
+        if (parents[a].compare_exchange_strong(expected, b, std::memory_order_relaxed)) {
+            return;
+        }
+    }
+}
+
+void findMerges(const Ball* balls, size_t begin, size_t end, const NeighborList& neighbors, MergeSets& sets) {
+    thread_local std::vector<uint32_t> nearby;
+    for (size_t i = begin; i < end; ++i) {
+        const Ball& ball = balls[i];
+        for (uint32_t j : neighbors.of(balls, i, nearby)) {
+            if (j <= i) {
+                continue;
+            }
+            const Ball& other = balls[j];
+            float dx = other.x - ball.x;
+            float dy = other.y - ball.y;
+            float contact = ball.radius + other.radius;
+            // Closing in only: a duplicate drifting off its parent is left alone
+            float closing = dx * (other.dx - ball.dx) + dy * (other.dy - ball.dy);
+            if (dx * dx + dy * dy < contact * contact && closing < 0.0f) {
+                sets.unite(static_cast<uint32_t>(i), j);
+            }
+        }
+    }
+}
+
+size_t mergeSets(BallVector& balls, MergeSets& sets, std::vector<uint32_t>& remap) {
+    struct Sum {
+        uint32_t members;
+        float mass, x, y, dx, dy, momentum;
+    };
+    thread_local std::vector<uint32_t> roots;
+    thread_local std::vector<Sum> sums;
+    size_t count = balls.size();
+    roots.resize(count);
+    sums.resize(count);
+
+    // Members are added in index order, so the sums do not depend on the threads that found the pairs
+    bool merged = false;
+    for (size_t i = 0; i < count; ++i) {
+        const Ball& ball = balls[i];
+        uint32_t root = sets.find(static_cast<uint32_t>(i));
+        roots[i] = root;
+        float mass = ball.radius * ball.radius;
+        if (root == i) {
+            sums[i] = { 1, mass, mass * ball.x, mass * ball.y, mass * ball.dx, mass * ball.dy, mass * ball.addedMomentum };
+            continue;
+        }
+        merged = true;
+        Sum& sum = sums[root];
+        sum.members++;
+        sum.mass += mass;
+        sum.x += mass * ball.x;
+        sum.y += mass * ball.y;
+        sum.dx += mass * ball.dx;
+        sum.dy += mass * ball.dy;
+        sum.momentum += mass * ball.addedMomentum;
+    }
+
+    remap.resize(count);
+    if (!merged) {
+        for (size_t i = 0; i < count; ++i) {
+            remap[i] = static_cast<uint32_t>(i);
+        }
+        return 0;
+    }
+
+    // Roots are the smallest index of their set, so compacting in place never overwrites an unread root
+    size_t kept = 0;
+    for (size_t i = 0; i < count; ++i) {
+        if (roots[i] != i) {
+            remap[i] = remap[roots[i]];
+            continue;
+        }
+        Ball ball = balls[i];
+        const Sum& sum = sums[i];
+        if (sum.members > 1) {
+            ball.x = sum.x / sum.mass;
+            ball.y = sum.y / sum.mass;
+            ball.dx = sum.dx / sum.mass;
+            ball.dy = sum.dy / sum.mass;
+            ball.addedMomentum = sum.momentum / sum.mass;
+            ball.radius = std::min(std::sqrt(sum.mass), MAX_BALL_RADIUS);
+        }
+        remap[i] = static_cast<uint32_t>(kept);
+        balls[kept++] = ball;
+    }
+    balls.resize(kept);
+    return count - kept;
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "neighbor_list.h"
+#include "simulation.h"
+
+// Disjoint sets over ball indices. unite() and find() may run concurrently:
+// a root is only ever linked below a smaller index, so every set ends up
+// rooted at its smallest member whatever order the unions ran in.
+class MergeSets {
+public:
+    void reset(size_t count);
+
+    void unite(uint32_t a, uint32_t b);
+    uint32_t find(uint32_t a);
+
+private:
+    std::unique_ptr<std::atomic<uint32_t>[]> parents;
+    size_t capacity = 0;
+};
+
+// Unites every ball of balls[begin, end) with the higher-indexed balls it
+// overlaps while the two close in. `neighbors` must cover balls[0, count).
+// Ranges may run in parallel.
+void findMerges(const Ball* balls, size_t begin, size_t end, const NeighborList& neighbors, MergeSets& sets);
+
+// Replaces every set with one ball at its center of mass, carrying the summed
+// mass (radius squared, capped at MAX_BALL_RADIUS) and momentum. Surviving
+// balls keep their order; `remap` receives the new index of every old ball.
+// Returns the number of balls absorbed.
+size_t mergeSets(BallVector& balls, MergeSets& sets, std::vector<uint32_t>& remap);
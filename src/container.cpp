@@ -0,0 +1,349 @@
+#include "container.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <fmt/core.h>
+
+namespace {
+
+bool endsWith(const std::string& text, const std::string& suffix) {
+    return text.size() >= suffix.size() && text.compare(text.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+std::string readFile(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        throw std::runtime_error(fmt::format("Failed to open container file: {}", path));
+    }
+    std::stringstream buffer;
+    buffer << file.rdbuf();
+    return buffer.str();
+}
+
+// Binary (P5) or ASCII (P2) graymap; pixels above half of maxval are inside
+void parsePgm(const std::string& path, const std::string& text, ContainerShape& shape) {
+    size_t position = 0;
+    auto nextToken = [&]() {
+        for (;;) {
+            while (position < text.size() && std::isspace(static_cast<unsigned char>(text[position]))) {
+                position++;
+            }
+            if (position < text.size() && text[position] == '#') {
+                position = text.find('\n', position);
+                position = position == std::string::npos ? text.size() : position;
+                continue;
+            }
+            break;
+        }
+        size_t begin = position;
+        while (position < text.size() && !std::isspace(static_cast<unsigned char>(text[position]))) {
+            position++;
+        }
+        return text.substr(begin, position - begin);
+    };
+
+    std::string magic = nextToken();
+    if (magic != "P5" && magic != "P2") {
+        throw std::runtime_error(fmt::format("{}: not a PGM file", path));
+    }
+    int width = std::atoi(nextToken().c_str());
+    int height = std::atoi(nextToken().c_str());
+    int maxValue = std::atoi(nextToken().c_str());
+    if (width <= 0 || height <= 0 || maxValue <= 0 || maxValue > 65535) {
+        throw std::runtime_error(fmt::format("{}: bad PGM header", path));
+    }
+
+    size_t pixels = static_cast<size_t>(width) * height;
+    shape.mask.resize(pixels);
+    if (magic == "P5") {
+        size_t bytesPerPixel = maxValue > 255 ? 2 : 1;
+        position++;  // The single whitespace after maxval
+        if (text.size() < position + pixels * bytesPerPixel) {
+            throw std::runtime_error(fmt::format("{}: truncated PGM data", path));
+        }
+        for (size_t i = 0; i < pixels; ++i) {
+            const auto* bytes = reinterpret_cast<const unsigned char*>(text.data() + position + i * bytesPerPixel);
+            int value = bytesPerPixel == 2 ? (bytes[0] << 8 | bytes[1]) : bytes[0];
+            shape.mask[i] = value * 2 > maxValue ? 1 : 0;
+        }
+    }
+    else {
+        for (size_t i = 0; i < pixels; ++i) {
+            std::string token = nextToken();
+            if (token.empty()) {
+                throw std::runtime_error(fmt::format("{}: truncated PGM data", path));
+            }
+            shape.mask[i] = std::atoi(token.c_str()) * 2 > maxValue ? 1 : 0;
+        }
+    }
+    shape.maskWidth = width;
+    shape.maskHeight = height;
+}
+
+// Coordinates as x y pairs; M starts a ring, L continues it, Z closes it
+void parseOutline(const std::string& path, const std::string& text, ContainerShape& shape) {
+    std::vector<ContainerShape::Point> ring;
+    std::vector<float> pending;
+    auto finishRing = [&] {
+        if (ring.size() >= 3) {
+            shape.rings.push_back(std::move(ring));
+        }
+        ring.clear();
+    };
+
+    const char* cursor = text.c_str();
+    const char* end = cursor + text.size();
+    while (cursor < end) {
+        char c = *cursor;
+        if (std::isspace(static_cast<unsigned char>(c)) || c == ',') {
+            cursor++;
+        }
+        else if (c == '#') {
+            while (cursor < end && *cursor != '\n') {
+                cursor++;
+            }
+        }
+        else if (c == 'M' || c == 'L' || c == 'Z') {
+            if (c != 'L') {
+                finishRing();
+            }
+            cursor++;
+        }
+        else {
+            char* numberEnd;
+            float value = std::strtof(cursor, &numberEnd);
+            if (numberEnd == cursor) {
+                throw std::runtime_error(fmt::format("{}: unexpected '{}' in outline", path, c));
+            }
+            cursor = numberEnd;
+            pending.push_back(value);
+            if (pending.size() == 2) {
+                ring.push_back({ pending[0], pending[1] });
+                pending.clear();
+            }
+        }
+    }
+    finishRing();
+    if (shape.rings.empty()) {
+        throw std::runtime_error(fmt::format("{}: no ring with at least three points", path));
+    }
+}
+
+int distanceSquared(int a, int b, int size) {
+    int dx = a % size - b % size;
+    int dy = a / size - b / size;
+    return dx * dx + dy * dy;
+}
+
+// One jump flood pass over rows [rowBegin, rowEnd): every texel adopts the
+// closest seed known to itself or to the eight texels `step` away
+void floodRows(const int* source, int* target, int size, int step, int rowBegin, int rowEnd) {
+    for (int y = rowBegin; y < rowEnd; ++y) {
+        for (int x = 0; x < size; ++x) {
+            int index = y * size + x;
+            int best = source[index];
+            int bestDistance = best >= 0 ? distanceSquared(index, best, size) : INT32_MAX;
+            for (int dy = -step; dy <= step; dy += step) {
+                int ny = y + dy;
+                if (ny < 0 || ny >= size) {
+                    continue;
+                }
+                for (int dx = -step; dx <= step; dx += step) {
+                    int nx = x + dx;
+                    if (nx < 0 || nx >= size) {
+                        continue;
+                    }
+                    int seed = source[ny * size + nx];
+                    if (seed >= 0) {
+                        int distance = distanceSquared(index, seed, size);
+                        if (distance < bestDistance) {
+                            best = seed;
+                            bestDistance = distance;
+                        }
+                    }
+                }
+            }
+            target[index] = best;
+        }
+    }
+}
+
+}
+
+ContainerTransform ContainerMotion::at(double time) const {
+    ContainerTransform transform;
+    if (!active()) {
+        return transform;
+    }
+    double frequency = 6.283185307179586 / std::max(1e-3f, period);
+    double phase = std::fmod(time * frequency, 6.283185307179586);
+    double angle = std::fmod(static_cast<double>(spin) * time, 6.283185307179586);
+
+    transform.moving = true;
+    transform.cosAngle = static_cast<float>(std::cos(angle));
+    transform.sinAngle = static_cast<float>(std::sin(angle));
+    transform.angularVelocity = spin;
+    transform.scale = static_cast<float>(1.0 + pulseAmplitude * std::sin(phase));
+    transform.scaleRate = static_cast<float>(pulseAmplitude * frequency * std::cos(phase));
+    transform.x = static_cast<float>(swayAmplitude * std::sin(phase));
+    transform.vx = static_cast<float>(swayAmplitude * frequency * std::cos(phase));
+    return transform;
+}
+
+ContainerShape ContainerShape::regularPolygon(int sides, float radius) {
+    ContainerShape shape;
+    std::vector<Point> ring;
+    for (int i = 0; i < sides; ++i) {
+        // A vertex at the bottom, so polygons with a flat top and bottom stand level
+        float angle = -1.57079633f + 6.28318531f * static_cast<float>(i) / static_cast<float>(sides);
+        ring.push_back({ radius * std::cos(angle), radius * std::sin(angle) });
+    }
+    shape.rings.push_back(std::move(ring));
+    return shape;
+}
+
+ContainerShape ContainerShape::load(const std::string& path, float extent) {
+    ContainerShape shape;
+    std::string text = readFile(path);
+    if (endsWith(path, ".pgm")) {
+        parsePgm(path, text, shape);
+        shape.maskExtent = extent;
+    }
+    else {
+        parseOutline(path, text, shape);
+    }
+    return shape;
+}
+
+void ContainerShape::rasterizeRow(float y, float x0, float dx, int width, uint8_t* inside) const {
+    if (!mask.empty()) {
+        int row = static_cast<int>(std::floor((maskExtent - y) / (2.0f * maskExtent) * maskHeight));
+        for (int i = 0; i < width; ++i) {
+            float x = x0 + dx * static_cast<float>(i);
+            int column = static_cast<int>(std::floor((x + maskExtent) / (2.0f * maskExtent) * maskWidth));
+            bool inMask = row >= 0 && row < maskHeight && column >= 0 && column < maskWidth;
+            inside[i] = inMask ? mask[static_cast<size_t>(row) * maskWidth + column] : 0;
+        }
+        return;
+    }
+
+    // Even-odd scanline: a texel is inside when an odd number of edges cross the row to its left
+    thread_local std::vector<float> crossings;
+    crossings.clear();
+    for (const auto& ring : rings) {
+        for (size_t i = 0; i < ring.size(); ++i) {
+            const Point& a = ring[i];
+            const Point& b = ring[(i + 1) % ring.size()];
+            if ((a.y > y) != (b.y > y)) {
+                crossings.push_back(a.x + (y - a.y) * (b.x - a.x) / (b.y - a.y));
+            }
+        }
+    }
+    std::sort(crossings.begin(), crossings.end());
+    size_t passed = 0;
+    for (int i = 0; i < width; ++i) {
+        float x = x0 + dx * static_cast<float>(i);
+        while (passed < crossings.size() && crossings[passed] < x) {
+            passed++;
+        }
+        inside[i] = passed % 2;
+    }
+}
+
+DistanceField::DistanceField(int size, float extent)
+    : size(std::max(2, size)), extent(extent), texel(2.0f * extent / static_cast<float>(this->size)),
+      inverseTexel(1.0f / texel), distances(static_cast<size_t>(this->size) * this->size, 0.0f) {}
+
+float DistanceField::sample(float x, float y) const {
+    float fx = std::clamp((x + extent) * inverseTexel - 0.5f, 0.0f, static_cast<float>(size - 1));
+    float fy = std::clamp((y + extent) * inverseTexel - 0.5f, 0.0f, static_cast<float>(size - 1));
+    int x0 = std::min(static_cast<int>(fx), size - 2);
+    int y0 = std::min(static_cast<int>(fy), size - 2);
+    float tx = fx - static_cast<float>(x0);
+    float ty = fy - static_cast<float>(y0);
+    const float* row = distances.data() + static_cast<size_t>(y0) * size + x0;
+    float bottom = row[0] + (row[1] - row[0]) * tx;
+    float top = row[size] + (row[size + 1] - row[size]) * tx;
+    return bottom + (top - bottom) * ty;
+}
+
+void DistanceField::normal(float x, float y, float& nx, float& ny) const {
+    nx = sample(x + texel, y) - sample(x - texel, y);
+    ny = sample(x, y + texel) - sample(x, y - texel);
+    float length = std::sqrt(nx * nx + ny * ny);
+    if (length < 1e-12f) {
+        // Flat spot, e.g. exactly on a medial axis: fall back to pointing away from the center
+        length = std::max(std::sqrt(x * x + y * y), 1e-12f);
+        nx = x;
+        ny = y;
+    }
+    nx /= length;
+    ny /= length;
+}
+
+Task<void> buildDistanceField(ThreadPool& pool, const ContainerShape& shape, DistanceField& field) {
+    int size = field.getSize();
+    float extent = field.getExtent();
+    float texel = field.getTexelSize();
+    size_t texels = static_cast<size_t>(size) * size;
+
+    int bandCount = static_cast<int>(std::max(1u, pool.size())) * 4;
+    int bandRows = std::max(1, (size + bandCount - 1) / bandCount);
+    auto forEachBand = [&](auto&& work) {
+        std::vector<NodeTask> tasks;
+        for (int begin = 0; begin < size; begin += bandRows) {
+            int end = std::min(size, begin + bandRows);
+            tasks.push_back({ -1, [&work, begin, end] { work(begin, end); } });
+        }
+        return runTasks(pool, std::move(tasks));
+    };
+
+    // Seeds: each texel on one side starts as its own nearest texel of that side
+    std::vector<uint8_t> inside(texels);
+    std::vector<int> nearestOutside[2] = { std::vector<int>(texels), std::vector<int>(texels) };
+    std::vector<int> nearestInside[2] = { std::vector<int>(texels), std::vector<int>(texels) };
+    co_await forEachBand([&](int begin, int end) {
+        for (int y = begin; y < end; ++y) {
+            uint8_t* row = inside.data() + static_cast<size_t>(y) * size;
+            shape.rasterizeRow(-extent + (static_cast<float>(y) + 0.5f) * texel, -extent + 0.5f * texel, texel, size, row);
+            for (int x = 0; x < size; ++x) {
+                int index = y * size + x;
+                nearestOutside[0][index] = row[x] ? -1 : index;
+                nearestInside[0][index] = row[x] ? index : -1;
+            }
+        }
+    });
+
+    // Steps size/2, ..., 1, then 1 again to fix the few texels plain JFA gets wrong
+    int current = 0;
+    std::vector<int> steps;
+    for (int step = size / 2; step >= 1; step /= 2) {
+        steps.push_back(step);
+    }
+    steps.push_back(1);
+    for (int step : steps) {
+        co_await forEachBand([&](int begin, int end) {
+            floodRows(nearestOutside[current].data(), nearestOutside[1 - current].data(), size, step, begin, end);
+            floodRows(nearestInside[current].data(), nearestInside[1 - current].data(), size, step, begin, end);
+        });
+        current = 1 - current;
+    }
+
+    // Texel centers on either side of the outline are about half a texel from it
+    float far = 4.0f * extent;
+    co_await forEachBand([&](int begin, int end) {
+        float* distances = field.data();
+        for (int index = begin * size; index < end * size; ++index) {
+            int nearest = inside[index] ? nearestOutside[current][index] : nearestInside[current][index];
+            float distance = nearest >= 0
+                ? (std::sqrt(static_cast<float>(distanceSquared(index, nearest, size))) - 0.5f) * texel
+                : far;
+            distances[index] = inside[index] ? -distance : distance;
+        }
+    });
+}
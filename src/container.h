@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "scheduler.h"
+#include "simulation.h"
+#include "thread_pool.h"
+
+// Outline of a container in world coordinates: polygon rings filled with the
+// even-odd rule, or a raster mask covering [-maskExtent, maskExtent]^2.
+struct ContainerShape {
+    struct Point {
+        float x, y;
+    };
+
+    std::vector<std::vector<Point>> rings;
+    std::vector<uint8_t> mask;  // Row-major from the top row; nonzero = inside
+    int maskWidth = 0;
+    int maskHeight = 0;
+    float maskExtent = 1.0f;
+
+    static ContainerShape regularPolygon(int sides, float radius);
+
+    // Loads a binary or ASCII PGM mask (.pgm), or an outline: numbers as x y
+    // pairs, with the SVG path commands M (new ring), L and Z. Throws on errors.
+    static ContainerShape load(const std::string& path, float extent);
+
+    // Fills `inside` for a row of `width` texel centers at height y, starting at x0 with spacing dx
+    void rasterizeRow(float y, float x0, float dx, int width, uint8_t* inside) const;
+};
+
+// Signed distance to a container's wall, sampled on a size x size grid over
+// [-extent, extent]^2. Negative inside the container, positive outside, in
+// world units. Texel (0, 0) is at the bottom left.
+class DistanceField {
+public:
+    DistanceField() = default;
+    DistanceField(int size, float extent);
+
+    int getSize() const { return size; }
+    float getExtent() const { return extent; }
+    float getTexelSize() const { return texel; }
+    const float* data() const { return distances.data(); }
+    float* data() { return distances.data(); }
+
+    // Bilinear interpolation; points beyond the grid clamp to its border
+    float sample(float x, float y) const;
+
+    // Unit gradient at (x, y), pointing out of the container
+    void normal(float x, float y, float& nx, float& ny) const;
+
+private:
+    int size = 0;
+    float extent = 0.0f;
+    float texel = 0.0f;
+    float inverseTexel = 0.0f;
+    std::vector<float> distances;
+};
+
+// Periodic container animation over simulated time: a steady spin, plus a size
+// pulse and a horizontal sway that share one period
+struct ContainerMotion {
+    float spin = 0.0f;            // Radians per unit of simulated time
+    float pulseAmplitude = 0.0f;  // Fraction of the size
+    float swayAmplitude = 0.0f;   // World units
+    float period = 4.0f;
+
+    bool active() const { return spin != 0.0f || pulseAmplitude != 0.0f || swayAmplitude != 0.0f; }
+    ContainerTransform at(double time) const;
+};
+
+// Rasterizes `shape` and fills `field` with a jump flood: every texel finds its
+// nearest texel on the other side of the outline in log2(size) + 1 passes, each
+// split into row bands on the pool.
+Task<void> buildDistanceField(ThreadPool& pool, const ContainerShape& shape, DistanceField& field);
@@ -0,0 +1,309 @@
+#include "control_server.h"
+
+#include <cstdio>
+#include <sstream>
+#include <stdexcept>
+#include <unordered_map>
+#include <fmt/core.h>
+
+#include "metrics.h"
+#include "simulation.h"
+
+#ifdef __linux__
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#endif
+
+namespace {
+
+const size_t QUEUE_CAPACITY = 1024;
+const size_t MAX_LINE_BYTES = 4096;
+const int MAX_EVENTS = 32;
+const int MAX_STEPS = 100000;
+
+struct Connection {
+    std::string input;
+    std::string output;
+    bool closing = false;  // Peer is done sending; close once the replies are out
+};
+
+// Whether the line has nothing left but whitespace
+bool atEnd(std::istringstream& stream) {
+    stream >> std::ws;
+    return stream.eof();
+}
+
+}
+
+std::string ControlServer::execute(const std::string& line) {
+    std::istringstream stream(line);
+    std::string verb;
+    if (!(stream >> verb)) {
+        return "";
+    }
+
+    ControlCommand command;
+    if (verb == "spawn") {
+        command.type = CommandType::Spawn;
+        if (!(stream >> command.count) || command.count <= 0 || static_cast<size_t>(command.count) > MAX_SPAWN_BALLS) {
+            return fmt::format("error spawn expects a count from 1 to {}", MAX_SPAWN_BALLS);
+        }
+        if (!atEnd(stream)) {
+            if (!(stream >> command.x >> command.y) || !atEnd(stream)) {
+                return "error spawn expects both X and Y";
+            }
+            command.positioned = true;
+        }
+    }
+    else if (verb == "gravity" || verb == "center-bias") {
+        command.type = verb == "gravity" ? CommandType::Gravity : CommandType::CenterBias;
+        if (!(stream >> command.value) || !atEnd(stream)) {
+            return fmt::format("error {} expects a number", verb);
+        }
+        if (command.type == CommandType::CenterBias && (command.value < 0.0f || command.value > 1.0f)) {
+            return "error center-bias expects a value from 0 to 1";
+        }
+    }
+    else if (verb == "pause") {
+        command.type = CommandType::Pause;
+    }
+    else if (verb == "resume") {
+        command.type = CommandType::Resume;
+    }
+    else if (verb == "step") {
+        command.type = CommandType::Step;
+        int steps = 1;
+        if (!atEnd(stream) && (!(stream >> steps) || !atEnd(stream) || steps <= 0 || steps > MAX_STEPS)) {
+            return fmt::format("error step expects a count from 1 to {}", MAX_STEPS);
+        }
+        command.count = steps;
+    }
+    else if (verb == "snapshot") {
+        command.type = CommandType::Snapshot;
+        if (!(stream >> command.path)) {
+            return "error snapshot expects a path";
+        }
+    }
+    else if (verb == "metrics") {
+        return metrics::formatPrometheus(metrics::registry().snapshot()) + "ok";
+    }
+    else {
+        return fmt::format("error unknown command {}", verb);
+    }
+
+    return commands.push(std::move(command)) ? "ok" : "error queue full";
+}
+
+#ifdef __linux__
+
+namespace {
+
+// Clears the way for binding `address`. Only a socket nobody listens on any
+// more is removed; any other file, or a live server's socket, is reported.
+void removeStaleSocket(const sockaddr_un& address, const std::string& path) {
+    struct stat info;
+    if (lstat(path.c_str(), &info) < 0) {
+        if (errno == ENOENT) {
+            return;
+        }
+        throw std::runtime_error(fmt::format("Failed to check control socket {}: {}", path, std::strerror(errno)));
+    }
+    if (!S_ISSOCK(info.st_mode)) {
+        throw std::runtime_error(fmt::format("Control socket path {} exists and is not a socket", path));
+    }
+    int probe = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (probe < 0) {
+        throw std::runtime_error(fmt::format("Failed to create control socket: {}", std::strerror(errno)));
+    }
+    bool refused = connect(probe, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) < 0
+        && errno == ECONNREFUSED;
+    close(probe);
+    if (!refused) {
+        throw std::runtime_error(fmt::format("Control socket {} is in use by another run", path));
+    }
+    unlink(path.c_str());
+}
+
+}
+
+ControlServer::ControlServer(const std::string& path)
+    : path(path), commands(QUEUE_CAPACITY) {
+    sockaddr_un address{};
+    if (path.size() >= sizeof(address.sun_path)) {
+        throw std::runtime_error(fmt::format("Control socket path is too long: {}", path));
+    }
+    address.sun_family = AF_UNIX;
+    std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+
+    // A socket file left behind by a crashed run would make bind fail
+    removeStaleSocket(address, path);
+    listenFd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (listenFd < 0) {
+        throw std::runtime_error(fmt::format("Failed to create control socket: {}", std::strerror(errno)));
+    }
+    if (bind(listenFd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0 || listen(listenFd, 8) < 0) {
+        int error = errno;
+        close(listenFd);
+        throw std::runtime_error(fmt::format("Failed to listen on {}: {}", path, std::strerror(error)));
+    }
+
+    epollFd = epoll_create1(EPOLL_CLOEXEC);
+    if (epollFd < 0) {
+        int error = errno;
+        close(listenFd);
+        unlink(path.c_str());
+        throw std::runtime_error(fmt::format("Failed to create control epoll instance: {}", std::strerror(error)));
+    }
+    stopFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (stopFd < 0) {
+        int error = errno;
+        close(epollFd);
+        close(listenFd);
+        unlink(path.c_str());
+        throw std::runtime_error(fmt::format("Failed to create control stop event: {}", std::strerror(error)));
+    }
+    epoll_event event{};
+    event.events = EPOLLIN;
+    event.data.fd = listenFd;
+    epoll_ctl(epollFd, EPOLL_CTL_ADD, listenFd, &event);
+    event.data.fd = stopFd;
+    epoll_ctl(epollFd, EPOLL_CTL_ADD, stopFd, &event);
+
+    thread = std::thread([this] { run(); });
+}
+
+ControlServer::~ControlServer() {
+    uint64_t one = 1;
+    if (write(stopFd, &one, sizeof(one)) < 0) {
+        std::fprintf(stderr, "Failed to stop control server\n");
+    }
+    thread.join();
+    close(stopFd);
+    close(epollFd);
+    close(listenFd);
+    unlink(path.c_str());
+}
+
+void ControlServer::run() {
+    std::unordered_map<int, Connection> connections;
+    auto closeConnection = [&](int fd) {
+        epoll_ctl(epollFd, EPOLL_CTL_DEL, fd, nullptr);
+        close(fd);
+        connections.erase(fd);
+    };
+
+    // Sends what the socket takes and waits for EPOLLOUT while replies are pending
+    auto flush = [&](int fd, Connection& connection) {
+        while (!connection.output.empty()) {
+            ssize_t sent = send(fd, connection.output.data(), connection.output.size(), MSG_NOSIGNAL);
+            if (sent < 0) {
+                if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                    return false;
+                }
+                break;
+            }
+            connection.output.erase(0, static_cast<size_t>(sent));
+        }
+        epoll_event event{};
+        event.events = (connection.closing ? 0u : uint32_t(EPOLLIN)) | (connection.output.empty() ? 0u : uint32_t(EPOLLOUT));
+        event.data.fd = fd;
+        epoll_ctl(epollFd, EPOLL_CTL_MOD, fd, &event);
+        return true;
+    };
+
+    epoll_event events[MAX_EVENTS];
+    for (;;) {
+        int ready = epoll_wait(epollFd, events, MAX_EVENTS, -1);
+        if (ready < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            std::fprintf(stderr, "Control server stopped: %s\n", std::strerror(errno));
+            break;
+        }
+
+        for (int i = 0; i < ready; ++i) {
+            int fd = events[i].data.fd;
+            if (fd == stopFd) {
+                for (auto& [open, connection] : connections) {
+                    close(open);
+                }
+                return;
+            }
+
+            if (fd == listenFd) {
+                int client;
+                while ((client = accept4(listenFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0) {
+                    epoll_event event{};
+                    event.events = EPOLLIN;
+                    event.data.fd = client;
+                    epoll_ctl(epollFd, EPOLL_CTL_ADD, client, &event);
+                    connections[client];
+                }
+                continue;
+            }
+
+            auto found = connections.find(fd);
+            if (found == connections.end()) {
+                continue;
+            }
+            Connection& connection = found->second;
+
+            char buffer[1024];
+            if ((events[i].events & EPOLLIN) && !connection.closing) {
+                for (;;) {
+                    ssize_t received = recv(fd, buffer, sizeof(buffer), 0);
+                    if (received > 0) {
+                        connection.input.append(buffer, static_cast<size_t>(received));
+                        continue;
+                    }
+                    connection.closing = received == 0 || (errno != EAGAIN && errno != EWOULDBLOCK);
+                    break;
+                }
+            }
+
+            size_t newline;
+            while ((newline = connection.input.find('\n')) != std::string::npos) {
+                std::string line = connection.input.substr(0, newline);
+                connection.input.erase(0, newline + 1);
+                if (!line.empty() && line.back() == '\r') {
+                    line.pop_back();
+                }
+                std::string reply = execute(line);
+                if (!reply.empty()) {
+                    connection.output += reply + "\n";
+                }
+            }
+            if (connection.input.size() > MAX_LINE_BYTES) {
+                connection.output += "error line too long\n";
+                connection.input.clear();
+                connection.closing = true;
+            }
+
+            if (!flush(fd, connection) || (connection.closing && connection.output.empty())) {
+                closeConnection(fd);
+            }
+        }
+    }
+}
+
+#else
+
+ControlServer::ControlServer(const std::string& path)
+    : path(path), commands(QUEUE_CAPACITY) {
+    throw std::runtime_error("The control socket is only available on Linux");
+}
+
+ControlServer::~ControlServer() {
+}
+
+void ControlServer::run() {
+}
+
+#endif
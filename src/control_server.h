@@ -0,0 +1,67 @@
+#pragma once
+
+#include <string>
+#include <thread>
+
+#include "spsc_queue.h"
+
+enum class CommandType {
+    Spawn,       // count balls at (x, y), or at random positions
+    Gravity,     // value
+    CenterBias,  // value
+    Pause,
+    Resume,
+    Step,        // count ticks while paused
+    Snapshot     // path
+};
+
+struct ControlCommand {
+    CommandType type = CommandType::Pause;
+    int count = 0;
+    bool positioned = false;
+    float x = 0.0f;
+    float y = 0.0f;
+    float value = 0.0f;
+    std::string path;
+};
+
+// Line-based command interface on a Unix-domain stream socket, served from its
+// own thread with epoll. Parsed commands go through a lock-free queue that the
+// render thread drains between ticks, so a script never blocks the frame loop.
+//
+//   spawn N [X Y]      N balls at (X, Y) in world units, random positions without them;
+//                      at most MAX_SPAWN_BALLS per command and per tick
+//   gravity G          set gravity
+//   center-bias B      set the bounce pull toward the center, 0 to 1
+//   pause | resume
+//   step [N]           advance N ticks (default 1) while paused
+//   snapshot PATH      write the next presented tick to PATH as CSV
+//   metrics            reply with the metrics in Prometheus text format
+//
+// Every command gets one reply line, "ok" or "error <reason>"; metrics replies
+// with the exposition text followed by "ok". Linux only.
+class ControlServer {
+public:
+    // Replaces a socket left at `path` by a crashed run; throws when the path
+    // is another file or a live server's socket
+    explicit ControlServer(const std::string& path);
+    ~ControlServer();
+
+    ControlServer(const ControlServer&) = delete;
+    ControlServer& operator=(const ControlServer&) = delete;
+
+    // Render thread: takes the next queued command, if any
+    bool poll(ControlCommand& command) { return commands.pop(command); }
+
+private:
+    void run();
+    // Parses one line and queues it; returns the reply
+    std::string execute(const std::string& line);
+
+    std::string path;
+    SpscQueue<ControlCommand> commands;
+    int listenFd = -1;
+    int epollFd = -1;
+    int stopFd = -1;
+    std::thread thread;
+};
@@ -0,0 +1,102 @@
+#include "frame_pipeline.h"
+
+#include <algorithm>
+
+FramePipeline::FramePipeline(ThreadPool& pool, ThreadPool& audioPool, Profiler& profiler, int depth, FrameStages stages)
+    : pool(pool), audioPool(audioPool), profiler(profiler), depth(std::max(1, depth)),
+      stages(std::move(stages)), slots(this->depth) {}
+
+FramePipeline::~FramePipeline() {
+    // Unpresented ticks still hold their audio stage; let them finish
+    while (!inFlight.empty()) {
+        inFlight.front()->packed->wait();
+        pop();
+    }
+    for (auto& done : running) {
+        done->wait();
+    }
+}
+
+Task<void> FramePipeline::runTick(FrameSlot& slot, FrameInput input,
+    std::shared_ptr<Event> previousSimulated, std::shared_ptr<Event> earlierPacked) {
+    co_await resumeOn(pool);
+    if (previousSimulated) {
+        co_await *previousSimulated;
+    }
+    if (earlierPacked) {
+        co_await *earlierPacked;
+    }
+
+    // A failed stage must still set the events, or later ticks and the render thread wait forever
+    slot.error = nullptr;
+    slot.wallHits = 0;
+    slot.instanceCount = 0;
+    try {
+        auto begin = Profiler::Clock::now();
+        co_await stages.spawn(input);
+        slot.wallHits = co_await stages.physics(input);
+        slot.container = input.params.transform;
+        profiler.record(Stage::Simulate, input.tick, begin, Profiler::Clock::now());
+    }
+    catch (...) {
+        slot.error = std::current_exception();
+    }
+    slot.simulated->set();
+
+    if (!slot.error) {
+        try {
+            auto begin = Profiler::Clock::now();
+            slot.instanceCount = stages.pack(input.tick, slot.instances);
+            profiler.record(Stage::Pack, input.tick, begin, Profiler::Clock::now());
+        }
+        catch (...) {
+            slot.error = std::current_exception();
+        }
+    }
+
+    // The slot may be reused as soon as it is presented, so keep what audio needs
+    size_t wallHits = slot.wallHits;
+    std::shared_ptr<Event> presented = slot.presented;
+    slot.packed->set();
+
+    co_await *presented;
+    stages.audio(wallHits);
+}
+
+void FramePipeline::push(FrameInput input) {
+    uint64_t tick = nextTick++;
+    input.tick = tick;
+
+    // Slots are reused round-robin; the previous user of this one has already been popped
+    FrameSlot& slot = slots[tick % slots.size()];
+    slot.tick = tick;
+    slot.simulated = std::make_shared<Event>(pool);
+    slot.packed = std::make_shared<Event>(pool);
+    slot.presented = std::make_shared<Event>(audioPool);
+
+    auto done = std::make_shared<Event>(pool);
+    launch(runTick(slot, std::move(input), lastSimulated, packHistory[tick % 2]), done);
+
+    lastSimulated = slot.simulated;
+    packHistory[tick % 2] = slot.packed;
+    inFlight.push_back(&slot);
+
+    running.push_back(done);
+    while (!running.empty() && running.front()->isSet()) {
+        running.pop_front();
+    }
+}
+
+FrameSlot& FramePipeline::front() {
+    FrameSlot& slot = *inFlight.front();
+    slot.packed->wait();
+    if (slot.error) {
+        std::rethrow_exception(slot.error);
+    }
+    return slot;
+}
+
+void FramePipeline::pop() {
+    inFlight.front()->presented->set();
+    inFlight.pop_front();
+}
@@ -0,0 +1,113 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "interaction.h"
+#include "profiler.h"
+#include "render_data.h"
+#include "scheduler.h"
+#include "simulation.h"
+#include "thread_pool.h"
+
+// `count` balls at (x, y), or at random positions when `positioned` is false
+struct SpawnRequest {
+    int count = 0;
+    bool positioned = false;
+    float x = 0.0f;
+    float y = 0.0f;
+};
+
+struct FrameInput {
+    uint64_t tick = 0;  // Assigned by push()
+    float deltaTime = 0.0f;
+    int spawnCount = 0;  // Random balls from the keyboard
+    std::vector<SpawnRequest> spawns;  // Batched spawns from scripts
+    std::vector<Brush> brushes;  // Mouse actions
+    SimParams params;
+};
+
+// Everything the render thread needs to present one simulated tick
+struct FrameSlot {
+    uint64_t tick = 0;
+    InstanceBuffer instances;
+    size_t instanceCount = 0;
+    size_t wallHits = 0;
+    ContainerTransform container;  // Where to draw the wall for this tick
+    std::exception_ptr error;  // Set when a stage threw; the tick has nothing to present
+    std::shared_ptr<Event> simulated;
+    std::shared_ptr<Event> packed;
+    std::shared_ptr<Event> presented;
+};
+
+// Per-tick work, called from pool workers in this order for each tick
+struct FrameStages {
+    // Adds the balls requested by input before the tick is simulated.
+    // May fan out across the pool; the tick resumes when it completes.
+    std::function<Task<void>(const FrameInput& input)> spawn;
+    // Advances the simulation to input.tick and returns the number of wall hits.
+    // May fan out across the pool; the tick resumes when it completes.
+    std::function<Task<size_t>(const FrameInput& input)> physics;
+    // Packs the state of the given tick into instance data and returns the instance count.
+    std::function<size_t(uint64_t tick, InstanceBuffer& instances)> pack;
+    // Plays the sounds of a tick once it is on screen; runs on the audio pool.
+    std::function<void(size_t wallHits)> audio;
+};
+
+// Runs each tick as a coroutine on the pool with up to `depth` ticks in flight,
+// so physics for the next tick and packing for the current one overlap with GL
+// submission on the render thread.
+//
+// Stage dependencies, each expressed as a co_await on the earlier stage:
+//   spawn+physics(N) after physics(N-1) and after pack(N-2), whose state buffer it reuses
+//   pack(N)          after physics(N)
+//   submit(N)        on the render thread after pack(N)
+//   audio(N)         after submit(N), resumed on the audio pool
+//
+// Depth 1 runs the stages back to back with no added latency; every extra level
+// adds one frame of input latency in exchange for more overlap.
+class FramePipeline {
+public:
+    FramePipeline(ThreadPool& pool, ThreadPool& audioPool, Profiler& profiler, int depth, FrameStages stages);
+    ~FramePipeline();
+
+    FramePipeline(const FramePipeline&) = delete;
+    FramePipeline& operator=(const FramePipeline&) = delete;
+
+    // Starts the coroutine for the next tick.
+    void push(FrameInput input);
+
+    // True once `depth` ticks are in flight and the oldest one must be presented.
+    bool ready() const { return inFlight.size() >= static_cast<size_t>(depth); }
+    bool empty() const { return inFlight.empty(); }
+
+    // Blocks the render thread until the oldest tick is packed; valid until pop().
+    // Rethrows the exception of a stage that failed; pop() the tick all the same.
+    FrameSlot& front();
+    // Marks the oldest tick as presented, releasing its audio and its slot.
+    void pop();
+
+    int getDepth() const { return depth; }
+
+private:
+    Task<void> runTick(FrameSlot& slot, FrameInput input,
+        std::shared_ptr<Event> previousSimulated, std::shared_ptr<Event> earlierPacked);
+
+    ThreadPool& pool;
+    ThreadPool& audioPool;
+    Profiler& profiler;
+    int depth;
+    FrameStages stages;
+
+    std::vector<FrameSlot> slots;
+    std::deque<FrameSlot*> inFlight;
+    std::deque<std::shared_ptr<Event>> running;
+    uint64_t nextTick = 1;
+    std::shared_ptr<Event> lastSimulated;
+    std::shared_ptr<Event> packHistory[2];
+};
@@ -0,0 +1,148 @@
+#include "input.h"
+
+#include <algorithm>
+#include <cmath>
+#include <GLFW/glfw3.h>
+
+namespace {
+
+const float MIN_BRUSH_RADIUS = 0.02f;
+const float MAX_BRUSH_RADIUS = 0.9f;
+const float BRUSH_SCROLL_STEP = 1.15f;  // Radius factor per wheel step
+
+}
+
+InputQueue::InputQueue(GLFWwindow* window, SpawnKeyConfig spawnKey, size_t capacity)
+    : window(window), spawnKey(spawnKey), events(capacity) {
+    glfwSetWindowUserPointer(window, this);
+    glfwSetKeyCallback(window, keyCallback);
+    glfwSetMouseButtonCallback(window, mouseButtonCallback);
+    glfwSetCursorPosCallback(window, cursorPosCallback);
+    glfwSetScrollCallback(window, scrollCallback);
+}
+
+InputQueue::~InputQueue() {
+    glfwSetKeyCallback(window, nullptr);
+    glfwSetMouseButtonCallback(window, nullptr);
+    glfwSetCursorPosCallback(window, nullptr);
+    glfwSetScrollCallback(window, nullptr);
+    glfwSetWindowUserPointer(window, nullptr);
+}
+
+void InputQueue::keyCallback(GLFWwindow* window, int key, int scancode, int action, int mods) {
+    record(window, { InputEventType::Key, key, action, mods, 0.0, 0.0, glfwGetTime() });
+}
+
+void InputQueue::mouseButtonCallback(GLFWwindow* window, int button, int action, int mods) {
+    double x, y;
+    glfwGetCursorPos(window, &x, &y);
+    record(window, { InputEventType::MouseButton, button, action, mods, x, y, glfwGetTime() });
+}
+
+void InputQueue::cursorPosCallback(GLFWwindow* window, double x, double y) {
+    record(window, { InputEventType::CursorMove, 0, 0, 0, x, y, glfwGetTime() });
+}
+
+void InputQueue::scrollCallback(GLFWwindow* window, double x, double y) {
+    record(window, { InputEventType::Scroll, 0, 0, 0, x, y, glfwGetTime() });
+}
+
+void InputQueue::record(GLFWwindow* window, InputEvent event) {
+    auto* queue = static_cast<InputQueue*>(glfwGetWindowUserPointer(window));
+    if (queue && !queue->events.push(event)) {
+        queue->droppedEvents++;
+    }
+}
+
+void InputQueue::drain() {
+    InputEvent event;
+    while (events.pop(event)) {
+        apply(event);
+    }
+}
+
+void InputQueue::apply(const InputEvent& event) {
+    switch (event.type) {
+    case InputEventType::CursorMove:
+        cursorX = event.x;
+        cursorY = event.y;
+        return;
+    case InputEventType::MouseButton:
+        cursorX = event.x;
+        cursorY = event.y;
+        buttonMods = event.mods;
+        if (event.action == GLFW_PRESS) {
+            heldButtons |= 1 << event.code;
+        }
+        else if (event.action == GLFW_RELEASE) {
+            heldButtons &= ~(1 << event.code);
+        }
+        return;
+    case InputEventType::Scroll:
+        scrolled += event.y;
+        return;
+    case InputEventType::Key:
+        break;
+    }
+
+    if (event.code == GLFW_KEY_ESCAPE && event.action == GLFW_PRESS) {
+        glfwSetWindowShouldClose(window, true);
+    }
+    else if (event.code == GLFW_KEY_SPACE) {
+        // GLFW_REPEAT follows the OS key repeat rate; holding is handled per tick instead
+        if (event.action == GLFW_PRESS) {
+            pendingSpawns += spawnKey.burst;
+            spawnKeyHeld = true;
+            spawnKeyPressedAt = event.time;
+        }
+        else if (event.action == GLFW_RELEASE) {
+            spawnKeyHeld = false;
+        }
+    }
+}
+
+int InputQueue::takeSpawns(double now) {
+    drain();
+    int count = pendingSpawns;
+    pendingSpawns = 0;
+    if (spawnKeyHeld && spawnKey.repeatPerTick > 0 && now - spawnKeyPressedAt >= spawnKey.repeatDelay) {
+        count += spawnKey.repeatPerTick;
+    }
+    return count;
+}
+
+bool InputQueue::takeBrush(const Viewport& viewport, Brush& brush) {
+    if (scrolled != 0.0) {
+        brushRadius = std::clamp(brushRadius * std::pow(BRUSH_SCROLL_STEP, static_cast<float>(scrolled)),
+            MIN_BRUSH_RADIUS, MAX_BRUSH_RADIUS);
+        scrolled = 0.0;
+    }
+    if (heldButtons == 0) {
+        grabbing = false;
+        return false;
+    }
+
+    int windowWidth, windowHeight, framebufferWidth, framebufferHeight;
+    glfwGetWindowSize(window, &windowWidth, &windowHeight);
+    glfwGetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
+    cursorToWorld(viewport, cursorX, cursorY, windowWidth, windowHeight, framebufferWidth, framebufferHeight,
+        brush.x, brush.y);
+    brush.radius = brushRadius;
+
+    bool grab = (heldButtons & (1 << GLFW_MOUSE_BUTTON_RIGHT)) != 0;
+    if (heldButtons & (1 << GLFW_MOUSE_BUTTON_MIDDLE)) {
+        brush.tool = BrushTool::Delete;
+    }
+    else if (grab) {
+        brush.tool = BrushTool::Grab;
+        brush.moveX = grabbing ? brush.x - grabX : 0.0f;
+        brush.moveY = grabbing ? brush.y - grabY : 0.0f;
+        grabX = brush.x;
+        grabY = brush.y;
+    }
+    else {
+        brush.tool = (buttonMods & GLFW_MOD_SHIFT) ? BrushTool::Pull : BrushTool::Push;
+    }
+    grabbing = brush.tool == BrushTool::Grab;
+    return true;
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "interaction.h"
+#include "spsc_queue.h"
+
+struct GLFWwindow;
+
+enum class InputEventType {
+    Key,
+    MouseButton,
+    CursorMove,
+    Scroll
+};
+
+struct InputEvent {
+    InputEventType type = InputEventType::Key;
+    int code = 0;    // GLFW key or mouse button
+    int action = 0;  // GLFW_PRESS, GLFW_RELEASE or GLFW_REPEAT
+    int mods = 0;
+    double x = 0.0;  // Cursor position in window coordinates, or scroll offset
+    double y = 0.0;
+    double time = 0.0;  // glfwGetTime() when the event arrived
+};
+
+// How the space bar spawns balls
+struct SpawnKeyConfig {
+    int burst = 1;              // Balls per press
+    int repeatPerTick = 0;      // Balls per tick while held; 0 = no repeat
+    double repeatDelay = 0.25;  // Seconds the key must be held before repeating
+};
+
+// Receives GLFW key and mouse callbacks into a lock-free queue, so presses
+// between frames are never lost and the callbacks only copy the event. The
+// render loop drains the queue and takes the resulting spawns at each tick
+// boundary. Nothing runs when there is no input.
+class InputQueue {
+public:
+    // Installs the callbacks on `window`, replacing its user pointer
+    InputQueue(GLFWwindow* window, SpawnKeyConfig spawnKey, size_t capacity = 1024);
+    ~InputQueue();
+
+    InputQueue(const InputQueue&) = delete;
+    InputQueue& operator=(const InputQueue&) = delete;
+
+    // Applies every queued event. Call once per loop iteration.
+    void drain();
+
+    // Balls to spawn in the tick starting at `now`: a burst for every press since
+    // the last tick, plus the repeat rate while the key has been held long enough
+    int takeSpawns(double now);
+
+    // Brush for the mouse buttons held at the tick starting now: left pushes
+    // (Shift pulls), right grabs, middle deletes; the wheel resizes it. Returns
+    // false when no button is held.
+    bool takeBrush(const Viewport& viewport, Brush& brush);
+
+    // Events lost because the queue was full
+    uint64_t dropped() const { return droppedEvents; }
+
+private:
+    static void keyCallback(GLFWwindow* window, int key, int scancode, int action, int mods);
+    static void mouseButtonCallback(GLFWwindow* window, int button, int action, int mods);
+    static void cursorPosCallback(GLFWwindow* window, double x, double y);
+    static void scrollCallback(GLFWwindow* window, double x, double y);
+    static void record(GLFWwindow* window, InputEvent event);
+
+    void apply(const InputEvent& event);
+
+    GLFWwindow* window;
+    SpawnKeyConfig spawnKey;
+    SpscQueue<InputEvent> events;
+    uint64_t droppedEvents = 0;  // Written by the producer only
+
+    // Consumer state
+    int pendingSpawns = 0;
+    bool spawnKeyHeld = false;
+    double spawnKeyPressedAt = 0.0;
+    double cursorX = 0.0;
+    double cursorY = 0.0;
+    int heldButtons = 0;  // Bit per GLFW mouse button
+    int buttonMods = 0;
+    double scrolled = 0.0;  // Wheel steps since the last takeBrush()
+    float brushRadius = 0.1f;
+    bool grabbing = false;
+    float grabX = 0.0f;  // World position of the cursor at the previous grab tick
+    float grabY = 0.0f;
+};
@@ -0,0 +1,91 @@
+#include "interaction.h"
+
+#include <algorithm>
+#include <cmath>
+
+void cursorToWorld(const Viewport& viewport, double cursorX, double cursorY, int windowWidth, int windowHeight,
+    int framebufferWidth, int framebufferHeight, float& x, float& y) {
+    double scaleX = windowWidth > 0 ? static_cast<double>(framebufferWidth) / windowWidth : 1.0;
+    double scaleY = windowHeight > 0 ? static_cast<double>(framebufferHeight) / windowHeight : 1.0;
+    double pixelX = cursorX * scaleX;
+    double pixelY = framebufferHeight - cursorY * scaleY;  // glViewport y is measured from the bottom
+
+    // The scene is drawn straight in normalized device coordinates
+    x = static_cast<float>((pixelX - viewport.x) / std::max(1, viewport.width) * 2.0 - 1.0);
+    y = static_cast<float>((pixelY - viewport.y) / std::max(1, viewport.height) * 2.0 - 1.0);
+}
+
+size_t applyBrushes(BallVector& balls, SpatialGrid& grid, const std::vector<Brush>& brushes, float deltaTime,
+    const SimParams& params, HandleVector* handles, std::vector<BallHandle>* deleted) {
+    thread_local std::vector<uint32_t> hits;
+    float adjustedDeltaTime = std::max(deltaTime, 1e-4f) * SIMULATION_SPEED;
+    size_t affected = 0;
+
+    bool gridCurrent = true;
+    for (const auto& brush : brushes) {
+        if (!gridCurrent) {
+            grid.build(balls.data(), balls.size());
+            gridCurrent = true;
+        }
+        hits.clear();
+        grid.query(balls.data(), brush.x, brush.y, brush.radius, hits);
+        affected += hits.size();
+
+        switch (brush.tool) {
+        case BrushTool::Push:
+        case BrushTool::Pull: {
+            float sign = brush.tool == BrushTool::Push ? 1.0f : -1.0f;
+            for (uint32_t i : hits) {
+                Ball& ball = balls[i];
+                float dx = ball.x - brush.x;
+                float dy = ball.y - brush.y;
+                float distance = std::sqrt(dx * dx + dy * dy);
+                if (distance < 1e-6f) {
+                    continue;
+                }
+                float impulse = sign * brush.strength * (1.0f - distance / brush.radius) / distance;
+                ball.dx += dx * impulse;
+                ball.dy += dy * impulse;
+            }
+            break;
+        }
+        case BrushTool::Grab: {
+            // Velocity that covers the cursor movement in one tick, with gravity cancelled
+            float vx = brush.moveX / adjustedDeltaTime;
+            float vy = brush.moveY / adjustedDeltaTime + params.gravity * adjustedDeltaTime;
+            for (uint32_t i : hits) {
+                balls[i].dx = vx;
+                balls[i].dy = vy;
+            }
+            break;
+        }
+        case BrushTool::Delete: {
+            // Query order is by cell; compaction needs ball order
+            std::sort(hits.begin(), hits.end());
+            size_t next = 0;
+            size_t kept = 0;
+            for (size_t i = 0; i < balls.size(); ++i) {
+                if (next < hits.size() && hits[next] == i) {
+                    if (handles) {
+                        deleted->push_back((*handles)[i]);
+                    }
+                    next++;
+                    continue;
+                }
+                if (handles) {
+                    (*handles)[kept] = (*handles)[i];
+                }
+                balls[kept++] = balls[i];
+            }
+            balls.resize(kept);
+            if (handles) {
+                handles->resize(kept);
+            }
+            // Indices past the first deleted ball moved
+            gridCurrent = hits.empty();
+            break;
+        }
+        }
+    }
+    return affected;
+}
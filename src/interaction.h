@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "simulation.h"
+#include "spatial_grid.h"
+
+// Part of the framebuffer the scene is drawn to, as passed to glViewport
+struct Viewport {
+    int x = 0;
+    int y = 0;
+    int width = 0;
+    int height = 0;
+};
+
+// Maps a cursor position in window coordinates to world coordinates. Window and
+// framebuffer sizes differ on high-DPI displays; window y grows downwards.
+void cursorToWorld(const Viewport& viewport, double cursorX, double cursorY, int windowWidth, int windowHeight,
+    int framebufferWidth, int framebufferHeight, float& x, float& y);
+
+enum class BrushTool {
+    Push,    // Radial impulse away from the center
+    Pull,    // Radial impulse toward the center
+    Grab,    // Balls follow the cursor
+    Delete
+};
+
+// Mouse action applied to every ball within `radius` of (x, y) for one tick
+struct Brush {
+    BrushTool tool = BrushTool::Push;
+    float x = 0.0f;
+    float y = 0.0f;
+    float radius = 0.1f;
+    float strength = 1.5f;  // Push and Pull: speed added at the center, falling off to 0 at the edge
+    float moveX = 0.0f;     // Grab: cursor movement since the previous tick
+    float moveY = 0.0f;
+};
+
+// Applies the brushes in order to the balls of one slab. Candidates come from
+// `grid`, which must be up to date with `balls` and is shared by all brushes;
+// each brush then runs as one pass over its candidate list. Deleted balls are
+// removed, keeping the order of the rest, and the grid is rebuilt only if
+// another brush follows. With `handles`, they are removed along with their
+// balls and appended to `deleted`. Returns the number of balls affected.
+size_t applyBrushes(BallVector& balls, SpatialGrid& grid, const std::vector<Brush>& brushes, float deltaTime,
+    const SimParams& params, HandleVector* handles = nullptr, std::vector<BallHandle>* deleted = nullptr);
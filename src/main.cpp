@@ -1,30 +1,85 @@
 ﻿#include <fmt/core.h>
 #include <stdio.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <iostream>
+#include <memory>
 #include <vector>
 #include <cmath>
+#include <fstream>
 #include <random>
+#include <string>
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
 #include <AL/al.h>
 #include <AL/alc.h>
 #include <sndfile.h>
 
-const float BALL_RADIUS = 0.01f;
-
-struct Ball {
-    float x, y;
-    float dx, dy;
-    float r, g, b;  // Color
-    float addedMomentum;  // New variable to store added momentum
-};
+#include "affinity.h"
+#include "ball_stepper.h"
+#include "container.h"
+#include "control_server.h"
+#include "frame_pipeline.h"
+#include "input.h"
+#include "memory_tracking.h"
+#include "metrics.h"
+#include "metrics_server.h"
+#include "numa.h"
+#include "obstacles.h"
+#include "perf_counters.h"
+#include "profiler.h"
+#include "render_data.h"
+#include "rules.h"
+#include "scheduler.h"
+#include "shared_state.h"
+#include "simulation.h"
+#include "species.h"
+#include "thread_pool.h"
 
 const int WINDOW_WIDTH = 1080;
 const int WINDOW_HEIGHT = 1080;
 const float WALL_MARGIN = 100.0f;
-const float SIMULATION_SPEED = 0.5f;  // Adjust this to slow down the simulation (lower = slower)
+const float STEP_DELTA_TIME = 1.0f / 60.0f;  // Tick length for single steps while paused
+const uint32_t SPAWN_SEED = 0x3c6ef372u;  // Keeps spawn streams apart from the bounce jitter seeds
+
+// Kept in sync with glViewport for mapping the cursor into the scene
+Viewport viewport{ 0, 0, WINDOW_WIDTH, WINDOW_HEIGHT };
+
+metrics::Counter& soundsPlayedMetric = metrics::registry().counter("brainrot_sounds_played_total", "Wall hit sounds started");
+metrics::Counter& drawCallsMetric = metrics::registry().counter("brainrot_draw_calls_total", "OpenGL draw calls issued");
+metrics::Gauge& activeVoicesMetric = metrics::registry().gauge("brainrot_audio_voices_active", "Sound voices currently playing");
+metrics::Gauge& voiceCapacityMetric = metrics::registry().gauge("brainrot_audio_voices", "Sound voices available");
+metrics::Histogram& frameTimeMetric = metrics::registry().histogram("brainrot_frame_seconds",
+    "Time between presented frames", 1e-9);
 
 
+// Decoded PCM data, produced off the render thread
+struct SoundData {
+    memory::TaggedVector<short, memory::Tag::Audio> samples;
+    int channels = 0;
+    int sampleRate = 0;
+};
+
+SoundData decodeSound(const char* filename) {
+    SF_INFO sfinfo;
+    SNDFILE* sndfile = sf_open(filename, SFM_READ, &sfinfo);
+    if (!sndfile) {
+        throw std::runtime_error(fmt::format("Failed to open sound file: {}", filename));
+    }
+
+    SoundData sound;
+    sound.channels = sfinfo.channels;
+    sound.sampleRate = sfinfo.samplerate;
+    sound.samples.resize(sfinfo.frames * sfinfo.channels);
+    sf_count_t count = sf_read_short(sndfile, sound.samples.data(), sound.samples.size());
+    sf_close(sndfile);
+    if (count < 1) {
+        throw std::runtime_error("Failed to read sound file data");
+    }
+    return sound;
+}
+
 class SoundPlayer {
 private:
     ALCdevice* device;
@@ -33,7 +88,7 @@ private:
     ALuint buffer;
 
 public:
-    SoundPlayer(const char* filename) : device(nullptr), context(nullptr), source(0), buffer(0) {
+    SoundPlayer(const SoundData& sound) : device(nullptr), context(nullptr), source(0), buffer(0) {
         try {
             // Initialize OpenAL
             device = alcOpenDevice(nullptr);
@@ -50,29 +105,14 @@ public:
                 throw std::runtime_error("Failed to make OpenAL context current");
             }
 
-            // Load sound file
-            SF_INFO sfinfo;
-            SNDFILE* sndfile = sf_open(filename, SFM_READ, &sfinfo);
-            if (!sndfile) {
-                throw std::runtime_error(fmt::format("Failed to open sound file: {}", filename));
-            }
-
-            std::vector<short> samples(sfinfo.frames * sfinfo.channels);
-            sf_count_t count = sf_read_short(sndfile, samples.data(), samples.size());
-            if (count < 1) {
-                sf_close(sndfile);
-                throw std::runtime_error("Failed to read sound file data");
-            }
-            sf_close(sndfile);
-
             // Create OpenAL buffer and source
             alGenBuffers(1, &buffer);
             if (alGetError() != AL_NO_ERROR) {
                 throw std::runtime_error("Failed to generate OpenAL buffer");
             }
 
-            alBufferData(buffer, sfinfo.channels == 1 ? AL_FORMAT_MONO16 : AL_FORMAT_STEREO16,
-                samples.data(), samples.size() * sizeof(short), sfinfo.samplerate);
+            alBufferData(buffer, sound.channels == 1 ? AL_FORMAT_MONO16 : AL_FORMAT_STEREO16,
+                sound.samples.data(), sound.samples.size() * sizeof(short), sound.sampleRate);
             if (alGetError() != AL_NO_ERROR) {
                 throw std::runtime_error("Failed to fill OpenAL buffer");
             }
@@ -96,11 +136,20 @@ public:
 
     void play() {
         alSourcePlay(source);
+        soundsPlayedMetric.add();
         if (alGetError() != AL_NO_ERROR) {
             std::cerr << "Failed to play sound" << std::endl;
         }
     }
 
+    int activeVoices() const {
+        ALint state = AL_STOPPED;
+        alGetSourcei(source, AL_SOURCE_STATE, &state);
+        return state == AL_PLAYING ? 1 : 0;
+    }
+
+    static const int VOICE_COUNT = 1;
+
     ~SoundPlayer() {
         cleanup();
     }
@@ -123,26 +172,24 @@ private:
     }
 };
 
-std::vector<float> createCircleVertices(float radius, int segments) {
-    std::vector<float> vertices;
-    for (int i = 0; i <= segments; i++) {
-        float theta = 2.0f * 3.1415926f * float(i) / float(segments);
-        float x = radius * cosf(theta);
-        float y = radius * sinf(theta);
-        vertices.push_back(x);
-        vertices.push_back(y);
-        vertices.push_back(0.0f);
-    }
-    return vertices;
+// Decodes the sound file on the pool so the first frames are not held up by it
+Task<void> loadSound(ThreadPool& pool, const char* filename, std::unique_ptr<SoundPlayer>& player)
+{
+    co_await resumeOn(pool);
+    SoundData sound = decodeSound(filename);
+    player = std::make_unique<SoundPlayer>(sound);
 }
 
+using CaptureBuffer = memory::TaggedVector<float, memory::Tag::Capture>;
+
 const char* vertexShaderSource = R"glsl(
     #version 330 core
     layout (location = 0) in vec3 aPos;
     uniform vec2 offset;
+    uniform mat2 transform;
     void main()
     {
-        gl_Position = vec4(aPos.x + offset.x, aPos.y + offset.y, aPos.z, 1.0);
+        gl_Position = vec4(transform * aPos.xy + offset, aPos.z, 1.0);
     }
 )glsl";
 
@@ -156,180 +203,340 @@ const char* fragmentShaderSource = R"glsl(
     }
 )glsl";
 
-void framebuffer_size_callback(GLFWwindow* window, int width, int height)
-{
-    glViewport(0, 0, width, height);
-}
-
-
-Ball createRandomBall(float wallRadius) {
-    static std::random_device rd;
-    static std::mt19937 gen(rd());
-    std::uniform_real_distribution<float> pos(-wallRadius + BALL_RADIUS, wallRadius - BALL_RADIUS);
-    std::uniform_real_distribution<float> vel(-0.25f, 0.25f);
-
-    Ball ball;
-
-    do {
-        ball.x = pos(gen);
-        ball.y = pos(gen);
-    } while (std::sqrt(ball.x * ball.x + ball.y * ball.y) > wallRadius - BALL_RADIUS);
-
-    ball.dx = vel(gen);
-    ball.dy = vel(gen);
-    ball.addedMomentum = 1.05f;
-
-    // Color will be set in updateBalls function
-    return ball;
-}
+// Balls are drawn in one instanced call with per-instance offset, color and
+// radius, scaling a unit circle
+const char* ballVertexShaderSource = R"glsl(
+    #version 330 core
+    layout (location = 0) in vec3 aPos;
+    layout (location = 1) in vec2 aOffset;
+    layout (location = 2) in vec3 aColor;
+    layout (location = 3) in float aRadius;
+    out vec3 ballColor;
+    void main()
+    {
+        gl_Position = vec4(aPos.xy * aRadius + aOffset, aPos.z, 1.0);
+        ballColor = aColor;
+    }
+)glsl";
 
+// Container wall drawn from its distance field: a line where the distance is near zero
+const char* fieldVertexShaderSource = R"glsl(
+    #version 330 core
+    layout (location = 0) in vec2 aPos;
+    uniform float extent;
+    uniform vec2 offset;
+    uniform mat2 transform;
+    out vec2 fieldCoord;
+    void main()
+    {
+        fieldCoord = aPos * 0.5 + 0.5;
+        gl_Position = vec4(transform * (aPos * extent) + offset, 0.0, 1.0);
+    }
+)glsl";
 
-Ball createDuplicateBall(const Ball& original, float momentumReduction) {
-    Ball newBall = original;
-    newBall.dx *= momentumReduction;
-    newBall.dy *= momentumReduction;
-    newBall.addedMomentum = 1.05f;  // Reset added momentum for the new ball
-    return newBall;
-}
+const char* fieldFragmentShaderSource = R"glsl(
+    #version 330 core
+    in vec2 fieldCoord;
+    out vec4 FragColor;
+    uniform sampler2D field;
+    uniform float lineWidth;
+    void main()
+    {
+        float distance = texture(field, fieldCoord).r;
+        float smoothing = fwidth(distance);
+        float line = 1.0 - smoothstep(lineWidth - smoothing, lineWidth + smoothing, abs(distance));
+        FragColor = vec4(vec3(line), 1.0);
+    }
+)glsl";
 
-void processInput(GLFWwindow* window, std::vector<Ball>& balls, float wallRadius)
-{
-    if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
-        glfwSetWindowShouldClose(window, true);
+// Obstacles drawn in one instanced call: each capsule covers its bounding
+// box with a quad and the fragment shader cuts out the capsule
+const char* obstacleVertexShaderSource = R"glsl(
+    #version 330 core
+    layout (location = 0) in vec2 aCorner;
+    layout (location = 1) in vec4 aEnds;
+    layout (location = 2) in float aRadius;
+    out vec2 position;
+    flat out vec4 ends;
+    flat out float radius;
+    void main()
+    {
+        vec2 low = min(aEnds.xy, aEnds.zw) - aRadius;
+        vec2 high = max(aEnds.xy, aEnds.zw) + aRadius;
+        position = mix(low, high, aCorner * 0.5 + 0.5);
+        ends = aEnds;
+        radius = aRadius;
+        gl_Position = vec4(position, 0.0, 1.0);
+    }
+)glsl";
 
-    static bool spacePressed = false;
-    if (glfwGetKey(window, GLFW_KEY_SPACE) == GLFW_PRESS)
+const char* obstacleFragmentShaderSource = R"glsl(
+    #version 330 core
+    in vec2 position;
+    flat in vec4 ends;
+    flat in float radius;
+    out vec4 FragColor;
+    void main()
     {
-        if (!spacePressed)
-        {
-            balls.push_back(createRandomBall(wallRadius));
-            spacePressed = true;
+        vec2 along = ends.zw - ends.xy;
+        float t = clamp(dot(position - ends.xy, along) / max(dot(along, along), 1e-12), 0.0, 1.0);
+        float distance = length(position - ends.xy - along * t) - radius;
+        float smoothing = fwidth(distance);
+        float coverage = 1.0 - smoothstep(-smoothing, smoothing, distance);
+        if (coverage <= 0.0) {
+            discard;
         }
+        FragColor = vec4(vec3(0.6 * coverage), 1.0);
     }
-    else
+)glsl";
+
+const char* ballFragmentShaderSource = R"glsl(
+    #version 330 core
+    in vec3 ballColor;
+    out vec4 FragColor;
+    void main()
     {
-        spacePressed = false;
+        FragColor = vec4(ballColor, 1.0);
     }
-}
-
-void updateBalls(std::vector<Ball>& balls, float wallRadius, float deltaTime, SoundPlayer& soundPlayer) {
-    // Adjust the delta time based on the simulation speed
-    float adjustedDeltaTime = deltaTime * SIMULATION_SPEED;
-
-    std::vector<Ball> newBalls;
-    const size_t MAX_BALLS = 1000;
-    const float MOMENTUM_INCREMENT = 0.05f;
-    const float MAX_ADDED_MOMENTUM = 5.0f;
-    const float GRAVITY = 1.8f;
-    const float CENTER_BIAS = 0.5f;  // Strength of the center-directed bounce (0 to 1)
-    const float RANDOM_FACTOR = 0.4f;  // Strength of random variation in bounce direction
-
-    // Create a random number generator
-    static std::random_device rd;
-    static std::mt19937 gen(rd());
-    std::uniform_real_distribution<float> dis(-1.0f, 1.0f);
-
-    for (size_t i = 0; i < balls.size(); ++i) {
-        Ball& ball = balls[i];
-
-        // Apply gravity
-        ball.dy -= GRAVITY * adjustedDeltaTime;
-
-        // Update ball position
-        ball.x += ball.dx * adjustedDeltaTime;
-        ball.y += ball.dy * adjustedDeltaTime;
-
-        // Ball collision with circular wall
-        float distanceFromCenter = std::sqrt(ball.x * ball.x + ball.y * ball.y);
-        if (distanceFromCenter + BALL_RADIUS > wallRadius) {
-
-            //play sound when ball touches the wall
-            soundPlayer.play();
+)glsl";
 
-            // Normalize the ball's position to the wall
-            float angle = std::atan2(ball.y, ball.x);
-            ball.x = (wallRadius - BALL_RADIUS) * std::cos(angle);
-            ball.y = (wallRadius - BALL_RADIUS) * std::sin(angle);
+unsigned int createShaderProgram(const char* vertexSource, const char* fragmentSource)
+{
+    unsigned int vertexShader = glCreateShader(GL_VERTEX_SHADER);
+    glShaderSource(vertexShader, 1, &vertexSource, NULL);
+    glCompileShader(vertexShader);
 
-            // Calculate the normal vector of the wall at the point of collision
-            float nx = ball.x / distanceFromCenter;
-            float ny = ball.y / distanceFromCenter;
+    unsigned int fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
+    glShaderSource(fragmentShader, 1, &fragmentSource, NULL);
+    glCompileShader(fragmentShader);
 
-            // Calculate the dot product of velocity and normal
-            float dotProduct = ball.dx * nx + ball.dy * ny;
+    unsigned int program = glCreateProgram();
+    glAttachShader(program, vertexShader);
+    glAttachShader(program, fragmentShader);
+    glLinkProgram(program);
 
-            // Calculate the reflection vector
-            float rx = ball.dx - 2 * dotProduct * nx;
-            float ry = ball.dy - 2 * dotProduct * ny;
+    glDeleteShader(vertexShader);
+    glDeleteShader(fragmentShader);
+    return program;
+}
 
-            // Add a component directed towards the center
-            float centerX = -ball.x / distanceFromCenter;
-            float centerY = -ball.y / distanceFromCenter;
+void framebuffer_size_callback(GLFWwindow* window, int width, int height)
+{
+    glViewport(0, 0, width, height);
+    viewport = { 0, 0, width, height };
+}
 
-            // Add random variation
-            float randX = dis(gen) * RANDOM_FACTOR;
-            float randY = dis(gen) * RANDOM_FACTOR;
 
-            // Combine reflection, center-directed, and random components
-            ball.dx = rx * (1 - CENTER_BIAS) + centerX * CENTER_BIAS + randX;
-            ball.dy = ry * (1 - CENTER_BIAS) + centerY * CENTER_BIAS + randY;
+// One line per ball: x,y,r,g,b
+void writeSnapshot(const std::string& path, uint64_t tick, const CaptureBuffer& instances)
+{
+    std::ofstream file(path);
+    if (!file) {
+        std::cerr << "Failed to open snapshot file " << path << std::endl;
+        return;
+    }
+    file << "# tick " << tick << "\nx,y,r,g,b\n";
+    for (size_t i = 0; i + INSTANCE_FLOATS <= instances.size(); i += INSTANCE_FLOATS) {
+        file << fmt::format("{},{},{},{},{}\n", instances[i], instances[i + 1], instances[i + 2], instances[i + 3], instances[i + 4]);
+    }
+}
 
-            // Normalize and apply speed
-            float speed = std::sqrt(ball.dx * ball.dx + ball.dy * ball.dy);
-            ball.dx /= speed;
-            ball.dy /= speed;
+const char* USAGE =
+    "Usage: HelloWorld [options]\n"
+    "  --pipeline-depth N       ticks in flight (default 2)\n"
+    "  --balls N                start with N random balls (default 1)\n"
+    "  --container SHAPE        polygon:N, an outline file (x y pairs, SVG M/L/Z) or a .pgm mask\n"
+    "  --sdf-size N             distance field resolution for --container (default 512)\n"
+    "  --obstacles SPEC         plinko:ROWS, or a file of \"peg X Y R\" and\n"
+    "                           \"segment X0 Y0 X1 Y1 [THICKNESS]\" lines\n"
+    "  --species LIST           ball species, e.g. classic,heavy:0.5 (NAME[:SHARE] from\n"
+    "                           classic, floaty, heavy, sterile; default classic)\n"
+    "  --rules FILE             spawn rules, one \"TRIGGER ACTION [key=value ...]\" per line\n"
+    "                           (wall-hit|timer|contact, duplicate|split|recolor|despawn)\n"
+    "  --merge                  balls that run into each other merge, conserving mass\n"
+    "  --spin RATE              rotate the container, radians per simulated second\n"
+    "  --pulse AMOUNT           grow and shrink the container by this fraction\n"
+    "  --sway DISTANCE          move the container side to side\n"
+    "  --motion-period SECONDS  period of --pulse and --sway (default 4)\n"
+    "  --burst N                balls spawned per space press (default 1)\n"
+    "  --repeat N               balls spawned per tick while space is held (default 0, off)\n"
+    "  --repeat-delay SECONDS   hold time before --repeat starts (default 0.25)\n"
+    "  --numa on|off            partition balls and workers by NUMA node (default on)\n"
+    "  --affinity on|off        pin threads to cores (default on)\n"
+    "  --smt-physics on|off     also run physics on SMT siblings (default off)\n"
+    "  --cpus-render LIST       CPUs for the render thread, e.g. 0 or 0-1\n"
+    "  --cpus-audio LIST        CPUs for the audio thread\n"
+    "  --cpus-physics LIST      one physics worker per listed CPU\n"
+    "  --cpus-background LIST   CPUs for asset decode and other background work\n"
+    "  --profile                print frame and stage timings every second\n"
+    "  --perf-counters          count cycles, instructions, cache and branch misses per phase\n"
+    "  --metrics                print metric rates and percentiles every second\n"
+    "  --memory-report          print memory use by subsystem on exit\n"
+    "  --metrics-port PORT      serve Prometheus metrics at http://127.0.0.1:PORT/metrics\n"
+    "  --control PATH           accept script commands on a Unix socket at PATH\n"
+    "  --shm NAME               publish ball state to POSIX shared memory, e.g. /brainrot\n"
+    "  --trace FILE             write a chrome://tracing file\n"
+    "Keys: space spawns, Esc quits. Mouse: left pushes (Shift pulls), right grabs,\n"
+    "middle deletes, the wheel sizes the brush";
+
+struct Options {
+    int pipelineDepth = 2;  // Ticks in flight; 1 = no overlap, lowest latency
+    size_t initialBalls = 1;
+    std::string container;  // Empty = circular wall
+    int sdfSize = 512;
+    ContainerMotion motion;
+    std::string obstacles;  // Empty = none
+    bool merge = false;
+    std::vector<Species> species{ speciesPreset("classic") };
+    std::string rules;  // Empty = the built-in duplicate-on-wall-hit rule
+    SpawnKeyConfig spawnKey;
+    bool numa = true;  // Partition ball storage and workers by NUMA node
+    AffinityConfig affinity;
+    bool profile = false;
+    bool perfCounters = false;
+    bool metrics = false;
+    bool memoryReport = false;
+    int metricsPort = 0;  // 0 = no metrics server
+    std::string tracePath;
+    std::string shmName;
+    std::string controlPath;
+};
 
-            // Increase the added momentum
-            ball.addedMomentum = std::min(ball.addedMomentum + MOMENTUM_INCREMENT, MAX_ADDED_MOMENTUM);
+bool parseOnOff(const std::string& option, const std::string& value)
+{
+    if (value != "on" && value != "off") {
+        throw std::runtime_error(fmt::format("{} expects on or off", option));
+    }
+    return value == "on";
+}
 
-            // Apply the added momentum
-            float totalMomentum = 1.05f + ball.addedMomentum;
-            ball.dx *= totalMomentum;
-            ball.dy *= totalMomentum;
+std::vector<int> parseCpus(const std::string& option, const std::string& value)
+{
+    std::vector<int> cpus = parseCpuList(value);
+    if (cpus.empty()) {
+        throw std::runtime_error(fmt::format("{} expects a CPU list such as 0-3,8", option));
+    }
+    return cpus;
+}
 
-            // Create a duplicate ball with slightly reduced momentum
-            if (balls.size() + newBalls.size() < MAX_BALLS) {
-                newBalls.push_back(createDuplicateBall(ball, 0.95f));
-            }
+Options parseOptions(int argc, char* argv[])
+{
+    Options options;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--pipeline-depth" && hasValue) {
+            options.pipelineDepth = std::max(1, std::stoi(argv[++i]));
         }
-
-        for (auto& ball : balls) {
-            float distanceFromCenter = std::sqrt(ball.x * ball.x + ball.y * ball.y);
-            float normalizedDistance = distanceFromCenter / wallRadius;
-
-            // Create a rainbow gradient from center (red) to edge (purple)
-            if (normalizedDistance < 0.33f) {
-                ball.r = 1.0f;
-                ball.g = normalizedDistance * 3.0f;
-                ball.b = 0.0f;
-            }
-            else if (normalizedDistance < 0.66f) {
-                ball.r = 1.0f - (normalizedDistance - 0.33f) * 3.0f;
-                ball.g = 1.0f;
-                ball.b = (normalizedDistance - 0.33f) * 3.0f;
-            }
-            else {
-                ball.r = (normalizedDistance - 0.66f) * 3.0f;
-                ball.g = 1.0f - (normalizedDistance - 0.66f) * 3.0f;
-                ball.b = 1.0f;
+        else if (arg == "--balls" && hasValue) {
+            options.initialBalls = std::stoull(argv[++i]);
+        }
+        else if (arg == "--container" && hasValue) {
+            options.container = argv[++i];
+        }
+        else if (arg == "--sdf-size" && hasValue) {
+            options.sdfSize = std::clamp(std::stoi(argv[++i]), 16, 4096);
+        }
+        else if (arg == "--obstacles" && hasValue) {
+            options.obstacles = argv[++i];
+        }
+        else if (arg == "--species" && hasValue) {
+            options.species = parseSpecies(argv[++i]);
+        }
+        else if (arg == "--rules" && hasValue) {
+            options.rules = argv[++i];
+        }
+        else if (arg == "--merge") {
+            options.merge = true;
+        }
+        else if (arg == "--spin" && hasValue) {
+            options.motion.spin = std::stof(argv[++i]);
+        }
+        else if (arg == "--pulse" && hasValue) {
+            options.motion.pulseAmplitude = std::clamp(std::stof(argv[++i]), 0.0f, 0.9f);
+        }
+        else if (arg == "--sway" && hasValue) {
+            options.motion.swayAmplitude = std::stof(argv[++i]);
+        }
+        else if (arg == "--motion-period" && hasValue) {
+            options.motion.period = std::max(0.01f, std::stof(argv[++i]));
+        }
+        else if (arg == "--burst" && hasValue) {
+            options.spawnKey.burst = std::max(0, std::stoi(argv[++i]));
+        }
+        else if (arg == "--repeat" && hasValue) {
+            options.spawnKey.repeatPerTick = std::max(0, std::stoi(argv[++i]));
+        }
+        else if (arg == "--repeat-delay" && hasValue) {
+            options.spawnKey.repeatDelay = std::max(0.0, std::stod(argv[++i]));
+        }
+        else if (arg == "--numa" && hasValue) {
+            options.numa = parseOnOff(arg, argv[++i]);
+        }
+        else if (arg == "--affinity" && hasValue) {
+            options.affinity.enabled = parseOnOff(arg, argv[++i]);
+        }
+        else if (arg == "--smt-physics" && hasValue) {
+            options.affinity.physicsOnSmtSiblings = parseOnOff(arg, argv[++i]);
+        }
+        else if (arg == "--cpus-render" && hasValue) {
+            options.affinity.renderCpus = parseCpus(arg, argv[++i]);
+        }
+        else if (arg == "--cpus-audio" && hasValue) {
+            options.affinity.audioCpus = parseCpus(arg, argv[++i]);
+        }
+        else if (arg == "--cpus-physics" && hasValue) {
+            options.affinity.physicsCpus = parseCpus(arg, argv[++i]);
+        }
+        else if (arg == "--cpus-background" && hasValue) {
+            options.affinity.backgroundCpus = parseCpus(arg, argv[++i]);
+        }
+        else if (arg == "--profile") {
+            options.profile = true;
+        }
+        else if (arg == "--perf-counters") {
+            options.perfCounters = true;
+        }
+        else if (arg == "--memory-report") {
+            options.memoryReport = true;
+        }
+        else if (arg == "--metrics") {
+            options.metrics = true;
+        }
+        else if (arg == "--metrics-port" && hasValue) {
+            options.metricsPort = std::stoi(argv[++i]);
+            if (options.metricsPort <= 0 || options.metricsPort > 65535) {
+                throw std::runtime_error("--metrics-port expects a port between 1 and 65535");
             }
         }
-
-        // Limit maximum speed
-        float maxSpeed = 10.0f;
-        float currentSpeed = std::sqrt(ball.dx * ball.dx + ball.dy * ball.dy);
-        if (currentSpeed > maxSpeed) {
-            ball.dx = (ball.dx / currentSpeed) * maxSpeed;
-            ball.dy = (ball.dy / currentSpeed) * maxSpeed;
+        else if (arg == "--control" && hasValue) {
+            options.controlPath = argv[++i];
+        }
+        else if (arg == "--shm" && hasValue) {
+            options.shmName = argv[++i];
+        }
+        else if (arg == "--trace" && hasValue) {
+            options.tracePath = argv[++i];
+        }
+        else {
+            throw std::runtime_error(fmt::format("Unknown or incomplete option: {}", arg));
         }
     }
-
-    // Add the new balls to the main vector
-    balls.insert(balls.end(), newBalls.begin(), newBalls.end());
+    return options;
 }
 
-int main()
+int main(int argc, char* argv[])
 {
+    Options options;
+    try {
+        options = parseOptions(argc, argv);
+    }
+    catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        std::cerr << USAGE << std::endl;
+        return -1;
+    }
+
     glfwInit();
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
@@ -352,17 +559,26 @@ int main()
 
     glViewport(0, 0, WINDOW_WIDTH, WINDOW_HEIGHT);
     glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
+    InputQueue inputQueue(window, options.spawnKey);
 
     float wallRadius = 0.9f;
-    std::vector<Ball> balls;
-    balls.push_back(createRandomBall(wallRadius));  // Start with one ball
 
-    std::vector<float> ballVertices = createCircleVertices(BALL_RADIUS, 32);
-    std::vector<float> wallVertices = createCircleVertices(wallRadius, 100);
+    NumaTopology topology = NumaTopology::detect();
+    int slabCount = options.numa ? static_cast<int>(topology.nodes.size()) : 0;
+
+    // Double-buffered state: tick N is simulated into states[N % 2] from the other buffer,
+    // so packing tick N can run while tick N+1 is being simulated
+    int speciesCount = static_cast<int>(options.species.size());
+    BallStore states[2] = { BallStore::partitioned(slabCount, speciesCount), BallStore::partitioned(slabCount, speciesCount) };
+    SpawnBuffer spawned;
+    uint32_t sessionSeed = std::random_device{}();
+
+    VertexBuffer ballVertices = createCircleVertices(1.0f, 32);
+    VertexBuffer wallVertices = createCircleVertices(wallRadius, 100);
 
-    unsigned int VBO[3], VAO[3];
-    glGenVertexArrays(3, VAO);
-    glGenBuffers(3, VBO);
+    unsigned int VBO[7], VAO[5];
+    glGenVertexArrays(5, VAO);
+    glGenBuffers(7, VBO);
 
     // Setup ball vertex data
     glBindVertexArray(VAO[0]);
@@ -371,6 +587,18 @@ int main()
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
     glEnableVertexAttribArray(0);
 
+    // Per-ball instance data: offset, color and radius
+    glBindBuffer(GL_ARRAY_BUFFER, VBO[3]);
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, INSTANCE_FLOATS * sizeof(float), (void*)0);
+    glEnableVertexAttribArray(1);
+    glVertexAttribDivisor(1, 1);
+    glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, INSTANCE_FLOATS * sizeof(float), (void*)(2 * sizeof(float)));
+    glEnableVertexAttribArray(2);
+    glVertexAttribDivisor(2, 1);
+    glVertexAttribPointer(3, 1, GL_FLOAT, GL_FALSE, INSTANCE_FLOATS * sizeof(float), (void*)(5 * sizeof(float)));
+    glEnableVertexAttribArray(3);
+    glVertexAttribDivisor(3, 1);
+
     // Setup wall vertex data
     glBindVertexArray(VAO[1]);
     glBindBuffer(GL_ARRAY_BUFFER, VBO[1]);
@@ -386,29 +614,269 @@ int main()
     glEnableVertexAttribArray(0);
 
     // Compile and link shaders
-    unsigned int vertexShader = glCreateShader(GL_VERTEX_SHADER);
-    glShaderSource(vertexShader, 1, &vertexShaderSource, NULL);
-    glCompileShader(vertexShader);
-
-    unsigned int fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
-    glShaderSource(fragmentShader, 1, &fragmentShaderSource, NULL);
-    glCompileShader(fragmentShader);
-
-    unsigned int shaderProgram = glCreateProgram();
-    glAttachShader(shaderProgram, vertexShader);
-    glAttachShader(shaderProgram, fragmentShader);
-    glLinkProgram(shaderProgram);
-
-    glDeleteShader(vertexShader);
-    glDeleteShader(fragmentShader);
+    unsigned int shaderProgram = createShaderProgram(vertexShaderSource, fragmentShaderSource);
+    unsigned int ballShaderProgram = createShaderProgram(ballVertexShaderSource, ballFragmentShaderSource);
 
     // Get uniform locations
     int offsetLoc = glGetUniformLocation(shaderProgram, "offset");
     int colorLoc = glGetUniformLocation(shaderProgram, "color");
+    int transformLoc = glGetUniformLocation(shaderProgram, "transform");
 
     float lastFrame = 0.0f;
 
-    SoundPlayer soundPlayer("ballsound.wav");
+    Profiler profiler(options.profile);
+    if (!options.tracePath.empty()) {
+        profiler.openTrace(options.tracePath);
+    }
+    if (options.perfCounters) {
+        perf::enable();
+    }
+    metrics::Aggregator metricsAggregator(std::chrono::seconds(1), options.metrics);
+    auto lastPresent = Profiler::Clock::now();
+    std::unique_ptr<MetricsServer> metricsServer;
+    if (options.metricsPort > 0) {
+        try {
+            metricsServer = std::make_unique<MetricsServer>(metricsAggregator, static_cast<uint16_t>(options.metricsPort));
+        }
+        catch (const std::exception& e) {
+            std::cerr << e.what() << std::endl;
+        }
+    }
+    voiceCapacityMetric.set(SoundPlayer::VOICE_COUNT);
+
+    // External viewers read the packed instances of every tick from here
+    std::unique_ptr<shared_state::Publisher> statePublisher;
+    std::atomic<bool> shmTruncated = false;  // Reported once
+    if (!options.shmName.empty()) {
+        try {
+            // Room for the starting balls and a tick's worth of spawns on top
+            size_t capacity = std::max(MAX_BALLS, options.initialBalls) + MAX_SPAWN_BALLS;
+            if (capacity > shared_state::MAX_CAPACITY) {
+                throw std::runtime_error(fmt::format("Too many balls to publish to shared memory: {}", capacity));
+            }
+            statePublisher = std::make_unique<shared_state::Publisher>(options.shmName,
+                static_cast<uint32_t>(capacity));
+        }
+        catch (const std::exception& e) {
+            std::cerr << e.what() << std::endl;
+        }
+    }
+
+    // Keep the render thread off the physics cores and audio on its own core
+    AffinityPlan affinity = planAffinity(CpuTopology::detect(), options.affinity, options.numa ? &topology : nullptr);
+    if (options.profile) {
+        fmt::print("{}\n", affinity.describe());
+    }
+    if (!affinity.render.empty()) {
+        pinCurrentThread(affinity.render);
+    }
+
+    std::unique_ptr<SoundPlayer> soundPlayer;
+    ThreadPool pool(affinity.physics);
+    ThreadPool audioPool({ WorkerPlacement{ -1, affinity.audio } });
+    ThreadPool backgroundPool({ WorkerPlacement{ -1, affinity.background } });
+    BallStepper stepper(pool, profiler, topology);
+    stepper.setSpecies(options.species);
+    if (!options.rules.empty()) {
+        try {
+            stepper.setRules(compileRules(loadRules(options.rules), stepper.getSpecies()));
+        }
+        catch (const std::exception& e) {
+            std::cerr << e.what() << std::endl;
+        }
+    }
+
+    // Non-circular containers: the wall is a distance field, generated on the pool
+    // and used both for collisions and, as a texture, for drawing the wall
+    DistanceField containerField;
+    unsigned int fieldTexture = 0;
+    unsigned int fieldShaderProgram = 0;
+    int fieldOffsetLoc = -1;
+    int fieldTransformLoc = -1;
+    if (!options.container.empty()) {
+        try {
+            const std::string polygonPrefix = "polygon:";
+            ContainerShape shape = options.container.rfind(polygonPrefix, 0) == 0
+                ? ContainerShape::regularPolygon(std::max(3, std::stoi(options.container.substr(polygonPrefix.size()))), wallRadius)
+                : ContainerShape::load(options.container, wallRadius);
+
+            auto begin = Profiler::Clock::now();
+            containerField = DistanceField(options.sdfSize, wallRadius * 1.05f);
+            auto built = std::make_shared<Event>(pool);
+            launch(buildDistanceField(pool, shape, containerField), built);
+            built->wait();
+            if (options.profile) {
+                fmt::print("Built {0}x{0} container distance field in {1:.1f} ms\n", options.sdfSize,
+                    std::chrono::duration<double, std::milli>(Profiler::Clock::now() - begin).count());
+            }
+        }
+        catch (const std::exception& e) {
+            std::cerr << e.what() << std::endl;
+            containerField = DistanceField();
+        }
+    }
+    if (containerField.getSize() > 0) {
+        glGenTextures(1, &fieldTexture);
+        glBindTexture(GL_TEXTURE_2D, fieldTexture);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, containerField.getSize(), containerField.getSize(), 0,
+            GL_RED, GL_FLOAT, containerField.data());
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+        const float quad[] = { -1.0f, -1.0f, 1.0f, -1.0f, 1.0f, 1.0f, -1.0f, 1.0f };
+        glBindVertexArray(VAO[3]);
+        glBindBuffer(GL_ARRAY_BUFFER, VBO[4]);
+        glBufferData(GL_ARRAY_BUFFER, sizeof(quad), quad, GL_STATIC_DRAW);
+        glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*)0);
+        glEnableVertexAttribArray(0);
+
+        fieldShaderProgram = createShaderProgram(fieldVertexShaderSource, fieldFragmentShaderSource);
+        glUseProgram(fieldShaderProgram);
+        glUniform1f(glGetUniformLocation(fieldShaderProgram, "extent"), containerField.getExtent());
+        glUniform1f(glGetUniformLocation(fieldShaderProgram, "lineWidth"), 0.004f);
+        glUniform1i(glGetUniformLocation(fieldShaderProgram, "field"), 0);
+        fieldOffsetLoc = glGetUniformLocation(fieldShaderProgram, "offset");
+        fieldTransformLoc = glGetUniformLocation(fieldShaderProgram, "transform");
+    }
+
+    // Static obstacles: baked into their grid once and uploaded once
+    ObstacleField obstacleField;
+    unsigned int obstacleShaderProgram = 0;
+    if (!options.obstacles.empty()) {
+        try {
+            const std::string plinkoPrefix = "plinko:";
+            auto begin = Profiler::Clock::now();
+            obstacleField = ObstacleField(options.obstacles.rfind(plinkoPrefix, 0) == 0
+                ? ObstacleField::pegBoard(std::stoi(options.obstacles.substr(plinkoPrefix.size())), wallRadius)
+                : ObstacleField::load(options.obstacles));
+            if (options.profile) {
+                fmt::print("Baked {} obstacles into {} cell entries in {:.1f} ms\n", obstacleField.getObstacles().size(),
+                    obstacleField.bakedEntries(),
+                    std::chrono::duration<double, std::milli>(Profiler::Clock::now() - begin).count());
+            }
+        }
+        catch (const std::exception& e) {
+            std::cerr << e.what() << std::endl;
+            obstacleField = ObstacleField();
+        }
+    }
+    if (!obstacleField.empty()) {
+        const auto& obstacles = obstacleField.getObstacles();
+        const float corners[] = { -1.0f, -1.0f, 1.0f, -1.0f, 1.0f, 1.0f, -1.0f, 1.0f };
+        glBindVertexArray(VAO[4]);
+        glBindBuffer(GL_ARRAY_BUFFER, VBO[5]);
+        glBufferData(GL_ARRAY_BUFFER, sizeof(corners), corners, GL_STATIC_DRAW);
+        glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*)0);
+        glEnableVertexAttribArray(0);
+
+        glBindBuffer(GL_ARRAY_BUFFER, VBO[6]);
+        glBufferData(GL_ARRAY_BUFFER, obstacles.size() * sizeof(Obstacle), obstacles.data(), GL_STATIC_DRAW);
+        glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(Obstacle), (void*)0);
+        glEnableVertexAttribArray(1);
+        glVertexAttribDivisor(1, 1);
+        glVertexAttribPointer(2, 1, GL_FLOAT, GL_FALSE, sizeof(Obstacle), (void*)(4 * sizeof(float)));
+        glEnableVertexAttribArray(2);
+        glVertexAttribDivisor(2, 1);
+
+        obstacleShaderProgram = createShaderProgram(obstacleVertexShaderSource, obstacleFragmentShaderSource);
+    }
+
+    auto soundLoaded = std::make_shared<Event>(backgroundPool);
+    launch(loadSound(backgroundPool, "ballsound.wav", soundPlayer), soundLoaded);
+
+    FrameStages stages;
+    stages.spawn = [&](const FrameInput& input) {
+        perf::Scope scope(perf::Phase::Spawn);
+        size_t randomCount = static_cast<size_t>(std::max(0, input.spawnCount));
+        size_t positionedCount = 0;
+        for (const auto& request : input.spawns) {
+            (request.positioned ? positionedCount : randomCount) += static_cast<size_t>(std::max(0, request.count));
+        }
+
+        // Positioned balls first, then the random ones generated in bulk on the pool;
+        // whatever is past MAX_SPAWN_BALLS in one tick is dropped
+        spawned.clear();
+        spawned.reserve(std::min(positionedCount + randomCount, MAX_SPAWN_BALLS));
+        for (const auto& request : input.spawns) {
+            for (int i = 0; request.positioned && i < request.count && spawned.size() < MAX_SPAWN_BALLS; ++i) {
+                spawned.push_back(createBallAt(request.x, request.y, wallRadius, input.params));
+            }
+        }
+        positionedCount = spawned.size();
+        randomCount = std::min(randomCount, MAX_SPAWN_BALLS - positionedCount);
+        spawned.resize(positionedCount + randomCount);
+        return stepper.spawnRandom(spawned.data() + positionedCount, randomCount, wallRadius,
+            tickSeed(sessionSeed ^ SPAWN_SEED, input.tick), input.params);
+    };
+    stages.physics = [&](const FrameInput& input) {
+        return stepper.step(states[(input.tick + 1) % 2], states[input.tick % 2], spawned,
+            wallRadius, input.deltaTime, tickSeed(sessionSeed, input.tick), input.params, input.brushes);
+    };
+    stages.pack = [&](uint64_t tick, InstanceBuffer& instances) {
+        size_t count;
+        {
+            perf::Scope scope(perf::Phase::Pack);
+            count = packInstances(states[tick % 2], instances);
+        }
+        if (statePublisher) {
+            statePublisher->publish(tick, instances.data(), count, wallRadius, INSTANCE_FLOATS);
+            if (count > statePublisher->capacity() && !shmTruncated.exchange(true)) {
+                std::cerr << fmt::format("Shared memory only holds {} of {} balls; the rest are not published",
+                    statePublisher->capacity(), count) << std::endl;
+            }
+        }
+        return count;
+    };
+    stages.audio = [&](size_t wallHits) {
+        //play sound when a ball touched the wall during this tick
+        if (wallHits > 0 && soundLoaded->isSet() && soundPlayer) {
+            soundPlayer->play();
+        }
+        if (soundLoaded->isSet() && soundPlayer) {
+            activeVoicesMetric.set(soundPlayer->activeVoices());
+        }
+    };
+    auto pipeline = std::make_unique<FramePipeline>(pool, audioPool, profiler, options.pipelineDepth, std::move(stages));
+
+    std::unique_ptr<ControlServer> controlServer;
+    if (!options.controlPath.empty()) {
+        try {
+            controlServer = std::make_unique<ControlServer>(options.controlPath);
+        }
+        catch (const std::exception& e) {
+            std::cerr << e.what() << std::endl;
+        }
+    }
+    SimParams simParams;
+    if (containerField.getSize() > 0) {
+        simParams.container = &containerField;
+    }
+    if (!obstacleField.empty()) {
+        simParams.obstacles = &obstacleField;
+    }
+    simParams.coalesce = options.merge;
+    double containerTime = 0.0;  // Simulated time that drives options.motion
+    // The starting balls are generated in parallel, each slab on its own node,
+    // inside the container as it stands before the first tick
+    {
+        auto begin = Profiler::Clock::now();
+        auto populated = std::make_shared<Event>(pool);
+        SimParams spawnParams = simParams;
+        spawnParams.transform = options.motion.at(containerTime);
+        launch(stepper.populate(states[0], options.initialBalls, wallRadius, sessionSeed ^ SPAWN_SEED, spawnParams),
+            populated);
+        populated->wait();
+        if (options.profile) {
+            fmt::print("Spawned {} balls in {:.1f} ms\n", options.initialBalls,
+                std::chrono::duration<double, std::milli>(Profiler::Clock::now() - begin).count());
+        }
+    }
+    std::vector<SpawnRequest> pendingSpawns;
+    bool paused = false;
+    int pendingSteps = 0;
+    std::string snapshotPath;
 
     // render loop
     while (!glfwWindowShouldClose(window))
@@ -416,42 +884,172 @@ int main()
         float currentFrame = static_cast<float>(glfwGetTime());
         float deltaTime = currentFrame - lastFrame;
         lastFrame = currentFrame;
+        inputQueue.drain();
+
+        // Script commands take effect from the next tick on
+        ControlCommand command;
+        while (controlServer && controlServer->poll(command)) {
+            switch (command.type) {
+            case CommandType::Spawn:
+                pendingSpawns.push_back({ command.count, command.positioned, command.x, command.y });
+                break;
+            case CommandType::Gravity:
+                simParams.gravity = command.value;
+                break;
+            case CommandType::CenterBias:
+                simParams.centerBias = command.value;
+                break;
+            case CommandType::Pause:
+                paused = true;
+                break;
+            case CommandType::Resume:
+                paused = false;
+                pendingSteps = 0;
+                break;
+            case CommandType::Step:
+                pendingSteps += command.count;
+                break;
+            case CommandType::Snapshot:
+                snapshotPath = command.path;
+                break;
+            }
+        }
 
-        processInput(window, balls, wallRadius);
+        // Start the next tick; its result is shown `depth - 1` frames from now
+        if (!paused || pendingSteps > 0) {
+            FrameInput input;
+            input.deltaTime = paused ? STEP_DELTA_TIME : deltaTime;
+            input.spawnCount = inputQueue.takeSpawns(currentFrame);
+            Brush brush;
+            if (inputQueue.takeBrush(viewport, brush)) {
+                input.brushes.push_back(brush);
+            }
+            input.spawns = std::move(pendingSpawns);
+            input.params = simParams;
+            // The transform is the pose at the end of the tick
+            containerTime += static_cast<double>(input.deltaTime) * SIMULATION_SPEED;
+            input.params.transform = options.motion.at(containerTime);
+            pendingSpawns.clear();
+            pipeline->push(std::move(input));
+            if (paused) {
+                pendingSteps--;
+            }
+        }
+        // While paused nothing new comes in, so present what is in flight down to the newest tick
+        bool draining = paused && !pipeline->empty();
+        if (!pipeline->ready() && !draining) {
+            if (paused) {
+                glfwWaitEventsTimeout(0.01);
+            }
+            else {
+                glfwPollEvents();
+            }
+            continue;
+        }
+        FrameSlot* presentedFrame = nullptr;
+        try {
+            presentedFrame = &pipeline->front();
+        }
+        catch (const std::exception& e) {
+            // The state of a failed tick is unusable, and every later tick builds on it
+            std::cerr << "Simulation stopped: " << e.what() << std::endl;
+            break;
+        }
+        FrameSlot& frame = *presentedFrame;
+        auto submitBegin = Profiler::Clock::now();
 
         glClearColor(0.0f, 0.0f, 0.0f, 1.0f);  // Black background
         glClear(GL_COLOR_BUFFER_BIT);
 
-        glUseProgram(shaderProgram);
-
-        // Draw black background (filled circle)
-        glUniform2f(offsetLoc, 0.0f, 0.0f);
-        glUniform3f(colorLoc, 0.0f, 0.0f, 0.0f);  // Black color
-        glBindVertexArray(VAO[2]);
-        glDrawArrays(GL_TRIANGLE_FAN, 0, static_cast<GLsizei>(wallVertices.size()) / 3);
+        // The wall moves through uniforms; its vertices and field texture never change
+        const ContainerTransform& pose = frame.container;
+        const float wallTransform[] = {
+            pose.scale * pose.cosAngle, pose.scale * pose.sinAngle,
+            -pose.scale * pose.sinAngle, pose.scale * pose.cosAngle
+        };
+        int wallDraws = 1;
+        if (fieldTexture) {
+            // Draw the container outline from its distance field
+            glUseProgram(fieldShaderProgram);
+            glUniform2f(fieldOffsetLoc, pose.x, pose.y);
+            glUniformMatrix2fv(fieldTransformLoc, 1, GL_FALSE, wallTransform);
+            glActiveTexture(GL_TEXTURE0);
+            glBindTexture(GL_TEXTURE_2D, fieldTexture);
+            glBindVertexArray(VAO[3]);
+            glDrawArrays(GL_TRIANGLE_FAN, 0, 4);
+        }
+        else {
+            glUseProgram(shaderProgram);
+            glUniformMatrix2fv(transformLoc, 1, GL_FALSE, wallTransform);
+
+            // Draw black background (filled circle)
+            glUniform2f(offsetLoc, pose.x, pose.y);
+            glUniform3f(colorLoc, 0.0f, 0.0f, 0.0f);  // Black color
+            glBindVertexArray(VAO[2]);
+            glDrawArrays(GL_TRIANGLE_FAN, 0, static_cast<GLsizei>(wallVertices.size()) / 3);
+
+            // Draw wall (white outline)
+            glUniform2f(offsetLoc, pose.x, pose.y);
+            glUniform3f(colorLoc, 1.0f, 1.0f, 1.0f);  // White color for wall outline
+            glBindVertexArray(VAO[1]);
+            glDrawArrays(GL_LINE_LOOP, 0, static_cast<GLsizei>(wallVertices.size()) / 3);
+            wallDraws = 2;
+        }
 
-        // Draw wall (white outline)
-        glUniform2f(offsetLoc, 0.0f, 0.0f);
-        glUniform3f(colorLoc, 1.0f, 1.0f, 1.0f);  // White color for wall outline
-        glBindVertexArray(VAO[1]);
-        glDrawArrays(GL_LINE_LOOP, 0, static_cast<GLsizei>(wallVertices.size()) / 3);
+        if (obstacleShaderProgram) {
+            glUseProgram(obstacleShaderProgram);
+            glBindVertexArray(VAO[4]);
+            glDrawArraysInstanced(GL_TRIANGLE_FAN, 0, 4, static_cast<GLsizei>(obstacleField.getObstacles().size()));
+            wallDraws++;
+        }
 
-        // Update and draw balls
-        updateBalls(balls, wallRadius, deltaTime, soundPlayer);
-        for (const auto& ball : balls) {
-            glUniform2f(offsetLoc, ball.x, ball.y);
-            glUniform3f(colorLoc, ball.r, ball.g, ball.b);
-            glBindVertexArray(VAO[0]);
-            glDrawArrays(GL_TRIANGLE_FAN, 0, static_cast<GLsizei>(ballVertices.size()) / 3);
+        // Upload and draw all balls of the presented tick
+        glUseProgram(ballShaderProgram);
+        glBindBuffer(GL_ARRAY_BUFFER, VBO[3]);
+        glBufferData(GL_ARRAY_BUFFER, frame.instances.size() * sizeof(float), frame.instances.data(), GL_STREAM_DRAW);
+        glBindVertexArray(VAO[0]);
+        glDrawArraysInstanced(GL_TRIANGLE_FAN, 0, static_cast<GLsizei>(ballVertices.size()) / 3,
+            static_cast<GLsizei>(frame.instanceCount));
+        drawCallsMetric.add(wallDraws + 1);
+
+        profiler.record(Stage::Submit, frame.tick, submitBegin, Profiler::Clock::now());
+        if (!snapshotPath.empty()) {
+            backgroundPool.enqueue([path = std::move(snapshotPath), tick = frame.tick,
+                instances = CaptureBuffer(frame.instances.begin(), frame.instances.end())] {
+                writeSnapshot(path, tick, instances);
+            });
+            snapshotPath.clear();
         }
+        pipeline->pop();
 
         glfwSwapBuffers(window);
         glfwPollEvents();
+        auto present = Profiler::Clock::now();
+        frameTimeMetric.record(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(present - lastPresent).count()));
+        lastPresent = present;
+        profiler.endFrame(present);
+        memory::endFrame();
     }
 
-    glDeleteVertexArrays(3, VAO);
-    glDeleteBuffers(3, VBO);
+    // Finish in-flight ticks and the sound load before their state goes away
+    pipeline.reset();
+    soundLoaded->wait();
+
+    glDeleteVertexArrays(5, VAO);
+    glDeleteBuffers(7, VBO);
+    if (fieldTexture) {
+        glDeleteTextures(1, &fieldTexture);
+        glDeleteProgram(fieldShaderProgram);
+    }
+    if (obstacleShaderProgram) {
+        glDeleteProgram(obstacleShaderProgram);
+    }
     glDeleteProgram(shaderProgram);
+    glDeleteProgram(ballShaderProgram);
+
+    if (options.memoryReport) {
+        fmt::print("{}", memory::report());
+    }
 
     glfwTerminate();
     return 0;
@@ -0,0 +1,121 @@
+#include "memory_tracking.h"
+
+#include <algorithm>
+#include <string>
+#include <fmt/core.h>
+
+#include "metrics.h"
+
+namespace memory {
+
+namespace {
+
+struct alignas(64) TagCounters {
+    std::atomic<uint64_t> bytes{ 0 };
+    std::atomic<uint64_t> peakBytes{ 0 };
+    std::atomic<uint64_t> allocations{ 0 };
+    // Render thread only
+    uint64_t frameStartAllocations = 0;
+    uint64_t lastFrameAllocations = 0;
+    uint64_t maxFrameAllocations = 0;
+};
+
+TagCounters tagCounters[TAG_COUNT];
+
+struct TagMetrics {
+    metrics::Gauge* bytes;
+    metrics::Gauge* peakBytes;
+    metrics::Gauge* frameAllocations;
+    metrics::Counter* allocations;
+};
+
+// Registered on first use from the render thread, not from inside an allocation
+TagMetrics* tagMetrics() {
+    static TagMetrics* instance = [] {
+        static TagMetrics all[TAG_COUNT];
+        for (int i = 0; i < TAG_COUNT; ++i) {
+            const char* name = tagName(static_cast<Tag>(i));
+            auto& registry = metrics::registry();
+            all[i].bytes = &registry.gauge(fmt::format("brainrot_memory_{}_bytes", name),
+                fmt::format("Live bytes allocated for {}", name));
+            all[i].peakBytes = &registry.gauge(fmt::format("brainrot_memory_{}_peak_bytes", name),
+                fmt::format("High-water mark of bytes allocated for {}", name));
+            all[i].frameAllocations = &registry.gauge(fmt::format("brainrot_memory_{}_frame_allocations", name),
+                fmt::format("Allocations for {} during the last frame", name));
+            all[i].allocations = &registry.counter(fmt::format("brainrot_memory_{}_allocations_total", name),
+                fmt::format("Allocations for {}", name));
+        }
+        return all;
+    }();
+    return instance;
+}
+
+}
+
+const char* tagName(Tag tag) {
+    switch (tag) {
+    case Tag::Balls: return "balls";
+    case Tag::Spawn: return "spawn";
+    case Tag::Vertices: return "vertices";
+    case Tag::Audio: return "audio";
+    case Tag::Capture: return "capture";
+    default: return "unknown";
+    }
+}
+
+void recordAllocation(Tag tag, size_t bytes) {
+    TagCounters& counters = tagCounters[static_cast<int>(tag)];
+    counters.allocations.fetch_add(1, std::memory_order_relaxed);
+    uint64_t live = counters.bytes.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+    uint64_t peak = counters.peakBytes.load(std::memory_order_relaxed);
+    while (live > peak && !counters.peakBytes.compare_exchange_weak(peak, live, std::memory_order_relaxed)) {
+    }
+}
+
+void recordFree(Tag tag, size_t bytes) {
+    tagCounters[static_cast<int>(tag)].bytes.fetch_sub(bytes, std::memory_order_relaxed);
+}
+
+TagStats stats(Tag tag) {
+    const TagCounters& counters = tagCounters[static_cast<int>(tag)];
+    TagStats result;
+    result.bytes = counters.bytes.load(std::memory_order_relaxed);
+    result.peakBytes = counters.peakBytes.load(std::memory_order_relaxed);
+    result.allocations = counters.allocations.load(std::memory_order_relaxed);
+    result.lastFrameAllocations = counters.lastFrameAllocations;
+    result.maxFrameAllocations = counters.maxFrameAllocations;
+    return result;
+}
+
+void endFrame() {
+    // Startup allocations would otherwise all land in the first frame
+    static bool firstFrame = true;
+    TagMetrics* all = tagMetrics();
+    for (int i = 0; i < TAG_COUNT; ++i) {
+        TagCounters& counters = tagCounters[i];
+        uint64_t allocations = counters.allocations.load(std::memory_order_relaxed);
+        counters.lastFrameAllocations = firstFrame ? 0 : allocations - counters.frameStartAllocations;
+        counters.maxFrameAllocations = std::max(counters.maxFrameAllocations, counters.lastFrameAllocations);
+        counters.frameStartAllocations = allocations;
+
+        all[i].bytes->set(static_cast<double>(counters.bytes.load(std::memory_order_relaxed)));
+        all[i].peakBytes->set(static_cast<double>(counters.peakBytes.load(std::memory_order_relaxed)));
+        all[i].frameAllocations->set(static_cast<double>(counters.lastFrameAllocations));
+        all[i].allocations->add(firstFrame ? allocations : counters.lastFrameAllocations);
+    }
+    firstFrame = false;
+}
+
+std::string report() {
+    std::string text = fmt::format("{:<10} {:>12} {:>12} {:>12} {:>14}\n",
+        "memory", "live KiB", "peak KiB", "allocations", "max per frame");
+    for (int i = 0; i < TAG_COUNT; ++i) {
+        TagStats tag = stats(static_cast<Tag>(i));
+        text += fmt::format("{:<10} {:>12.1f} {:>12.1f} {:>12} {:>14}\n",
+            tagName(static_cast<Tag>(i)), tag.bytes / 1024.0, tag.peakBytes / 1024.0,
+            tag.allocations, tag.maxFrameAllocations);
+    }
+    return text;
+}
+
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Byte and allocation accounting by subsystem. Containers opt in by using
+// TaggedAllocator, which forwards to std::allocator and records every
+// allocation against its tag with relaxed atomics.
+namespace memory {
+
+enum class Tag {
+    Balls,     // Ball storage in the BallStore slabs
+    Spawn,     // New and duplicate balls waiting to join a slab
+    Vertices,  // Circle meshes and per-frame instance data
+    Audio,     // Decoded PCM
+    Capture,   // Snapshots and other copies taken for export
+    Count
+};
+
+const int TAG_COUNT = static_cast<int>(Tag::Count);
+
+const char* tagName(Tag tag);
+
+void recordAllocation(Tag tag, size_t bytes);
+void recordFree(Tag tag, size_t bytes);
+
+struct TagStats {
+    uint64_t bytes = 0;         // Live bytes
+    uint64_t peakBytes = 0;     // High-water mark of live bytes
+    uint64_t allocations = 0;   // Allocations since start
+    uint64_t lastFrameAllocations = 0;
+    uint64_t maxFrameAllocations = 0;
+};
+
+TagStats stats(Tag tag);
+
+// Called by the render thread once per presented frame: closes the per-frame
+// allocation counts and publishes every tag to the metrics registry.
+void endFrame();
+
+// Table of all tags, e.g. for printing on exit
+std::string report();
+
+template <typename T, Tag TAG>
+struct TaggedAllocator {
+    using value_type = T;
+
+    template <typename U>
+    struct rebind {
+        using other = TaggedAllocator<U, TAG>;
+    };
+
+    TaggedAllocator() noexcept = default;
+    template <typename U>
+    TaggedAllocator(const TaggedAllocator<U, TAG>&) noexcept {}
+
+    T* allocate(size_t count) {
+        T* pointer = std::allocator<T>().allocate(count);
+        recordAllocation(TAG, count * sizeof(T));
+        return pointer;
+    }
+
+    void deallocate(T* pointer, size_t count) noexcept {
+        recordFree(TAG, count * sizeof(T));
+        std::allocator<T>().deallocate(pointer, count);
+    }
+
+    template <typename U>
+    bool operator==(const TaggedAllocator<U, TAG>&) const noexcept { return true; }
+};
+
+template <typename T, Tag TAG>
+using TaggedVector = std::vector<T, TaggedAllocator<T, TAG>>;
+
+}
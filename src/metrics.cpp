@@ -0,0 +1,241 @@
+#include "metrics.h"
+
+#include <algorithm>
+#include <bit>
+#include <map>
+#include <stdexcept>
+#include <fmt/core.h>
+
+namespace metrics {
+
+size_t shardIndex() {
+    static std::atomic<size_t> nextShard{ 0 };
+    thread_local size_t index = nextShard.fetch_add(1, std::memory_order_relaxed) % SHARD_COUNT;
+    return index;
+}
+
+uint64_t Counter::value() const {
+    uint64_t total = 0;
+    for (const auto& shard : shards) {
+        total += shard.value.load(std::memory_order_relaxed);
+    }
+    return total;
+}
+
+int Histogram::bucketIndex(uint64_t value) {
+    if (value < SUB_BUCKETS) {
+        return static_cast<int>(value);
+    }
+    int exponent = std::bit_width(value) - 1;
+    int subBucket = static_cast<int>((value >> (exponent - SUB_BUCKET_BITS)) & (SUB_BUCKETS - 1));
+    return (exponent - SUB_BUCKET_BITS + 1) * SUB_BUCKETS + subBucket;
+}
+
+uint64_t Histogram::bucketUpperBound(int index) {
+    if (index < SUB_BUCKETS) {
+        return static_cast<uint64_t>(index);
+    }
+    int exponent = index / SUB_BUCKETS + SUB_BUCKET_BITS - 1;
+    uint64_t subBucket = static_cast<uint64_t>(index % SUB_BUCKETS);
+    int shift = exponent - SUB_BUCKET_BITS;
+    uint64_t lower = (SUB_BUCKETS + subBucket) << shift;
+    return lower + ((uint64_t(1) << shift) - 1);
+}
+
+double MetricValue::quantile(double q) const {
+    if (count == 0 || buckets.empty()) {
+        return 0.0;
+    }
+    double target = q * static_cast<double>(count);
+    uint64_t seen = 0;
+    for (const auto& bucket : buckets) {
+        seen += bucket.count;
+        if (static_cast<double>(seen) >= target) {
+            return bucket.upperBound;
+        }
+    }
+    return buckets.back().upperBound;
+}
+
+const MetricValue* Snapshot::find(const std::string& name) const {
+    for (const auto& value : values) {
+        if (value.name == name) {
+            return &value;
+        }
+    }
+    return nullptr;
+}
+
+Registry::Entry* Registry::find(const std::string& name, Type type) {
+    for (auto& entry : entries) {
+        if (entry.name == name) {
+            if (entry.type != type) {
+                throw std::runtime_error(fmt::format("Metric {} registered with two types", name));
+            }
+            return &entry;
+        }
+    }
+    return nullptr;
+}
+
+Counter& Registry::counter(const std::string& name, const std::string& help) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (Entry* entry = find(name, Type::Counter)) {
+        return *entry->counter;
+    }
+    entries.push_back({ name, help, Type::Counter, std::make_unique<Counter>(), nullptr, nullptr });
+    return *entries.back().counter;
+}
+
+Gauge& Registry::gauge(const std::string& name, const std::string& help) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (Entry* entry = find(name, Type::Gauge)) {
+        return *entry->gauge;
+    }
+    entries.push_back({ name, help, Type::Gauge, nullptr, std::make_unique<Gauge>(), nullptr });
+    return *entries.back().gauge;
+}
+
+Histogram& Registry::histogram(const std::string& name, const std::string& help, double unit) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (Entry* entry = find(name, Type::Histogram)) {
+        return *entry->histogram;
+    }
+    entries.push_back({ name, help, Type::Histogram, nullptr, nullptr, std::make_unique<Histogram>(unit) });
+    return *entries.back().histogram;
+}
+
+Snapshot Registry::snapshot() const {
+    Snapshot snapshot;
+    snapshot.time = std::chrono::system_clock::now();
+
+    std::lock_guard<std::mutex> lock(mutex);
+    for (const auto& entry : entries) {
+        MetricValue value;
+        value.name = entry.name;
+        value.help = entry.help;
+        value.type = entry.type;
+        switch (entry.type) {
+        case Type::Counter:
+            value.value = static_cast<double>(entry.counter->value());
+            break;
+        case Type::Gauge:
+            value.value = entry.gauge->value();
+            break;
+        case Type::Histogram: {
+            // The count is summed from the buckets so it matches them while other threads record
+            const Histogram& histogram = *entry.histogram;
+            for (int i = 0; i < Histogram::BUCKET_COUNT; ++i) {
+                uint64_t bucketCount = histogram.buckets[i].load(std::memory_order_relaxed);
+                if (bucketCount > 0) {
+                    value.buckets.push_back({ static_cast<double>(Histogram::bucketUpperBound(i)) * histogram.unit, bucketCount });
+                    value.count += bucketCount;
+                }
+            }
+            value.value = static_cast<double>(histogram.sum.load(std::memory_order_relaxed)) * histogram.unit;
+            break;
+        }
+        }
+        snapshot.values.push_back(std::move(value));
+    }
+    return snapshot;
+}
+
+Registry& registry() {
+    static Registry instance;
+    return instance;
+}
+
+std::string formatPrometheus(const Snapshot& snapshot) {
+    std::string text;
+    for (const auto& value : snapshot.values) {
+        switch (value.type) {
+        case Type::Counter:
+            text += fmt::format("# HELP {0} {1}\n# TYPE {0} counter\n{0} {2}\n", value.name, value.help, value.value);
+            break;
+        case Type::Gauge:
+            text += fmt::format("# HELP {0} {1}\n# TYPE {0} gauge\n{0} {2}\n", value.name, value.help, value.value);
+            break;
+        case Type::Histogram: {
+            text += fmt::format("# HELP {0} {1}\n# TYPE {0} histogram\n", value.name, value.help);
+            uint64_t cumulative = 0;
+            for (const auto& bucket : value.buckets) {
+                cumulative += bucket.count;
+                text += fmt::format("{}_bucket{{le=\"{}\"}} {}\n", value.name, bucket.upperBound, cumulative);
+            }
+            text += fmt::format("{0}_bucket{{le=\"+Inf\"}} {1}\n{0}_sum {2}\n{0}_count {1}\n", value.name, value.count, value.value);
+            break;
+        }
+        }
+    }
+    return text;
+}
+
+Aggregator::Aggregator(std::chrono::milliseconds interval, bool log)
+    : interval(interval), log(log), published(std::make_shared<const Snapshot>(registry().snapshot())) {
+    thread = std::thread([this] { run(); });
+}
+
+Aggregator::~Aggregator() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    stopCondition.notify_all();
+    thread.join();
+}
+
+void Aggregator::run() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (!stopCondition.wait_for(lock, interval, [this] { return stopping; })) {
+        auto current = std::make_shared<const Snapshot>(registry().snapshot());
+        auto previous = published.exchange(current, std::memory_order_acq_rel);
+        if (log) {
+            logRates(*previous, *current);
+        }
+    }
+}
+
+void Aggregator::logRates(const Snapshot& previous, const Snapshot& current) const {
+    double seconds = std::chrono::duration<double>(current.time - previous.time).count();
+    if (seconds <= 0.0) {
+        return;
+    }
+
+    std::string line = "metrics:";
+    for (const auto& value : current.values) {
+        const MetricValue* before = previous.find(value.name);
+        switch (value.type) {
+        case Type::Counter:
+            line += fmt::format(" {} {:.1f}/s", value.name, (value.value - (before ? before->value : 0.0)) / seconds);
+            break;
+        case Type::Gauge:
+            line += fmt::format(" {} {:g}", value.name, value.value);
+            break;
+        case Type::Histogram: {
+            // Quantiles of this interval only: subtract the previous bucket counts
+            std::map<double, uint64_t> earlier;
+            if (before) {
+                for (const auto& bucket : before->buckets) {
+                    earlier[bucket.upperBound] = bucket.count;
+                }
+            }
+            MetricValue interval = value;
+            interval.buckets.clear();
+            interval.count = 0;
+            for (const auto& bucket : value.buckets) {
+                uint64_t added = bucket.count - earlier[bucket.upperBound];
+                if (added > 0) {
+                    interval.buckets.push_back({ bucket.upperBound, added });
+                    interval.count += added;
+                }
+            }
+            line += fmt::format(" {} p50 {:.3g} p99 {:.3g}", value.name, interval.quantile(0.5), interval.quantile(0.99));
+            break;
+        }
+        }
+    }
+    fmt::print("{}\n", line);
+}
+
+}
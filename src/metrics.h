@@ -0,0 +1,174 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace metrics {
+
+const size_t SHARD_COUNT = 16;
+
+// Index of the calling thread's shard, assigned round-robin on first use
+size_t shardIndex();
+
+// Monotonic count. Each thread adds to its own cache-line-sized shard with a
+// relaxed atomic, so concurrent increments never contend or lock.
+class Counter {
+public:
+    void add(uint64_t amount = 1) {
+        shards[shardIndex()].value.fetch_add(amount, std::memory_order_relaxed);
+    }
+
+    uint64_t value() const;
+
+private:
+    struct alignas(64) Shard {
+        std::atomic<uint64_t> value{ 0 };
+    };
+    std::array<Shard, SHARD_COUNT> shards;
+};
+
+// Last written value
+class Gauge {
+public:
+    void set(double newValue) { current.store(newValue, std::memory_order_relaxed); }
+    void add(double amount) { current.fetch_add(amount, std::memory_order_relaxed); }
+    double value() const { return current.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<double> current{ 0.0 };
+};
+
+// Log-linear histogram in the style of HDR histograms: values below 16 get a
+// bucket each, then every power of two is split into 16 buckets, giving about
+// 6% relative precision over the full 64-bit range. Recording is one relaxed
+// add per bucket, count and sum.
+class Histogram {
+public:
+    static const int SUB_BUCKET_BITS = 4;
+    static const int SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+    static const int BUCKET_COUNT = (64 - SUB_BUCKET_BITS + 1) * SUB_BUCKETS;
+
+    // `unit` converts recorded integers to the exported unit, e.g. 1e-9 for nanoseconds to seconds
+    explicit Histogram(double unit = 1.0) : unit(unit) {}
+
+    void record(uint64_t value) {
+        buckets[bucketIndex(value)].fetch_add(1, std::memory_order_relaxed);
+        count.fetch_add(1, std::memory_order_relaxed);
+        sum.fetch_add(value, std::memory_order_relaxed);
+    }
+
+    static int bucketIndex(uint64_t value);
+    // Largest value that falls into the bucket
+    static uint64_t bucketUpperBound(int index);
+
+    double getUnit() const { return unit; }
+
+private:
+    friend class Registry;
+
+    double unit;
+    std::array<std::atomic<uint64_t>, BUCKET_COUNT> buckets{};
+    std::atomic<uint64_t> count{ 0 };
+    std::atomic<uint64_t> sum{ 0 };
+};
+
+enum class Type {
+    Counter,
+    Gauge,
+    Histogram
+};
+
+struct HistogramBucket {
+    double upperBound;  // In the exported unit
+    uint64_t count;     // Values in this bucket only, not cumulative
+};
+
+struct MetricValue {
+    std::string name;
+    std::string help;
+    Type type;
+    double value = 0.0;   // Counter total or gauge value; histogram sum in the exported unit
+    uint64_t count = 0;   // Histogram sample count
+    std::vector<HistogramBucket> buckets;  // Non-empty histogram buckets in ascending order
+
+    // Histogram quantile estimate, q in [0, 1]
+    double quantile(double q) const;
+};
+
+// Immutable view of every metric at one point in time
+struct Snapshot {
+    std::chrono::system_clock::time_point time;
+    std::vector<MetricValue> values;
+
+    const MetricValue* find(const std::string& name) const;
+};
+
+// Owns every metric. Registration takes a lock and is meant for startup;
+// returned references stay valid for the life of the program.
+class Registry {
+public:
+    Counter& counter(const std::string& name, const std::string& help);
+    Gauge& gauge(const std::string& name, const std::string& help);
+    Histogram& histogram(const std::string& name, const std::string& help, double unit = 1.0);
+
+    Snapshot snapshot() const;
+
+private:
+    struct Entry {
+        std::string name;
+        std::string help;
+        Type type;
+        std::unique_ptr<Counter> counter;
+        std::unique_ptr<Gauge> gauge;
+        std::unique_ptr<Histogram> histogram;
+    };
+
+    Entry* find(const std::string& name, Type type);
+
+    mutable std::mutex mutex;
+    std::deque<Entry> entries;
+};
+
+Registry& registry();
+
+// Prometheus text exposition format, version 0.0.4. Histogram buckets are
+// cumulative and only the non-empty ones are listed, followed by +Inf.
+std::string formatPrometheus(const Snapshot& snapshot);
+
+// Background thread that snapshots the registry once per interval and
+// publishes it for readers such as exporters. Readers never block the
+// threads that record metrics.
+class Aggregator {
+public:
+    explicit Aggregator(std::chrono::milliseconds interval = std::chrono::seconds(1), bool log = false);
+    ~Aggregator();
+
+    Aggregator(const Aggregator&) = delete;
+    Aggregator& operator=(const Aggregator&) = delete;
+
+    // Most recent published snapshot; never null
+    std::shared_ptr<const Snapshot> latest() const { return published.load(std::memory_order_acquire); }
+
+private:
+    void run();
+    void logRates(const Snapshot& previous, const Snapshot& current) const;
+
+    std::chrono::milliseconds interval;
+    bool log;
+    std::atomic<std::shared_ptr<const Snapshot>> published;
+    std::mutex mutex;
+    std::condition_variable stopCondition;
+    bool stopping = false;
+    std::thread thread;
+};
+
+}
@@ -0,0 +1,223 @@
+#include "metrics_server.h"
+
+#include <cstdio>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <fmt/core.h>
+
+#ifdef __linux__
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+
+namespace {
+
+const size_t MAX_REQUEST_BYTES = 8192;
+const int MAX_EVENTS = 32;
+
+struct Connection {
+    std::string request;
+    std::string response;
+    size_t written = 0;
+};
+
+std::string httpResponse(const char* status, const char* contentType, const std::string& body) {
+    return fmt::format("HTTP/1.1 {}\r\nContent-Type: {}\r\nContent-Length: {}\r\nConnection: close\r\n\r\n{}",
+        status, contentType, body.size(), body);
+}
+
+}
+
+MetricsServer::MetricsServer(const metrics::Aggregator& aggregator, uint16_t port)
+    : aggregator(aggregator) {
+    listenFd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (listenFd < 0) {
+        throw std::runtime_error(fmt::format("Failed to create metrics socket: {}", std::strerror(errno)));
+    }
+    int reuse = 1;
+    setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = htons(port);
+    if (bind(listenFd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0 || listen(listenFd, 16) < 0) {
+        int error = errno;
+        close(listenFd);
+        throw std::runtime_error(fmt::format("Failed to listen on 127.0.0.1:{}: {}", port, std::strerror(error)));
+    }
+
+    epollFd = epoll_create1(EPOLL_CLOEXEC);
+    if (epollFd < 0) {
+        int error = errno;
+        close(listenFd);
+        throw std::runtime_error(fmt::format("Failed to create metrics epoll instance: {}", std::strerror(error)));
+    }
+    stopFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (stopFd < 0) {
+        int error = errno;
+        close(epollFd);
+        close(listenFd);
+        throw std::runtime_error(fmt::format("Failed to create metrics stop event: {}", std::strerror(error)));
+    }
+    epoll_event event{};
+    event.events = EPOLLIN;
+    event.data.fd = listenFd;
+    epoll_ctl(epollFd, EPOLL_CTL_ADD, listenFd, &event);
+    event.data.fd = stopFd;
+    epoll_ctl(epollFd, EPOLL_CTL_ADD, stopFd, &event);
+
+    thread = std::thread([this] { run(); });
+}
+
+MetricsServer::~MetricsServer() {
+    uint64_t one = 1;
+    if (write(stopFd, &one, sizeof(one)) < 0) {
+        std::fprintf(stderr, "Failed to stop metrics server\n");
+    }
+    thread.join();
+    close(stopFd);
+    close(epollFd);
+    close(listenFd);
+}
+
+void MetricsServer::run() {
+    std::unordered_map<int, Connection> connections;
+    auto closeConnection = [&](int fd) {
+        epoll_ctl(epollFd, EPOLL_CTL_DEL, fd, nullptr);
+        close(fd);
+        connections.erase(fd);
+    };
+
+    // Send what the socket takes; wait for EPOLLOUT on a full buffer, close when done
+    auto flush = [&](int fd, Connection& connection) {
+        while (connection.written < connection.response.size()) {
+            ssize_t sent = send(fd, connection.response.data() + connection.written,
+                connection.response.size() - connection.written, MSG_NOSIGNAL);
+            if (sent < 0) {
+                if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                    epoll_event event{};
+                    event.events = EPOLLOUT;
+                    event.data.fd = fd;
+                    epoll_ctl(epollFd, EPOLL_CTL_MOD, fd, &event);
+                    return;
+                }
+                break;
+            }
+            connection.written += static_cast<size_t>(sent);
+        }
+        closeConnection(fd);
+    };
+
+    auto respond = [&](int fd, Connection& connection) {
+        std::string requestLine = connection.request.substr(0, connection.request.find("\r\n"));
+        std::string method = requestLine.substr(0, requestLine.find(' '));
+        size_t pathStart = requestLine.find(' ');
+        std::string path = pathStart == std::string::npos ? ""
+            : requestLine.substr(pathStart + 1, requestLine.find(' ', pathStart + 1) - pathStart - 1);
+
+        if (method != "GET" && method != "HEAD") {
+            connection.response = httpResponse("405 Method Not Allowed", "text/plain", "Method not allowed\n");
+        }
+        else if (path != "/metrics") {
+            connection.response = httpResponse("404 Not Found", "text/plain", "Not found\n");
+        }
+        else {
+            connection.response = httpResponse("200 OK", "text/plain; version=0.0.4; charset=utf-8",
+                metrics::formatPrometheus(*aggregator.latest()));
+        }
+        if (method == "HEAD") {
+            connection.response.resize(connection.response.find("\r\n\r\n") + 4);
+        }
+        flush(fd, connection);
+    };
+
+    epoll_event events[MAX_EVENTS];
+    for (;;) {
+        int ready = epoll_wait(epollFd, events, MAX_EVENTS, -1);
+        if (ready < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            std::fprintf(stderr, "Metrics server stopped: %s\n", std::strerror(errno));
+            break;
+        }
+
+        for (int i = 0; i < ready; ++i) {
+            int fd = events[i].data.fd;
+            if (fd == stopFd) {
+                for (auto& [open, connection] : connections) {
+                    close(open);
+                }
+                return;
+            }
+
+            if (fd == listenFd) {
+                int client;
+                while ((client = accept4(listenFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0) {
+                    epoll_event event{};
+                    event.events = EPOLLIN | EPOLLRDHUP;
+                    event.data.fd = client;
+                    epoll_ctl(epollFd, EPOLL_CTL_ADD, client, &event);
+                    connections[client];
+                }
+                continue;
+            }
+
+            auto found = connections.find(fd);
+            if (found == connections.end()) {
+                continue;
+            }
+            Connection& connection = found->second;
+
+            if (events[i].events & EPOLLOUT) {
+                flush(fd, connection);
+                continue;
+            }
+
+            char buffer[1024];
+            bool peerDone = false;
+            for (;;) {
+                ssize_t received = recv(fd, buffer, sizeof(buffer), 0);
+                if (received > 0) {
+                    connection.request.append(buffer, static_cast<size_t>(received));
+                    continue;
+                }
+                peerDone = received == 0 || (errno != EAGAIN && errno != EWOULDBLOCK);
+                break;
+            }
+
+            if (connection.request.find("\r\n\r\n") != std::string::npos) {
+                respond(fd, connection);
+            }
+            else if (peerDone) {
+                closeConnection(fd);
+            }
+            else if (connection.request.size() > MAX_REQUEST_BYTES) {
+                connection.response = httpResponse("431 Request Header Fields Too Large", "text/plain", "Request too large\n");
+                flush(fd, connection);
+            }
+        }
+    }
+}
+
+#else
+
+MetricsServer::MetricsServer(const metrics::Aggregator& aggregator, uint16_t port)
+    : aggregator(aggregator) {
+    throw std::runtime_error("The metrics server is only available on Linux");
+}
+
+MetricsServer::~MetricsServer() {
+}
+
+void MetricsServer::run() {
+}
+
+#endif
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstdint>
+#include <thread>
+
+#include "metrics.h"
+
+// Minimal HTTP/1.1 server on 127.0.0.1 that answers GET /metrics with the
+// aggregator's latest snapshot in Prometheus text format. It runs one thread
+// with non-blocking sockets on epoll and only reads published snapshots, so a
+// scrape never touches the threads recording metrics. Linux only; elsewhere
+// the constructor reports the server as unavailable.
+class MetricsServer {
+public:
+    MetricsServer(const metrics::Aggregator& aggregator, uint16_t port);
+    ~MetricsServer();
+
+    MetricsServer(const MetricsServer&) = delete;
+    MetricsServer& operator=(const MetricsServer&) = delete;
+
+private:
+    void run();
+
+    const metrics::Aggregator& aggregator;
+    int listenFd = -1;
+    int epollFd = -1;
+    int stopFd = -1;  // eventfd written by the destructor to wake the loop
+    std::thread thread;
+};
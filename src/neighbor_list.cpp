@@ -0,0 +1,86 @@
+#include "neighbor_list.h"
+
+#include <algorithm>
+#include <cmath>
+
+float NeighborList::drift(const Ball* balls, size_t begin, size_t end) const {
+    float largest = 0.0f;
+    for (size_t i = begin; i < end && i < referenceX.size(); ++i) {
+        float dx = balls[i].x - referenceX[i];
+        float dy = balls[i].y - referenceY[i];
+        float grown = std::max(0.0f, balls[i].radius - referenceRadius[i]);
+        largest = std::max(largest, std::sqrt(dx * dx + dy * dy) + grown);
+    }
+    return largest;
+}
+
+bool NeighborList::stale(size_t count, float maxDrift) {
+    ticks++;
+    driftPerTick = maxDrift / static_cast<float>(ticks);
+    resized = built && count != referenceX.size();
+    // Two balls closing in can each use half the skin before a missed pair could touch
+    return !built || resized || skin <= 0.0f || maxDrift > 0.5f * skin;
+}
+
+float NeighborList::nextSkin() const {
+    if (!built) {
+        return NEIGHBOR_SKIN;
+    }
+    // Spawns and merges change the count every few ticks; rows would not outlive them
+    if (resized) {
+        return 0.0f;
+    }
+    return 2.0f * driftPerTick <= 0.5f * NEIGHBOR_SKIN ? NEIGHBOR_SKIN : 0.0f;
+}
+
+void NeighborList::prepare(const Ball* balls, size_t count, float maxRadius, float skin, const SpatialGrid& grid) {
+    this->grid = &grid;
+    this->maxRadius = maxRadius;
+    this->skin = skin;
+    ticks = 0;
+    referenceX.resize(count);
+    referenceY.resize(count);
+    referenceRadius.resize(count);
+    for (size_t i = 0; i < count; ++i) {
+        referenceX[i] = balls[i].x;
+        referenceY[i] = balls[i].y;
+        referenceRadius[i] = balls[i].radius;
+    }
+    blocks.resize(skin > 0.0f ? (count + BLOCK_SIZE - 1) / BLOCK_SIZE : 0);
+    built = true;
+}
+
+void NeighborList::buildBlock(const Ball* balls, size_t block) {
+    thread_local std::vector<uint32_t> nearby;
+    Block& rows = blocks[block];
+    size_t begin = block * BLOCK_SIZE;
+    size_t end = std::min(referenceX.size(), begin + BLOCK_SIZE);
+    rows.offsets.clear();
+    rows.neighbors.clear();
+    rows.offsets.push_back(0);
+    for (size_t i = begin; i < end; ++i) {
+        const Ball& ball = balls[i];
+        nearby.clear();
+        grid->query(balls, ball.x, ball.y, ball.radius + maxRadius + skin, nearby);
+        size_t rowBegin = rows.neighbors.size();
+        for (uint32_t j : nearby) {
+            float dx = balls[j].x - ball.x;
+            float dy = balls[j].y - ball.y;
+            float reach = ball.radius + balls[j].radius + skin;
+            if (j != i && dx * dx + dy * dy < reach * reach) {
+                rows.neighbors.push_back(j);
+            }
+        }
+        // The grid hands out cells in any order; sorted rows walk the balls front to back
+        std::sort(rows.neighbors.begin() + static_cast<std::ptrdiff_t>(rowBegin), rows.neighbors.end());
+        rows.offsets.push_back(static_cast<uint32_t>(rows.neighbors.size()));
+    }
+}
+
+size_t NeighborList::entries() const {
+    size_t total = 0;
+    for (const auto& block : blocks) {
+        total += block.neighbors.size();
+    }
+    return total;
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "simulation.h"
+#include "spatial_grid.h"
+
+const float NEIGHBOR_SKIN = 2.0f * BALL_RADIUS;  // Margin past contact distance kept in the lists
+
+// Verlet neighbor lists: for every ball, the balls within contact distance
+// plus a skin when the lists were built. Until some ball has drifted more
+// than half the skin since then, every touching pair is still in the lists,
+// so they can be reused for several ticks without a grid. When the balls move
+// too fast for that, or the ball count keeps changing, a list would only
+// serve a single tick; then no rows are built and of() queries the grid
+// directly, which finds the same pairs.
+//
+// Rows are stored in CSR form, in blocks of BLOCK_SIZE balls so blocks can be
+// built in parallel; each row is sorted by index.
+class NeighborList {
+public:
+    static const size_t BLOCK_SIZE = 4096;
+
+    // How far a ball of balls[begin, end) moved since the last build, plus
+    // how much it grew; the caller takes the maximum over its ranges
+    float drift(const Ball* balls, size_t begin, size_t end) const;
+
+    // Called once per tick with the largest drift: whether the lists no
+    // longer cover balls[0, count) because they were never built, were built
+    // for another count or without a skin, or `maxDrift` used up half the skin
+    bool stale(size_t count, float maxDrift);
+
+    // Skin for the next build: NEIGHBOR_SKIN when the count held still and
+    // the drift seen per tick lets lists built with it last at least two
+    // ticks, none otherwise
+    float nextSkin() const;
+
+    // Starts a rebuild for balls[0, count) against `grid`, which must be built
+    // from the same balls and outlive the tick: records the reference
+    // positions and sizes the blocks. `maxRadius` must bound every ball's
+    // radius. Without a skin there are no blocks to build.
+    void prepare(const Ball* balls, size_t count, float maxRadius, float skin, const SpatialGrid& grid);
+    size_t blockCount() const { return blocks.size(); }
+    // Fills one block. Different blocks may be built in parallel.
+    void buildBlock(const Ball* balls, size_t block);
+
+    // Candidates for the balls touching ball `i`: its row at the last build,
+    // ascending, or without a skin every other ball the grid finds within
+    // reach, in no particular order. `scratch` holds the latter.
+    std::span<const uint32_t> of(const Ball* balls, size_t i, std::vector<uint32_t>& scratch) const {
+        if (skin > 0.0f) {
+            const Block& block = blocks[i / BLOCK_SIZE];
+            size_t row = i % BLOCK_SIZE;
+            return { block.neighbors.data() + block.offsets[row], block.offsets[row + 1] - block.offsets[row] };
+        }
+        scratch.clear();
+        grid->query(balls, balls[i].x, balls[i].y, balls[i].radius + maxRadius, scratch);
+        std::erase(scratch, static_cast<uint32_t>(i));
+        return scratch;
+    }
+
+    // Pairs stored at the last build, counted once per direction
+    size_t entries() const;
+
+private:
+    struct Block {
+        std::vector<uint32_t> offsets;  // Rows + 1 offsets into `neighbors`
+        std::vector<uint32_t> neighbors;
+    };
+
+    bool built = false;
+    bool resized = false;  // The count changed at the last stale() check
+    const SpatialGrid* grid = nullptr;
+    float maxRadius = 0.0f;
+    float skin = 0.0f;
+    int ticks = 0;  // Since the last build
+    float driftPerTick = 0.0f;
+    std::vector<float> referenceX, referenceY, referenceRadius;  // Ball state at the last build
+    std::vector<Block> blocks;
+};
@@ -0,0 +1,148 @@
+#include "numa.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+std::vector<int> parseCpuList(const std::string& list) {
+    std::vector<int> cpus;
+    std::stringstream stream(list);
+    std::string range;
+    while (std::getline(stream, range, ',')) {
+        if (range.empty() || range == "\n") {
+            continue;
+        }
+        size_t dash = range.find('-');
+        try {
+            int first = std::stoi(range.substr(0, dash));
+            int last = dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
+            for (int cpu = first; cpu <= last; ++cpu) {
+                cpus.push_back(cpu);
+            }
+        }
+        catch (const std::exception&) {
+            // Ignore malformed entries rather than failing the whole topology
+        }
+    }
+    return cpus;
+}
+
+NumaTopology NumaTopology::detect() {
+    NumaTopology topology;
+
+    std::error_code error;
+    const std::filesystem::path nodeRoot("/sys/devices/system/node");
+    for (const auto& entry : std::filesystem::directory_iterator(nodeRoot, error)) {
+        std::string name = entry.path().filename().string();
+        if (name.rfind("node", 0) != 0 || name.size() <= 4
+            || !std::all_of(name.begin() + 4, name.end(), ::isdigit)) {
+            continue;
+        }
+
+        std::ifstream cpuList(entry.path() / "cpulist");
+        std::string list;
+        std::getline(cpuList, list);
+
+        NumaNode node;
+        node.id = std::stoi(name.substr(4));
+        node.cpus = parseCpuList(list);
+        if (!node.cpus.empty()) {
+            topology.nodes.push_back(node);
+        }
+    }
+
+    if (topology.nodes.empty()) {
+        NumaNode node;
+        unsigned cpuCount = std::max(1u, std::thread::hardware_concurrency());
+        for (unsigned cpu = 0; cpu < cpuCount; ++cpu) {
+            node.cpus.push_back(static_cast<int>(cpu));
+        }
+        topology.nodes.push_back(node);
+    }
+
+    std::sort(topology.nodes.begin(), topology.nodes.end(),
+        [](const NumaNode& a, const NumaNode& b) { return a.id < b.id; });
+    return topology;
+}
+
+int NumaTopology::nodeOfCpu(int cpu) const {
+    for (size_t i = 0; i < nodes.size(); ++i) {
+        if (std::find(nodes[i].cpus.begin(), nodes[i].cpus.end(), cpu) != nodes[i].cpus.end()) {
+            return static_cast<int>(i);
+        }
+    }
+    return -1;
+}
+
+int NumaTopology::indexOfNodeId(int id) const {
+    for (size_t i = 0; i < nodes.size(); ++i) {
+        if (nodes[i].id == id) {
+            return static_cast<int>(i);
+        }
+    }
+    return -1;
+}
+
+bool pinCurrentThread(const std::vector<int>& cpus) {
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int cpu : cpus) {
+        if (cpu >= 0 && cpu < CPU_SETSIZE) {
+            CPU_SET(cpu, &set);
+        }
+    }
+    return CPU_COUNT(&set) > 0 && pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+    (void)cpus;
+    return false;
+#endif
+}
+
+int currentNode(const NumaTopology& topology) {
+    if (topology.nodes.empty()) {
+        return -1;
+    }
+    if (topology.nodes.size() == 1) {
+        return 0;
+    }
+#ifdef __linux__
+    int cpu = sched_getcpu();
+    return cpu < 0 ? -1 : topology.nodeOfCpu(cpu);
+#else
+    return -1;
+#endif
+}
+
+int memoryNode(const NumaTopology& topology, const void* address) {
+    if (topology.nodes.empty()) {
+        return -1;
+    }
+    if (topology.nodes.size() == 1) {
+        return 0;
+    }
+#if defined(__linux__) && defined(SYS_move_pages)
+    // move_pages with no target nodes only reports where each page lives
+    long pageSize = sysconf(_SC_PAGESIZE);
+    void* page = reinterpret_cast<void*>(reinterpret_cast<uintptr_t>(address) & ~static_cast<uintptr_t>(pageSize - 1));
+    int status = -1;
+    if (syscall(SYS_move_pages, 0, 1UL, &page, nullptr, &status, 0) != 0 || status < 0) {
+        return -1;
+    }
+    return topology.indexOfNodeId(status);
+#else
+    (void)address;
+    return -1;
+#endif
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+struct NumaNode {
+    int id = 0;             // Kernel node number
+    std::vector<int> cpus;  // Logical CPUs on this node
+};
+
+// NUMA layout read from /sys/devices/system/node. Machines without NUMA
+// information are reported as a single node holding every CPU.
+struct NumaTopology {
+    std::vector<NumaNode> nodes;
+
+    static NumaTopology detect();
+
+    // Index into `nodes` of the node owning the given CPU or kernel node id, or -1
+    int nodeOfCpu(int cpu) const;
+    int indexOfNodeId(int id) const;
+};
+
+// Restricts the calling thread to the given CPUs. Returns false if unsupported or refused.
+bool pinCurrentThread(const std::vector<int>& cpus);
+
+// Node index of the CPU the calling thread is running on right now, or -1
+int currentNode(const NumaTopology& topology);
+
+// Node index holding the page at the given address, or -1 if it cannot be
+// queried or the topology is empty. Costs a syscall on multi-node machines.
+int memoryNode(const NumaTopology& topology, const void* address);
+
+// Parses a kernel CPU list such as "0-3,8,10-11"
+std::vector<int> parseCpuList(const std::string& list);
@@ -0,0 +1,218 @@
+#include "obstacles.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <fmt/core.h>
+
+namespace {
+
+const int MAX_OBSTACLE_CELLS = 1 << 22;
+
+// Pushes the ball out of the capsule along the normal and reflects its velocity
+bool bounceOffObstacle(Ball& ball, const Obstacle& obstacle) {
+    // Closest point of the segment to the ball
+    float ax = obstacle.x1 - obstacle.x0;
+    float ay = obstacle.y1 - obstacle.y0;
+    float lengthSquared = ax * ax + ay * ay;
+    float t = 0.0f;
+    if (lengthSquared > 0.0f) {
+        t = std::clamp(((ball.x - obstacle.x0) * ax + (ball.y - obstacle.y0) * ay) / lengthSquared, 0.0f, 1.0f);
+    }
+    float dx = ball.x - (obstacle.x0 + ax * t);
+    float dy = ball.y - (obstacle.y0 + ay * t);
+    float contact = obstacle.radius + ball.radius;
+    float distanceSquared = dx * dx + dy * dy;
+    if (distanceSquared >= contact * contact) {
+        return false;
+    }
+
+    // A ball dead on the segment goes up
+    float distance = std::sqrt(distanceSquared);
+    float nx = distance > 0.0f ? dx / distance : 0.0f;
+    float ny = distance > 0.0f ? dy / distance : 1.0f;
+    ball.x += nx * (contact - distance);
+    ball.y += ny * (contact - distance);
+
+    float normalSpeed = ball.dx * nx + ball.dy * ny;
+    if (normalSpeed < 0.0f) {
+        ball.dx -= (1.0f + OBSTACLE_RESTITUTION) * normalSpeed * nx;
+        ball.dy -= (1.0f + OBSTACLE_RESTITUTION) * normalSpeed * ny;
+    }
+    return true;
+}
+
+struct CellRange {
+    int minColumn, maxColumn, minRow, maxRow;
+};
+
+}
+
+ObstacleField::ObstacleField(std::vector<Obstacle> obstacles, float cellSize)
+    : obstacles(std::move(obstacles)) {
+    if (this->obstacles.empty()) {
+        return;
+    }
+
+    // Everything a ball center can be in contact with, per obstacle
+    float reach = BALL_RADIUS;
+    minX = minY = INFINITY;
+    float maxX = -INFINITY;
+    float maxY = -INFINITY;
+    for (const auto& obstacle : this->obstacles) {
+        float margin = obstacle.radius + reach;
+        minX = std::min(minX, std::min(obstacle.x0, obstacle.x1) - margin);
+        minY = std::min(minY, std::min(obstacle.y0, obstacle.y1) - margin);
+        maxX = std::max(maxX, std::max(obstacle.x0, obstacle.x1) + margin);
+        maxY = std::max(maxY, std::max(obstacle.y0, obstacle.y1) + margin);
+    }
+
+    // Coarser cells for very large boards, so the grid stays bounded
+    float width = maxX - minX;
+    float height = maxY - minY;
+    cellSize = std::max(cellSize, std::sqrt(width * height / static_cast<float>(MAX_OBSTACLE_CELLS)));
+    inverseCellSize = 1.0f / cellSize;
+    columns = std::max(1, static_cast<int>(std::ceil(width * inverseCellSize)));
+    rows = std::max(1, static_cast<int>(std::ceil(height * inverseCellSize)));
+
+    auto rangeOf = [&](const Obstacle& obstacle) {
+        float margin = obstacle.radius + reach;
+        auto column = [&](float x) {
+            return std::clamp(static_cast<int>(std::floor((x - minX) * inverseCellSize)), 0, columns - 1);
+        };
+        auto row = [&](float y) {
+            return std::clamp(static_cast<int>(std::floor((y - minY) * inverseCellSize)), 0, rows - 1);
+        };
+        return CellRange{
+            column(std::min(obstacle.x0, obstacle.x1) - margin), column(std::max(obstacle.x0, obstacle.x1) + margin),
+            row(std::min(obstacle.y0, obstacle.y1) - margin), row(std::max(obstacle.y0, obstacle.y1) + margin)
+        };
+    };
+
+    // Counting sort of (obstacle, cell) pairs, as in SpatialGrid::build
+    size_t cellCount = static_cast<size_t>(columns) * rows;
+    starts.assign(cellCount + 1, 0);
+    for (const auto& obstacle : this->obstacles) {
+        CellRange range = rangeOf(obstacle);
+        for (int row = range.minRow; row <= range.maxRow; ++row) {
+            for (int column = range.minColumn; column <= range.maxColumn; ++column) {
+                starts[static_cast<size_t>(row) * columns + column + 1]++;
+            }
+        }
+    }
+    for (size_t cell = 0; cell < cellCount; ++cell) {
+        starts[cell + 1] += starts[cell];
+    }
+
+    cells.resize(starts[cellCount]);
+    std::vector<uint32_t> next(starts.begin(), starts.end() - 1);
+    for (const auto& obstacle : this->obstacles) {
+        CellRange range = rangeOf(obstacle);
+        for (int row = range.minRow; row <= range.maxRow; ++row) {
+            for (int column = range.minColumn; column <= range.maxColumn; ++column) {
+                cells[next[static_cast<size_t>(row) * columns + column]++] = obstacle;
+            }
+        }
+    }
+}
+
+bool ObstacleField::collide(Ball& ball) const {
+    // Outside the baked area there is nothing to touch
+    float fx = (ball.x - minX) * inverseCellSize;
+    float fy = (ball.y - minY) * inverseCellSize;
+    if (!(fx >= 0.0f && fy >= 0.0f && fx < static_cast<float>(columns) && fy < static_cast<float>(rows))) {
+        return ball.radius > BALL_RADIUS && collideLarge(ball);
+    }
+    if (ball.radius > BALL_RADIUS) {
+        return collideLarge(ball);
+    }
+
+    size_t cell = static_cast<size_t>(fy) * columns + static_cast<size_t>(fx);
+    bool hit = false;
+    for (uint32_t i = starts[cell]; i < starts[cell + 1]; ++i) {
+        hit |= bounceOffObstacle(ball, cells[i]);
+    }
+    return hit;
+}
+
+bool ObstacleField::collideLarge(Ball& ball) const {
+    // Cells are baked for the default radius; a merged ball checks every cell it overlaps.
+    // An obstacle copied into several of them is skipped after the first push leaves it touching.
+    float margin = ball.radius - BALL_RADIUS;
+    int minColumn = std::max(0, static_cast<int>(std::floor((ball.x - margin - minX) * inverseCellSize)));
+    int maxColumn = std::min(columns - 1, static_cast<int>(std::floor((ball.x + margin - minX) * inverseCellSize)));
+    int minRow = std::max(0, static_cast<int>(std::floor((ball.y - margin - minY) * inverseCellSize)));
+    int maxRow = std::min(rows - 1, static_cast<int>(std::floor((ball.y + margin - minY) * inverseCellSize)));
+    bool hit = false;
+    for (int row = minRow; row <= maxRow; ++row) {
+        for (int column = minColumn; column <= maxColumn; ++column) {
+            size_t cell = static_cast<size_t>(row) * columns + column;
+            for (uint32_t i = starts[cell]; i < starts[cell + 1]; ++i) {
+                hit |= bounceOffObstacle(ball, cells[i]);
+            }
+        }
+    }
+    return hit;
+}
+
+std::vector<Obstacle> ObstacleField::load(const std::string& path) {
+    std::ifstream file(path);
+    if (!file) {
+        throw std::runtime_error(fmt::format("Failed to open obstacle file: {}", path));
+    }
+
+    std::vector<Obstacle> obstacles;
+    std::string line;
+    for (int lineNumber = 1; std::getline(file, line); ++lineNumber) {
+        line = line.substr(0, line.find('#'));
+        std::istringstream fields(line);
+        std::string kind;
+        if (!(fields >> kind)) {
+            continue;
+        }
+
+        Obstacle obstacle{};
+        bool valid = false;
+        if (kind == "peg") {
+            valid = static_cast<bool>(fields >> obstacle.x0 >> obstacle.y0 >> obstacle.radius);
+            obstacle.x1 = obstacle.x0;
+            obstacle.y1 = obstacle.y0;
+        }
+        else if (kind == "segment") {
+            valid = static_cast<bool>(fields >> obstacle.x0 >> obstacle.y0 >> obstacle.x1 >> obstacle.y1);
+            float thickness = 0.005f;
+            fields >> thickness;
+            obstacle.radius = 0.5f * thickness;
+        }
+        if (!valid || obstacle.radius < 0.0f) {
+            throw std::runtime_error(fmt::format("{}:{}: expected peg X Y RADIUS or segment X0 Y0 X1 Y1 [THICKNESS]",
+                path, lineNumber));
+        }
+        obstacles.push_back(obstacle);
+    }
+    return obstacles;
+}
+
+std::vector<Obstacle> ObstacleField::pegBoard(int rows, float wallRadius) {
+    float spacing = std::max(2.0f * wallRadius / static_cast<float>(std::max(1, rows)), 4.0f * BALL_RADIUS);
+    float pegRadius = 0.1f * spacing;
+    float rowHeight = spacing * 0.8660254f;
+    float limit = wallRadius - pegRadius - 3.0f * BALL_RADIUS;
+
+    // The top of the arena stays free for spawning
+    std::vector<Obstacle> pegs;
+    int row = 0;
+    for (float y = 0.5f * wallRadius; y > -wallRadius; y -= rowHeight, ++row) {
+        float shift = (row % 2) * 0.5f * spacing;
+        int half = static_cast<int>(wallRadius / spacing) + 1;
+        for (int column = -half; column <= half; ++column) {
+            float x = static_cast<float>(column) * spacing + shift;
+            if (x * x + y * y < limit * limit) {
+                pegs.push_back({ x, y, x, y, pegRadius });
+            }
+        }
+    }
+    return pegs;
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "simulation.h"
+
+const float OBSTACLE_RESTITUTION = 0.8f;  // Share of the normal speed kept on an obstacle bounce
+const float OBSTACLE_CELL_SIZE = 4.0f * BALL_RADIUS;
+
+// A capsule: the segment between the two ends, thickened by `radius`. A peg
+// is a capsule whose ends coincide. The layout is also the instance data of
+// the obstacle draw.
+struct Obstacle {
+    float x0, y0;
+    float x1, y1;
+    float radius;
+};
+
+const int OBSTACLE_INSTANCE_FLOATS = sizeof(Obstacle) / sizeof(float);
+
+// Static obstacles baked once into a uniform grid over their bounding box.
+// Each cell holds copies of every obstacle that a ball centered in it could
+// touch, stored contiguously, so a ball tests one cell and never looks at the
+// obstacle list as a whole: the cost per ball depends on the local density,
+// not on how many obstacles there are. Cells are baked for BALL_RADIUS; larger
+// (merged) balls take a slower path over every cell they overlap.
+class ObstacleField {
+public:
+    ObstacleField() = default;
+    explicit ObstacleField(std::vector<Obstacle> obstacles, float cellSize = OBSTACLE_CELL_SIZE);
+
+    // Reads "peg X Y RADIUS" and "segment X0 Y0 X1 Y1 [THICKNESS]" lines;
+    // '#' starts a comment. Throws on errors.
+    static std::vector<Obstacle> load(const std::string& path);
+
+    // Staggered rows of pegs filling the lower part of the circular arena,
+    // spaced so a ball always fits between two neighbours
+    static std::vector<Obstacle> pegBoard(int rows, float wallRadius);
+
+    // Pushes the ball out of every obstacle it overlaps and reflects its
+    // velocity off each one. Returns true on a hit.
+    bool collide(Ball& ball) const;
+
+    bool empty() const { return obstacles.empty(); }
+    const std::vector<Obstacle>& getObstacles() const { return obstacles; }
+    size_t bakedEntries() const { return cells.size(); }  // Obstacle copies over all cells
+
+private:
+    bool collideLarge(Ball& ball) const;
+
+    std::vector<Obstacle> obstacles;
+    float minX = 0.0f;
+    float minY = 0.0f;
+    float inverseCellSize = 0.0f;
+    int columns = 0;
+    int rows = 0;
+    std::vector<uint32_t> starts;  // columns * rows + 1 offsets into `cells`
+    std::vector<Obstacle> cells;   // Obstacles in cell order
+};
@@ -0,0 +1,235 @@
+#include "perf_counters.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <iterator>
+#include <string>
+#include <fmt/core.h>
+
+#include "metrics.h"
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
+
+namespace perf {
+
+std::atomic<bool> enabledFlag{ false };
+
+const char* phaseName(Phase phase) {
+    switch (phase) {
+    case Phase::Integrate: return "integrate";
+    case Phase::Wall: return "wall";
+    case Phase::Color: return "color";
+    case Phase::Spawn: return "spawn";
+    case Phase::Pack: return "pack";
+    default: return "unknown";
+    }
+}
+
+const char* eventName(Event event) {
+    switch (event) {
+    case Event::Cycles: return "cycles";
+    case Event::Instructions: return "instructions";
+    case Event::L1dMisses: return "l1d_misses";
+    case Event::LlcMisses: return "llc_misses";
+    case Event::BranchMisses: return "branch_misses";
+    default: return "unknown";
+    }
+}
+
+namespace {
+
+// One metrics counter per phase and event, registered up front so scopes never take the registry lock
+struct PhaseCounters {
+    metrics::Counter* counters[PHASE_COUNT][EVENT_COUNT];
+
+    PhaseCounters() {
+        for (int phase = 0; phase < PHASE_COUNT; ++phase) {
+            for (int event = 0; event < EVENT_COUNT; ++event) {
+                const char* phaseText = phaseName(static_cast<Phase>(phase));
+                const char* eventText = eventName(static_cast<Event>(event));
+                counters[phase][event] = &metrics::registry().counter(
+                    fmt::format("brainrot_perf_{}_{}_total", phaseText, eventText),
+                    fmt::format("Hardware {} during the {} phase", eventText, phaseText));
+            }
+        }
+    }
+};
+
+PhaseCounters& phaseCounters() {
+    static PhaseCounters instance;
+    return instance;
+}
+
+#ifdef __linux__
+
+// The calling thread's counter group: the cycles leader and whichever other
+// events the CPU supports, read together in one system call
+struct ThreadCounters {
+    int fds[EVENT_COUNT];
+    int groupIndex[EVENT_COUNT];  // Position in the group read, -1 when unsupported
+    int memberCount = 0;
+    bool open = false;
+
+    ThreadCounters() {
+        std::fill(std::begin(fds), std::end(fds), -1);
+        std::fill(std::begin(groupIndex), std::end(groupIndex), -1);
+
+        for (int event = 0; event < EVENT_COUNT; ++event) {
+            perf_event_attr attr;
+            std::memset(&attr, 0, sizeof(attr));
+            attr.size = sizeof(attr);
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+            switch (static_cast<Event>(event)) {
+            case Event::Cycles:
+                attr.type = PERF_TYPE_HARDWARE;
+                attr.config = PERF_COUNT_HW_CPU_CYCLES;
+                break;
+            case Event::Instructions:
+                attr.type = PERF_TYPE_HARDWARE;
+                attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+                break;
+            case Event::L1dMisses:
+                attr.type = PERF_TYPE_HW_CACHE;
+                attr.config = PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8)
+                    | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+                break;
+            case Event::LlcMisses:
+                attr.type = PERF_TYPE_HARDWARE;
+                attr.config = PERF_COUNT_HW_CACHE_MISSES;
+                break;
+            case Event::BranchMisses:
+                attr.type = PERF_TYPE_HARDWARE;
+                attr.config = PERF_COUNT_HW_BRANCH_MISSES;
+                break;
+            default:
+                continue;
+            }
+
+            int leader = fds[0];
+            int fd = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, leader, PERF_FLAG_FD_CLOEXEC));
+            if (fd < 0) {
+                if (event == 0) {
+                    // Without the leader there is no group to read
+                    return;
+                }
+                continue;
+            }
+            fds[event] = fd;
+            groupIndex[event] = memberCount++;
+        }
+        open = true;
+    }
+
+    ~ThreadCounters() {
+        for (int fd : fds) {
+            if (fd >= 0) {
+                close(fd);
+            }
+        }
+    }
+
+    // Fills counts[EVENT_COUNT] followed by time enabled and time running
+    bool read(uint64_t* counts) const {
+        uint64_t buffer[3 + EVENT_COUNT];
+        if (::read(fds[0], buffer, sizeof(buffer)) < static_cast<ssize_t>((3 + memberCount) * sizeof(uint64_t))) {
+            return false;
+        }
+        for (int event = 0; event < EVENT_COUNT; ++event) {
+            counts[event] = groupIndex[event] >= 0 ? buffer[3 + groupIndex[event]] : 0;
+        }
+        counts[EVENT_COUNT] = buffer[1];
+        counts[EVENT_COUNT + 1] = buffer[2];
+        return true;
+    }
+};
+
+ThreadCounters* threadCounters() {
+    thread_local ThreadCounters counters;
+    return counters.open ? &counters : nullptr;
+}
+
+#endif
+
+}
+
+#ifdef __linux__
+
+bool enable() {
+    phaseCounters();
+    // Probe on this thread so a refusal is reported once, up front
+    if (!threadCounters()) {
+        std::fprintf(stderr, "Hardware counters unavailable (%s); check /proc/sys/kernel/perf_event_paranoid\n",
+            std::strerror(errno));
+        return false;
+    }
+    enabledFlag.store(true, std::memory_order_relaxed);
+    return true;
+}
+
+Scope::Scope(Phase phase)
+    : phase(phase) {
+    if (enabled()) {
+        ThreadCounters* counters = threadCounters();
+        active = counters && counters->read(start);
+    }
+}
+
+Scope::~Scope() {
+    if (!active) {
+        return;
+    }
+    uint64_t end[EVENT_COUNT + 2];
+    if (!threadCounters()->read(end)) {
+        return;
+    }
+
+    // The kernel multiplexes when there are more events than hardware counters; scale up
+    uint64_t timeEnabled = end[EVENT_COUNT] - start[EVENT_COUNT];
+    uint64_t timeRunning = end[EVENT_COUNT + 1] - start[EVENT_COUNT + 1];
+    double scale = timeRunning > 0 && timeRunning < timeEnabled
+        ? static_cast<double>(timeEnabled) / static_cast<double>(timeRunning) : 1.0;
+
+    auto& counters = phaseCounters().counters[static_cast<int>(phase)];
+    for (int event = 0; event < EVENT_COUNT; ++event) {
+        counters[event]->add(static_cast<uint64_t>(static_cast<double>(end[event] - start[event]) * scale));
+    }
+}
+
+#else
+
+bool enable() {
+    std::fprintf(stderr, "Hardware counters are only available on Linux\n");
+    return false;
+}
+
+Scope::Scope(Phase phase)
+    : phase(phase) {}
+
+Scope::~Scope() {
+}
+
+#endif
+
+Totals totals() {
+    Totals result;
+    if (!enabled()) {
+        return result;
+    }
+    auto& counters = phaseCounters().counters;
+    for (int phase = 0; phase < PHASE_COUNT; ++phase) {
+        for (int event = 0; event < EVENT_COUNT; ++event) {
+            result.counts[phase][event] = counters[phase][event]->value();
+        }
+    }
+    return result;
+}
+
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+// Hardware performance counters per simulation phase, read with
+// perf_event_open around each phase on the thread that runs it. Counts are
+// added to the metrics registry as brainrot_perf_<phase>_<event>_total and the
+// profiler reports them per second. Disabled by default; a disabled Scope
+// costs one relaxed load. Linux only.
+namespace perf {
+
+enum class Phase {
+    Integrate,
+    Wall,
+    Color,
+    Spawn,
+    Pack,
+    Count
+};
+
+enum class Event {
+    Cycles,
+    Instructions,
+    L1dMisses,
+    LlcMisses,
+    BranchMisses,
+    Count
+};
+
+const char* phaseName(Phase phase);
+const char* eventName(Event event);
+
+const int PHASE_COUNT = static_cast<int>(Phase::Count);
+const int EVENT_COUNT = static_cast<int>(Event::Count);
+
+struct Totals {
+    uint64_t counts[PHASE_COUNT][EVENT_COUNT] = {};
+
+    uint64_t get(Phase phase, Event event) const {
+        return counts[static_cast<int>(phase)][static_cast<int>(event)];
+    }
+};
+
+extern std::atomic<bool> enabledFlag;
+
+// Turns counting on for every thread; each thread opens its counters on first
+// use. Returns false, with a message on stderr, when the kernel refuses them.
+bool enable();
+inline bool enabled() { return enabledFlag.load(std::memory_order_relaxed); }
+
+// Counts accumulated since enable()
+Totals totals();
+
+// Counts the calling thread's events from construction to destruction
+class Scope {
+public:
+    explicit Scope(Phase phase);
+    ~Scope();
+
+    Scope(const Scope&) = delete;
+    Scope& operator=(const Scope&) = delete;
+
+private:
+    Phase phase;
+    bool active = false;
+    uint64_t start[EVENT_COUNT + 2];  // Event counts, then time enabled and time running
+};
+
+}
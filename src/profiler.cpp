@@ -0,0 +1,205 @@
+#include "profiler.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <stdexcept>
+#include <fmt/core.h>
+
+namespace {
+
+int currentThreadIndex() {
+    static std::atomic<int> nextIndex{ 0 };
+    thread_local int index = nextIndex.fetch_add(1);
+    return index;
+}
+
+double milliseconds(Profiler::Clock::duration duration) {
+    return std::chrono::duration<double, std::milli>(duration).count();
+}
+
+}
+
+const char* stageName(Stage stage) {
+    switch (stage) {
+    case Stage::Simulate: return "simulate";
+    case Stage::Pack: return "pack";
+    case Stage::Submit: return "submit";
+    default: return "unknown";
+    }
+}
+
+Profiler::Profiler(bool printSummary)
+    : printSummary(printSummary), epoch(Clock::now()), windowStart(epoch), lastFrame(epoch) {}
+
+Profiler::~Profiler() {
+    if (trace.is_open()) {
+        trace << "\n]}\n";
+    }
+}
+
+void Profiler::openTrace(const std::string& path) {
+    trace.open(path);
+    if (!trace) {
+        throw std::runtime_error(fmt::format("Failed to open trace file: {}", path));
+    }
+    trace << "{\"traceEvents\":[";
+}
+
+void Profiler::record(Stage stage, uint64_t tick, Clock::time_point begin, Clock::time_point end) {
+    if (!printSummary && !trace.is_open()) {
+        return;
+    }
+
+    Interval interval{ stage, tick, begin, end, currentThreadIndex() };
+    std::lock_guard<std::mutex> lock(mutex);
+    window.push_back(interval);
+    if (trace.is_open()) {
+        writeTrace(interval);
+    }
+}
+
+void Profiler::endFrame(Clock::time_point now) {
+    frameTimes.push_back(milliseconds(now - lastFrame));
+    lastFrame = now;
+
+    if (now - windowStart >= std::chrono::seconds(1)) {
+        report(now);
+    }
+}
+
+void Profiler::report(Clock::time_point now) {
+    std::vector<Interval> intervals;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        intervals.swap(window);
+    }
+
+    double stageSum[static_cast<int>(Stage::Count)] = {};
+    double busy = 0.0;
+    for (const auto& interval : intervals) {
+        double duration = milliseconds(interval.end - interval.begin);
+        stageSum[static_cast<int>(interval.stage)] += duration;
+        busy += duration;
+    }
+
+    // Time during which at least one stage was running; anything above it ran concurrently
+    std::sort(intervals.begin(), intervals.end(),
+        [](const Interval& a, const Interval& b) { return a.begin < b.begin; });
+    double covered = 0.0;
+    Clock::time_point spanBegin{}, spanEnd{};
+    for (const auto& interval : intervals) {
+        if (interval.begin > spanEnd) {
+            covered += milliseconds(spanEnd - spanBegin);
+            spanBegin = interval.begin;
+            spanEnd = interval.end;
+        }
+        else {
+            spanEnd = std::max(spanEnd, interval.end);
+        }
+    }
+    covered += milliseconds(spanEnd - spanBegin);
+
+    uint64_t totals[static_cast<int>(Counter::Count)];
+    for (int i = 0; i < static_cast<int>(Counter::Count); ++i) {
+        totals[i] = counters[i].exchange(0, std::memory_order_relaxed);
+    }
+
+    if (printSummary && !frameTimes.empty()) {
+        double frames = static_cast<double>(frameTimes.size());
+        double frameTimeSum = 0.0;
+        for (double frameTime : frameTimes) {
+            frameTimeSum += frameTime;
+        }
+        double frameTimeMean = frameTimeSum / frames;
+        double squaredDeviation = 0.0;
+        for (double frameTime : frameTimes) {
+            squaredDeviation += (frameTime - frameTimeMean) * (frameTime - frameTimeMean);
+        }
+        std::sort(frameTimes.begin(), frameTimes.end());
+        double p99 = frameTimes[std::min(frameTimes.size() - 1, static_cast<size_t>(frames * 0.99))];
+
+        double seconds = std::chrono::duration<double>(now - windowStart).count();
+        double localBytes = static_cast<double>(totals[static_cast<int>(Counter::LocalBytes)]);
+        double remoteBytes = static_cast<double>(totals[static_cast<int>(Counter::RemoteBytes)]);
+        fmt::print("frame {:.2f} ms (sd {:.2f}, p99 {:.2f}, max {:.2f}) | simulate {:.2f} ms | pack {:.2f} ms | submit {:.2f} ms | overlap {:.0f}% ({:.2f}x)"
+            " | {:.2f}M ball steps/s | remote {:.1f} MB/s ({:.0f}%)\n",
+            frameTimeMean, std::sqrt(squaredDeviation / frames), p99, frameTimes.back(),
+            stageSum[static_cast<int>(Stage::Simulate)] / frames,
+            stageSum[static_cast<int>(Stage::Pack)] / frames,
+            stageSum[static_cast<int>(Stage::Submit)] / frames,
+            busy > 0.0 ? 100.0 * (1.0 - covered / busy) : 0.0,
+            covered > 0.0 ? busy / covered : 1.0,
+            static_cast<double>(totals[static_cast<int>(Counter::BallSteps)]) / seconds / 1e6,
+            remoteBytes / seconds / 1e6,
+            localBytes + remoteBytes > 0.0 ? 100.0 * remoteBytes / (localBytes + remoteBytes) : 0.0);
+
+        uint64_t gridUpdates = totals[static_cast<int>(Counter::GridUpdates)];
+        uint64_t gridRebuilds = totals[static_cast<int>(Counter::GridRebuilds)];
+        if (gridUpdates + gridRebuilds > 0) {
+            auto perGrid = [&](Counter nanoseconds, uint64_t count) {
+                return count > 0 ? static_cast<double>(totals[static_cast<int>(nanoseconds)]) / count / 1e3 : 0.0;
+            };
+            fmt::print("grid update {:.1f} us x{} | rebuild {:.1f} us x{}\n",
+                perGrid(Counter::GridUpdateNanoseconds, gridUpdates), gridUpdates,
+                perGrid(Counter::GridRebuildNanoseconds, gridRebuilds), gridRebuilds);
+        }
+    }
+
+    if (perf::enabled()) {
+        reportPerf(now);
+    }
+
+    frameTimes.clear();
+    windowStart = now;
+}
+
+void Profiler::reportPerf(Clock::time_point now) {
+    perf::Totals current = perf::totals();
+    std::string line = "perf";
+    for (int phase = 0; phase < perf::PHASE_COUNT; ++phase) {
+        uint64_t delta[perf::EVENT_COUNT];
+        for (int event = 0; event < perf::EVENT_COUNT; ++event) {
+            delta[event] = current.counts[phase][event] - lastPerf.counts[phase][event];
+        }
+        double cycles = static_cast<double>(delta[static_cast<int>(perf::Event::Cycles)]);
+        double instructions = static_cast<double>(delta[static_cast<int>(perf::Event::Instructions)]);
+        double perKiloInstruction = instructions > 0.0 ? 1000.0 / instructions : 0.0;
+        double ipc = cycles > 0.0 ? instructions / cycles : 0.0;
+        double l1 = static_cast<double>(delta[static_cast<int>(perf::Event::L1dMisses)]) * perKiloInstruction;
+        double llc = static_cast<double>(delta[static_cast<int>(perf::Event::LlcMisses)]) * perKiloInstruction;
+        double branch = static_cast<double>(delta[static_cast<int>(perf::Event::BranchMisses)]) * perKiloInstruction;
+        const char* name = perf::phaseName(static_cast<perf::Phase>(phase));
+
+        line += fmt::format(" | {} {:.1f}M cyc ipc {:.2f} l1 {:.1f} llc {:.2f} br {:.2f} /ki",
+            name, cycles / 1e6, ipc, l1, llc, branch);
+
+        std::lock_guard<std::mutex> lock(mutex);
+        if (trace.is_open()) {
+            double microseconds = std::chrono::duration<double, std::micro>(now - epoch).count();
+            trace << (firstTraceEvent ? "\n" : ",\n");
+            trace << fmt::format("{{\"name\":\"perf {}\",\"ph\":\"C\",\"pid\":1,\"ts\":{:.3f},"
+                "\"args\":{{\"ipc\":{:.3f},\"l1d_misses_per_ki\":{:.3f},\"llc_misses_per_ki\":{:.3f},\"branch_misses_per_ki\":{:.3f}}}}}",
+                name, microseconds, ipc, l1, llc, branch);
+            firstTraceEvent = false;
+        }
+    }
+    lastPerf = current;
+
+    if (printSummary) {
+        fmt::print("{}\n", line);
+    }
+}
+
+void Profiler::writeTrace(const Interval& interval) {
+    auto microseconds = [this](Clock::time_point time) {
+        return std::chrono::duration<double, std::micro>(time - epoch).count();
+    };
+
+    trace << (firstTraceEvent ? "\n" : ",\n");
+    trace << fmt::format("{{\"name\":\"{}\",\"ph\":\"X\",\"pid\":1,\"tid\":{},\"ts\":{:.3f},\"dur\":{:.3f},\"args\":{{\"tick\":{}}}}}",
+        stageName(interval.stage), interval.thread,
+        microseconds(interval.begin), microseconds(interval.end) - microseconds(interval.begin),
+        interval.tick);
+    firstTraceEvent = false;
+}
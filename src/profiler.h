@@ -0,0 +1,83 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "perf_counters.h"
+
+// Pipeline stages whose timing is tracked per frame
+enum class Stage {
+    Simulate,
+    Pack,
+    Submit,
+    Count
+};
+
+const char* stageName(Stage stage);
+
+// Totals accumulated between summaries
+enum class Counter {
+    BallSteps,    // Balls advanced by one tick
+    LocalBytes,   // Ball memory updated by a worker on the node holding it
+    RemoteBytes,  // Ball memory updated across nodes
+    GridUpdates,  // Neighbor grids brought up to date in place
+    GridUpdateNanoseconds,
+    GridRebuilds,  // Neighbor grids rebuilt from scratch, including update fallbacks
+    GridRebuildNanoseconds,
+    Count
+};
+
+// Collects per-stage timings from any thread, prints a once-per-second summary
+// with the frame-time spread and the amount of stage overlap achieved, and
+// optionally writes a Chrome trace.
+class Profiler {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    explicit Profiler(bool printSummary = false);
+    ~Profiler();
+
+    // Writes every recorded stage as a chrome://tracing event to the given file.
+    void openTrace(const std::string& path);
+
+    void record(Stage stage, uint64_t tick, Clock::time_point begin, Clock::time_point end);
+
+    // Whether counters are reported at all; callers skip costly accounting otherwise
+    bool summarizing() const { return printSummary; }
+
+    void add(Counter counter, uint64_t amount) {
+        counters[static_cast<int>(counter)].fetch_add(amount, std::memory_order_relaxed);
+    }
+
+    // Called by the render thread once per presented frame.
+    void endFrame(Clock::time_point now);
+
+private:
+    struct Interval {
+        Stage stage;
+        uint64_t tick;
+        Clock::time_point begin, end;
+        int thread;
+    };
+
+    void report(Clock::time_point now);
+    void writeTrace(const Interval& interval);
+    void reportPerf(Clock::time_point now);
+
+    bool printSummary;
+    std::mutex mutex;
+    std::vector<Interval> window;
+    Clock::time_point epoch;
+    Clock::time_point windowStart;
+    Clock::time_point lastFrame;
+    std::vector<double> frameTimes;  // Milliseconds, for this window's spread
+    std::atomic<uint64_t> counters[static_cast<int>(Counter::Count)] = {};
+    std::ofstream trace;
+    bool firstTraceEvent = true;
+    perf::Totals lastPerf;
+};
@@ -0,0 +1,34 @@
+#include "render_data.h"
+
+#include <cmath>
+
+VertexBuffer createCircleVertices(float radius, int segments) {
+    VertexBuffer vertices;
+    for (int i = 0; i <= segments; i++) {
+        float theta = 2.0f * 3.1415926f * float(i) / float(segments);
+        float x = radius * cosf(theta);
+        float y = radius * sinf(theta);
+        vertices.push_back(x);
+        vertices.push_back(y);
+        vertices.push_back(0.0f);
+    }
+    return vertices;
+}
+
+size_t packInstances(const BallStore& store, InstanceBuffer& instances)
+{
+    instances.resize(store.size() * INSTANCE_FLOATS);
+    float* out = instances.data();
+    for (const auto& slab : store.slabs) {
+        for (const auto& ball : slab.balls) {
+            out[0] = ball.x;
+            out[1] = ball.y;
+            out[2] = ball.r;
+            out[3] = ball.g;
+            out[4] = ball.b;
+            out[5] = ball.radius;
+            out += INSTANCE_FLOATS;
+        }
+    }
+    return store.size();
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+#include <cstddef>
+
+#include "memory_tracking.h"
+#include "simulation.h"
+
+const int INSTANCE_FLOATS = 6;  // x, y, r, g, b, radius per ball in the instance buffer
+
+using VertexBuffer = memory::TaggedVector<float, memory::Tag::Vertices>;
+// Packed per-ball instance attributes, uploaded to the GL instance buffer
+using InstanceBuffer = memory::TaggedVector<float, memory::Tag::Vertices>;
+
+// Triangle-fan / line-loop outline of a circle as x, y, z triples
+VertexBuffer createCircleVertices(float radius, int segments);
+
+// Writes INSTANCE_FLOATS per ball in slab order and returns the ball count
+size_t packInstances(const BallStore& store, InstanceBuffer& instances);
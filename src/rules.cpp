@@ -0,0 +1,233 @@
+#include "rules.h"
+
+#include <cmath>
+#include <fstream>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+#include <fmt/core.h>
+
+namespace {
+
+const float SPLIT_ANGLE = 0.5f;  // Radians each half turns away from the parent's heading
+const float MIN_SPLIT_RADIUS = 0.5f * BALL_RADIUS;  // Smaller balls no longer split
+
+bool chosen(const RuleStep& step, uint32_t seed, uint32_t ball) {
+    if (step.chanceThreshold == std::numeric_limits<uint32_t>::max()) {
+        return true;
+    }
+    uint32_t h = seed ^ step.salt ^ (ball * 0x9e3779b9u);
+    h = (h ^ (h >> 16)) * 0x85ebca6bu;
+    h = (h ^ (h >> 13)) * 0xc2b2ae35u;
+    return (h ^ (h >> 16)) < step.chanceThreshold;
+}
+
+void duplicateKernel(const RuleStep& step, Ball* balls, const uint32_t* selected, size_t count, uint32_t seed,
+    RuleEffects& effects) {
+    for (size_t k = 0; k < count; ++k) {
+        uint32_t i = selected[k];
+        if (!chosen(step, seed, i)) {
+            continue;
+        }
+        Ball duplicate = createDuplicateBall(balls[i], step.momentum);
+        for (int n = 0; n < step.count && effects.spawns->size() < effects.spawnRoom; ++n) {
+            effects.spawns->push_back(duplicate);
+        }
+    }
+}
+
+void splitKernel(const RuleStep& step, Ball* balls, const uint32_t* selected, size_t count, uint32_t seed,
+    RuleEffects& effects) {
+    const float c = std::cos(SPLIT_ANGLE);
+    const float s = std::sin(SPLIT_ANGLE);
+    for (size_t k = 0; k < count; ++k) {
+        uint32_t i = selected[k];
+        Ball& ball = balls[i];
+        // Without room the half would be dropped; the parent keeps its mass
+        if (ball.radius < MIN_SPLIT_RADIUS || effects.spawns->size() >= effects.spawnRoom || !chosen(step, seed, i)) {
+            continue;
+        }
+        effects.splits.push_back({ i, static_cast<uint32_t>(effects.spawns->size()), ball.radius, ball.dx, ball.dy });
+        // Half the mass each, headings turned apart so the halves separate
+        ball.radius *= 0.70710678f;
+        Ball half = ball;
+        float dx = ball.dx;
+        float dy = ball.dy;
+        ball.dx = dx * c - dy * s;
+        ball.dy = dx * s + dy * c;
+        half.dx = dx * c + dy * s;
+        half.dy = -dx * s + dy * c;
+        effects.spawns->push_back(half);
+    }
+}
+
+void recolorKernel(const RuleStep& step, Ball*, const uint32_t* selected, size_t count, uint32_t seed,
+    RuleEffects& effects) {
+    for (size_t k = 0; k < count; ++k) {
+        if (chosen(step, seed, selected[k])) {
+            effects.converted.push_back({ selected[k], step.target });
+        }
+    }
+}
+
+void despawnKernel(const RuleStep& step, Ball*, const uint32_t* selected, size_t count, uint32_t seed,
+    RuleEffects& effects) {
+    for (size_t k = 0; k < count; ++k) {
+        if (chosen(step, seed, selected[k])) {
+            effects.despawned.push_back(selected[k]);
+        }
+    }
+}
+
+RuleTrigger parseTrigger(const std::string& name) {
+    if (name == "wall-hit") return RuleTrigger::WallHit;
+    if (name == "timer") return RuleTrigger::Timer;
+    if (name == "contact") return RuleTrigger::Contact;
+    throw std::runtime_error(fmt::format("Unknown trigger {}; expected wall-hit, timer or contact", name));
+}
+
+RuleAction parseAction(const std::string& name) {
+    if (name == "duplicate") return RuleAction::Duplicate;
+    if (name == "split") return RuleAction::Split;
+    if (name == "recolor") return RuleAction::Recolor;
+    if (name == "despawn") return RuleAction::Despawn;
+    throw std::runtime_error(fmt::format("Unknown action {}; expected duplicate, split, recolor or despawn", name));
+}
+
+}
+
+std::vector<Rule> loadRules(const std::string& path) {
+    std::ifstream file(path);
+    if (!file) {
+        throw std::runtime_error(fmt::format("Could not open rule file {}", path));
+    }
+
+    std::vector<Rule> rules;
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline(file, line)) {
+        lineNumber++;
+        line = line.substr(0, line.find('#'));
+        std::istringstream words(line);
+        std::string trigger, action;
+        if (!(words >> trigger)) {
+            continue;
+        }
+        if (!(words >> action)) {
+            throw std::runtime_error(fmt::format("{}:{}: missing action", path, lineNumber));
+        }
+
+        Rule rule;
+        std::string setting;
+        try {
+            rule.trigger = parseTrigger(trigger);
+            rule.action = parseAction(action);
+            while (words >> setting) {
+                size_t equals = setting.find('=');
+                if (equals == std::string::npos) {
+                    throw std::runtime_error(fmt::format("expected key=value, got {}", setting));
+                }
+                std::string key = setting.substr(0, equals);
+                std::string value = setting.substr(equals + 1);
+                if (key == "species") rule.species = value;
+                else if (key == "count") rule.count = std::stoi(value);
+                else if (key == "momentum") rule.momentum = std::stof(value);
+                else if (key == "every") rule.period = std::stof(value);
+                else if (key == "chance") rule.chance = std::stof(value);
+                else if (key == "to") rule.target = value;
+                else throw std::runtime_error(fmt::format("unknown key {}", key));
+            }
+            if (rule.count < 0 || rule.count > MAX_RULE_COUNT) {
+                throw std::runtime_error(fmt::format("count must be within [0, {}]", MAX_RULE_COUNT));
+            }
+            if (!(rule.period > 0.0f) || !(rule.chance >= 0.0f && rule.chance <= 1.0f)) {
+                throw std::runtime_error("every must be > 0 and chance within [0, 1]");
+            }
+            if (rule.action == RuleAction::Recolor && rule.target.empty()) {
+                throw std::runtime_error("recolor needs to=SPECIES");
+            }
+        }
+        catch (const std::logic_error&) {
+            throw std::runtime_error(fmt::format("{}:{}: bad number in {}", path, lineNumber, setting));
+        }
+        catch (const std::runtime_error& e) {
+            throw std::runtime_error(fmt::format("{}:{}: {}", path, lineNumber, e.what()));
+        }
+        rules.push_back(rule);
+    }
+    return rules;
+}
+
+void RuleEffects::clear() {
+    despawned.clear();
+    converted.clear();
+    splits.clear();
+}
+
+bool RuleProgram::empty() const {
+    for (const auto& triggers : steps) {
+        for (const auto& list : triggers) {
+            if (!list.empty()) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+bool RuleProgram::uses(size_t species, RuleTrigger trigger) const {
+    return species < steps.size() && !steps[species][static_cast<int>(trigger)].empty();
+}
+
+const std::vector<RuleStep>& RuleProgram::of(size_t species, RuleTrigger trigger) const {
+    return steps[species][static_cast<int>(trigger)];
+}
+
+RuleProgram compileRules(const std::vector<Rule>& rules, const std::vector<Species>& species) {
+    auto speciesIndex = [&](const std::string& name) {
+        for (size_t i = 0; i < species.size(); ++i) {
+            if (species[i].name == name) {
+                return static_cast<int>(i);
+            }
+        }
+        throw std::runtime_error(fmt::format("Rule names species {}, which is not in the simulation", name));
+    };
+
+    RuleProgram program;
+    program.steps.resize(species.size());
+    for (size_t r = 0; r < rules.size(); ++r) {
+        const Rule& rule = rules[r];
+        RuleStep step{};
+        switch (rule.action) {
+        case RuleAction::Duplicate: step.kernel = duplicateKernel; break;
+        case RuleAction::Split: step.kernel = splitKernel; break;
+        case RuleAction::Recolor: step.kernel = recolorKernel; break;
+        case RuleAction::Despawn: step.kernel = despawnKernel; break;
+        }
+        step.count = rule.count;
+        step.momentum = rule.momentum;
+        step.period = rule.period;
+        step.chanceThreshold = rule.chance >= 1.0f ? std::numeric_limits<uint32_t>::max()
+            : static_cast<uint32_t>(static_cast<double>(rule.chance) * 4294967296.0);
+        step.target = rule.action == RuleAction::Recolor ? speciesIndex(rule.target) : -1;
+        step.salt = static_cast<uint32_t>(r + 1) * 0x27d4eb2fu;
+
+        int only = rule.species.empty() ? -1 : speciesIndex(rule.species);
+        for (size_t s = 0; s < species.size(); ++s) {
+            // Recoloring a ball into its own species would do nothing but churn its slab
+            if ((only >= 0 && static_cast<int>(s) != only) || step.target == static_cast<int>(s)) {
+                continue;
+            }
+            program.steps[s][static_cast<int>(rule.trigger)].push_back(step);
+            program.despawns = program.despawns || rule.action == RuleAction::Despawn;
+        }
+    }
+    return program;
+}
+
+void runRuleSteps(const std::vector<RuleStep>& steps, Ball* balls, const uint32_t* selected, size_t count,
+    uint32_t seed, RuleEffects& effects) {
+    for (const auto& step : steps) {
+        step.kernel(step, balls, selected, count, seed, effects);
+    }
+}
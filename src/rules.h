@@ -0,0 +1,109 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "simulation.h"
+#include "species.h"
+
+// Declarative spawn rules: when TRIGGER fires for a ball, do ACTION to it.
+// A rule table replaces the built-in "one duplicate per wall hit" rule.
+enum class RuleTrigger {
+    WallHit,  // The ball hit the container wall this tick
+    Timer,    // Every `period` of simulated time, for every ball
+    Contact,  // The ball overlaps another ball of its slab
+    Count
+};
+
+enum class RuleAction {
+    Duplicate,  // `count` copies with velocity scaled by `momentum`
+    Split,      // Halves the ball's mass and spins off the other half, if the budget keeps it
+    Recolor,    // Moves the ball to species `target`, and so to its palette
+    Despawn,    // Removes the ball
+};
+
+const int RULE_TRIGGER_COUNT = static_cast<int>(RuleTrigger::Count);
+
+struct Rule {
+    std::string species;  // Empty = every species
+    RuleTrigger trigger = RuleTrigger::WallHit;
+    RuleAction action = RuleAction::Duplicate;
+    int count = 1;
+    float momentum = DUPLICATE_MOMENTUM;
+    float period = 1.0f;  // Timer only, in simulated seconds
+    float chance = 1.0f;  // Probability that a triggered ball is acted on
+    std::string target;   // Recolor only: species name
+};
+
+// One rule per line: TRIGGER ACTION [key=value ...], with triggers wall-hit,
+// timer and contact, actions duplicate, split, recolor and despawn, and keys
+// species, count, momentum, every, chance and to. '#' starts a comment.
+// Throws on errors.
+std::vector<Rule> loadRules(const std::string& path);
+
+// Largest `count` a rule may ask for; more copies than MAX_BALLS are never kept
+const int MAX_RULE_COUNT = static_cast<int>(MAX_BALLS);
+
+// Side effects of the rule kernels on one batch of balls. Spawns go straight
+// to the chunk's duplicates so they share the MAX_BALLS budget; kernels stop
+// adding spawns once the buffer holds `spawnRoom`, which is at least what the
+// budget can still accept.
+struct RuleEffects {
+    struct Conversion {
+        uint32_t ball;  // Index in its slab
+        int species;
+    };
+    // A split parent as it was before the kernel halved it, so the split can
+    // be undone when the budget drops its half
+    struct Split {
+        uint32_t ball;   // Index in its slab
+        uint32_t spawn;  // Index of the half in `spawns`
+        float radius, dx, dy;
+    };
+
+    SpawnBuffer* spawns = nullptr;
+    size_t spawnRoom = 0;
+    std::vector<uint32_t> despawned;  // Indices in the slab, ascending per kernel
+    std::vector<Conversion> converted;
+    std::vector<Split> splits;  // In spawn order
+
+    void clear();
+};
+
+struct RuleStep;
+// Acts on balls[selected[0, count)]
+using RuleKernel = void (*)(const RuleStep& step, Ball* balls, const uint32_t* selected, size_t count,
+    uint32_t seed, RuleEffects& effects);
+
+// One compiled rule: the action's kernel with its parameters resolved
+struct RuleStep {
+    RuleKernel kernel;
+    int count;
+    float momentum;
+    float period;
+    uint32_t chanceThreshold;  // Acted on when the ball's hash is below it; UINT32_MAX = always
+    int target;
+    uint32_t salt;  // Decorrelates the chance draws of different rules
+};
+
+// Rules compiled at load: for every species and trigger, the kernels to run
+// over the balls the trigger selects, in table order. Nothing is interpreted
+// per ball; a trigger with no steps costs nothing.
+struct RuleProgram {
+    std::vector<std::array<std::vector<RuleStep>, RULE_TRIGGER_COUNT>> steps;  // [species][trigger]
+    bool despawns = false;  // Some step removes balls, freeing budget for spawns
+
+    bool empty() const;
+    bool uses(size_t species, RuleTrigger trigger) const;
+    const std::vector<RuleStep>& of(size_t species, RuleTrigger trigger) const;
+};
+
+// Throws when a rule names a species that is not in `species`
+RuleProgram compileRules(const std::vector<Rule>& rules, const std::vector<Species>& species);
+
+// Runs `steps` in order over the selected balls
+void runRuleSteps(const std::vector<RuleStep>& steps, Ball* balls, const uint32_t* selected, size_t count,
+    uint32_t seed, RuleEffects& effects);
@@ -0,0 +1,107 @@
+#include "scheduler.h"
+
+#include <atomic>
+#include <exception>
+#include <iostream>
+#include <mutex>
+
+void Event::set() {
+    std::vector<std::coroutine_handle<>> resumable;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        signaled = true;
+        resumable.swap(waiters);
+    }
+    setCondition.notify_all();
+    for (auto handle : resumable) {
+        pool.enqueue([handle] { handle.resume(); });
+    }
+}
+
+bool Event::isSet() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return signaled;
+}
+
+void Event::wait() {
+    std::unique_lock<std::mutex> lock(mutex);
+    setCondition.wait(lock, [this] { return signaled; });
+}
+
+bool Event::addWaiter(std::coroutine_handle<> handle) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (signaled) {
+        return false;
+    }
+    waiters.push_back(handle);
+    return true;
+}
+
+namespace {
+
+// Eagerly started coroutine that frees itself when it completes
+struct Detached {
+    struct promise_type {
+        Detached get_return_object() { return {}; }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() { std::terminate(); }
+    };
+};
+
+Detached runDetached(Task<void> task, std::shared_ptr<Event> done) {
+    try {
+        co_await std::move(task);
+    }
+    catch (const std::exception& e) {
+        std::cerr << "Background task failed: " << e.what() << std::endl;
+    }
+    catch (...) {
+        std::cerr << "Background task failed" << std::endl;
+    }
+    done->set();
+}
+
+}
+
+void launch(Task<void> task, std::shared_ptr<Event> done) {
+    runDetached(std::move(task), std::move(done));
+}
+
+Task<void> runTasks(ThreadPool& pool, std::vector<NodeTask> tasks) {
+    if (tasks.empty()) {
+        co_return;
+    }
+
+    // An exception must not leave the worker thread; the first one is rethrown
+    // to the awaiting coroutine once every task has run
+    struct Batch {
+        std::atomic<size_t> remaining;
+        std::mutex mutex;
+        std::exception_ptr error;
+    };
+    auto done = std::make_shared<Event>(pool);
+    auto batch = std::make_shared<Batch>();
+    batch->remaining = tasks.size();
+    for (auto& task : tasks) {
+        pool.enqueue([work = std::move(task.work), done, batch] {
+            try {
+                work();
+            }
+            catch (...) {
+                std::lock_guard<std::mutex> lock(batch->mutex);
+                if (!batch->error) {
+                    batch->error = std::current_exception();
+                }
+            }
+            if (batch->remaining.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                done->set();
+            }
+        }, task.node);
+    }
+    co_await *done;
+    if (batch->error) {
+        std::rethrow_exception(batch->error);
+    }
+}
@@ -0,0 +1,181 @@
+#pragma once
+
+#include <condition_variable>
+#include <coroutine>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <utility>
+#include <vector>
+
+#include "thread_pool.h"
+
+// Awaitable that continues the awaiting coroutine on a pool worker.
+inline auto resumeOn(ThreadPool& pool) {
+    struct Awaiter {
+        ThreadPool& pool;
+        bool await_ready() const noexcept { return false; }
+        void await_suspend(std::coroutine_handle<> handle) { pool.enqueue([handle] { handle.resume(); }); }
+        void await_resume() const noexcept {}
+    };
+    return Awaiter{ pool };
+}
+
+// One-shot completion flag. Coroutines that co_await it before it is set are
+// resumed on the pool; the render thread can block on it with wait().
+class Event {
+public:
+    explicit Event(ThreadPool& pool) : pool(pool) {}
+
+    Event(const Event&) = delete;
+    Event& operator=(const Event&) = delete;
+
+    void set();
+    bool isSet() const;
+    void wait();
+
+    auto operator co_await() {
+        struct Awaiter {
+            Event& event;
+            bool await_ready() const { return event.isSet(); }
+            bool await_suspend(std::coroutine_handle<> handle) { return event.addWaiter(handle); }
+            void await_resume() const noexcept {}
+        };
+        return Awaiter{ *this };
+    }
+
+private:
+    // Returns false if the event was set in the meantime and the caller should not suspend.
+    bool addWaiter(std::coroutine_handle<> handle);
+
+    ThreadPool& pool;
+    mutable std::mutex mutex;
+    std::condition_variable setCondition;
+    bool signaled = false;
+    std::vector<std::coroutine_handle<>> waiters;
+};
+
+template <typename T>
+class Task;
+
+namespace detail {
+
+// Hands control back to whoever awaited the finished task
+struct FinalAwaiter {
+    bool await_ready() const noexcept { return false; }
+    template <typename Promise>
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> handle) noexcept {
+        auto continuation = handle.promise().continuation;
+        return continuation ? continuation : std::noop_coroutine();
+    }
+    void await_resume() const noexcept {}
+};
+
+struct PromiseBase {
+    std::coroutine_handle<> continuation;
+    std::exception_ptr exception;
+
+    std::suspend_always initial_suspend() noexcept { return {}; }
+    FinalAwaiter final_suspend() noexcept { return {}; }
+
+    void unhandled_exception() { exception = std::current_exception(); }
+};
+
+template <typename T>
+struct Promise : PromiseBase {
+    std::optional<T> value;
+
+    Task<T> get_return_object();
+    void return_value(T result) { value = std::move(result); }
+
+    T take() {
+        if (exception) {
+            std::rethrow_exception(exception);
+        }
+        return std::move(*value);
+    }
+};
+
+template <>
+struct Promise<void> : PromiseBase {
+    Task<void> get_return_object();
+    void return_void() {}
+
+    void take() {
+        if (exception) {
+            std::rethrow_exception(exception);
+        }
+    }
+};
+
+}
+
+// Lazily started coroutine. It runs when awaited and resumes the awaiting
+// coroutine when it finishes, on whichever thread it finished on.
+template <typename T = void>
+class Task {
+public:
+    using promise_type = detail::Promise<T>;
+
+    explicit Task(std::coroutine_handle<promise_type> handle) : handle(handle) {}
+    Task(Task&& other) noexcept : handle(std::exchange(other.handle, {})) {}
+    Task& operator=(Task&& other) noexcept {
+        if (this != &other) {
+            if (handle) {
+                handle.destroy();
+            }
+            handle = std::exchange(other.handle, {});
+        }
+        return *this;
+    }
+    ~Task() {
+        if (handle) {
+            handle.destroy();
+        }
+    }
+
+    auto operator co_await() && noexcept {
+        struct Awaiter {
+            std::coroutine_handle<promise_type> handle;
+            bool await_ready() const noexcept { return false; }
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<> continuation) noexcept {
+                handle.promise().continuation = continuation;
+                return handle;
+            }
+            T await_resume() { return handle.promise().take(); }
+        };
+        return Awaiter{ handle };
+    }
+
+private:
+    std::coroutine_handle<promise_type> handle;
+};
+
+namespace detail {
+
+template <typename T>
+Task<T> Promise<T>::get_return_object() {
+    return Task<T>(std::coroutine_handle<Promise<T>>::from_promise(*this));
+}
+
+inline Task<void> Promise<void>::get_return_object() {
+    return Task<void>(std::coroutine_handle<Promise<void>>::from_promise(*this));
+}
+
+}
+
+// Starts a task that nobody awaits. `done` is set when it finishes; an escaping
+// exception is reported on stderr rather than lost.
+void launch(Task<void> task, std::shared_ptr<Event> done);
+
+// A pool task with an optional node preference (-1 for any worker)
+struct NodeTask {
+    int node = -1;
+    std::function<void()> work;
+};
+
+// Queues every task and completes once all of them have run. If tasks threw,
+// the first exception caught is rethrown from there.
+Task<void> runTasks(ThreadPool& pool, std::vector<NodeTask> tasks);
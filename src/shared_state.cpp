@@ -0,0 +1,261 @@
+#include "shared_state.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <type_traits>
+#include <fmt/core.h>
+
+#ifdef __unix__
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
+
+namespace shared_state {
+
+namespace {
+
+const int READ_ATTEMPTS = 8;
+
+size_t slotBytes(uint32_t capacity) {
+    size_t bytes = sizeof(SlotHeader) + capacity * BALL_FLOATS * sizeof(float);
+    return (bytes + alignof(SlotHeader) - 1) / alignof(SlotHeader) * alignof(SlotHeader);
+}
+
+size_t firstSlotOffset() {
+    return (sizeof(RingHeader) + alignof(SlotHeader) - 1) / alignof(SlotHeader) * alignof(SlotHeader);
+}
+
+template <typename Header, typename Memory>
+Header* slotAt(Memory* memory, uint64_t slotStride, size_t index) {
+    using Byte = std::conditional_t<std::is_const_v<Memory>, const char, char>;
+    return reinterpret_cast<Header*>(static_cast<Byte*>(memory) + firstSlotOffset() + index * slotStride);
+}
+
+float* ballsOf(SlotHeader* slot) {
+    return reinterpret_cast<float*>(reinterpret_cast<char*>(slot) + sizeof(SlotHeader));
+}
+
+const float* ballsOf(const SlotHeader* slot) {
+    return reinterpret_cast<const float*>(reinterpret_cast<const char*>(slot) + sizeof(SlotHeader));
+}
+
+}
+
+#ifdef __unix__
+
+namespace {
+
+// Whether `name` holds a ring whose producer has exited. Anything that is not
+// provably abandoned, including rings of other versions, counts as in use.
+bool isStale(const std::string& name) {
+    int fd = shm_open(name.c_str(), O_RDONLY, 0);
+    if (fd < 0) {
+        return errno == ENOENT;
+    }
+    struct stat info;
+    bool stale = false;
+    if (fstat(fd, &info) == 0 && static_cast<size_t>(info.st_size) >= sizeof(RingHeader)) {
+        void* mapped = mmap(nullptr, sizeof(RingHeader), PROT_READ, MAP_SHARED, fd, 0);
+        if (mapped != MAP_FAILED) {
+            const auto* header = static_cast<const RingHeader*>(mapped);
+            pid_t pid = static_cast<pid_t>(header->producerPid);
+            stale = header->magic == MAGIC && header->version == VERSION && pid > 0
+                && kill(pid, 0) < 0 && errno == ESRCH;
+            munmap(mapped, sizeof(RingHeader));
+        }
+    }
+    close(fd);
+    return stale;
+}
+
+}
+
+Publisher::Publisher(const std::string& name, uint32_t capacity, uint32_t slotCount)
+    : name(name) {
+    slotCount = std::max(2u, slotCount);
+    size = firstSlotOffset() + slotCount * slotBytes(capacity);
+
+    int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+    if (fd < 0 && errno == EEXIST) {
+        // Replace a segment left behind by a crashed run, never a live producer's
+        if (!isStale(name)) {
+            throw std::runtime_error(fmt::format("Shared memory {} is in use by another run", name));
+        }
+        shm_unlink(name.c_str());
+        fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+    }
+    if (fd < 0) {
+        throw std::runtime_error(fmt::format("Failed to create shared memory {}: {}", name, std::strerror(errno)));
+    }
+    if (ftruncate(fd, static_cast<off_t>(size)) < 0) {
+        int error = errno;
+        close(fd);
+        shm_unlink(name.c_str());
+        throw std::runtime_error(fmt::format("Failed to size shared memory {}: {}", name, std::strerror(error)));
+    }
+    memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (memory == MAP_FAILED) {
+        int error = errno;
+        shm_unlink(name.c_str());
+        throw std::runtime_error(fmt::format("Failed to map shared memory {}: {}", name, std::strerror(error)));
+    }
+
+    // ftruncate zero-fills, so every sequence starts even and latestTick at 0
+    header = static_cast<RingHeader*>(memory);
+    header->slotCount = slotCount;
+    header->capacity = capacity;
+    header->slotBytes = slotBytes(capacity);
+    header->version = VERSION;
+    header->producerPid = static_cast<int64_t>(getpid());
+    // Readers check the magic last, once the rest of the header is in place
+    std::atomic_thread_fence(std::memory_order_release);
+    header->magic = MAGIC;
+}
+
+Publisher::~Publisher() {
+    munmap(memory, size);
+    shm_unlink(name.c_str());
+}
+
+void Publisher::publish(uint64_t tick, const float* balls, size_t ballCount, float wallRadius, size_t stride) {
+    SlotHeader* slot = slotAt<SlotHeader>(memory, header->slotBytes, tick % header->slotCount);
+    size_t count = std::min(ballCount, static_cast<size_t>(header->capacity));
+
+    uint64_t sequence = slot->sequence.load(std::memory_order_relaxed);
+    slot->sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    slot->tick = tick;
+    slot->ballCount = static_cast<uint32_t>(count);
+    slot->wallRadius = wallRadius;
+    slot->population = ballCount;
+    if (stride == BALL_FLOATS) {
+        std::memcpy(ballsOf(slot), balls, count * BALL_FLOATS * sizeof(float));
+    }
+    else {
+        float* out = ballsOf(slot);
+        for (size_t i = 0; i < count; ++i) {
+            std::memcpy(out + i * BALL_FLOATS, balls + i * stride, BALL_FLOATS * sizeof(float));
+        }
+    }
+
+    slot->sequence.store(sequence + 2, std::memory_order_release);
+
+    // Two ticks can be packed concurrently; never move latestTick backwards
+    uint64_t latest = header->latestTick.load(std::memory_order_relaxed);
+    while (latest < tick && !header->latestTick.compare_exchange_weak(latest, tick, std::memory_order_release)) {
+    }
+}
+
+Reader::Reader(const std::string& name) {
+    int fd = shm_open(name.c_str(), O_RDONLY, 0);
+    if (fd < 0) {
+        throw std::runtime_error(fmt::format("Failed to open shared memory {}: {}", name, std::strerror(errno)));
+    }
+    struct stat info;
+    if (fstat(fd, &info) < 0 || static_cast<size_t>(info.st_size) < sizeof(RingHeader)) {
+        close(fd);
+        throw std::runtime_error(fmt::format("Shared memory {} is not a ball state ring", name));
+    }
+    size = static_cast<size_t>(info.st_size);
+    void* mapped = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapped == MAP_FAILED) {
+        throw std::runtime_error(fmt::format("Failed to map shared memory {}: {}", name, std::strerror(errno)));
+    }
+    memory = mapped;
+    header = static_cast<const RingHeader*>(memory);
+
+    bool valid = header->magic == MAGIC;
+    std::atomic_thread_fence(std::memory_order_acquire);
+    valid = valid && header->version == VERSION && header->slotCount > 0
+        && firstSlotOffset() + header->slotCount * header->slotBytes <= size;
+    if (!valid) {
+        munmap(mapped, size);
+        throw std::runtime_error(fmt::format("Shared memory {} is not a version {} ball state ring", name, VERSION));
+    }
+}
+
+Reader::~Reader() {
+    munmap(const_cast<void*>(memory), size);
+}
+
+#else
+
+Publisher::Publisher(const std::string& name, uint32_t capacity, uint32_t slotCount) {
+    throw std::runtime_error("Shared-memory state export needs POSIX shared memory");
+}
+
+Publisher::~Publisher() {
+}
+
+void Publisher::publish(uint64_t tick, const float* balls, size_t ballCount, float wallRadius, size_t stride) {
+}
+
+Reader::Reader(const std::string& name) {
+    throw std::runtime_error("Shared-memory state export needs POSIX shared memory");
+}
+
+Reader::~Reader() {
+}
+
+#endif
+
+uint64_t Reader::latestTick() const {
+    return header->latestTick.load(std::memory_order_acquire);
+}
+
+bool Reader::readLatest(Frame& frame) const {
+    // A slow reader can be lapped; fall back to whatever is newest now
+    for (int attempt = 0; attempt < READ_ATTEMPTS; ++attempt) {
+        uint64_t tick = latestTick();
+        if (tick == 0) {
+            return false;
+        }
+        if (read(tick, frame)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool Reader::read(uint64_t tick, Frame& frame) const {
+    const SlotHeader* slot = slotAt<const SlotHeader>(memory, header->slotBytes, tick % header->slotCount);
+    frame.balls.resize(header->capacity * BALL_FLOATS);
+
+    for (int attempt = 0; attempt < READ_ATTEMPTS; ++attempt) {
+        uint64_t before = slot->sequence.load(std::memory_order_acquire);
+        if (before & 1) {
+            continue;
+        }
+        uint64_t slotTick = slot->tick;
+        size_t count = std::min<size_t>(slot->ballCount, header->capacity);
+        float wallRadius = slot->wallRadius;
+        uint64_t population = slot->population;
+        std::memcpy(frame.balls.data(), ballsOf(slot), count * BALL_FLOATS * sizeof(float));
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot->sequence.load(std::memory_order_relaxed) != before) {
+            continue;
+        }
+        if (slotTick != tick) {
+            // Already overwritten by a newer tick, or not written yet
+            return false;
+        }
+        frame.tick = slotTick;
+        frame.wallRadius = wallRadius;
+        frame.ballCount = count;
+        frame.population = static_cast<size_t>(population);
+        frame.balls.resize(count * BALL_FLOATS);
+        return true;
+    }
+    return false;
+}
+
+}
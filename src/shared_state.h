@@ -0,0 +1,110 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <vector>
+
+// Live ball state published through a POSIX shared-memory ring.
+//
+// The segment holds a RingHeader followed by `slotCount` slots. Each slot is a
+// SlotHeader and room for `capacity` balls of BALL_FLOATS floats (x, y, r, g, b,
+// the same layout as the GL instance buffer). The producer writes tick N into
+// slot N % slotCount under that slot's seqlock: the sequence is odd while the
+// slot is being written and even once it is complete. Readers map the segment
+// read-only, copy a slot out and retry if the sequence moved, so the producer
+// never waits on or even knows about its readers.
+namespace shared_state {
+
+const uint32_t MAGIC = 0x4C425242;  // "BRBL"
+const uint32_t VERSION = 2;
+const size_t BALL_FLOATS = 5;
+const size_t MAX_CAPACITY = std::numeric_limits<uint32_t>::max();
+
+struct RingHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t slotCount;
+    uint32_t capacity;          // Balls per slot
+    uint64_t slotBytes;         // Stride between slots, header included
+    std::atomic<uint64_t> latestTick;  // Newest complete tick, 0 before the first
+    int64_t producerPid;        // Tells a crashed run's segment from a live one
+};
+
+struct alignas(64) SlotHeader {
+    std::atomic<uint64_t> sequence;
+    uint64_t tick;
+    uint32_t ballCount;
+    float wallRadius;
+    uint64_t population;  // Balls in the tick; above ballCount when the slot was too small
+};
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "Shared-memory seqlocks need lock-free 64-bit atomics");
+
+// One tick as seen by a reader
+struct Frame {
+    uint64_t tick = 0;
+    float wallRadius = 0.0f;
+    size_t ballCount = 0;
+    size_t population = 0;  // More than ballCount when the producer had to drop balls
+    std::vector<float> balls;  // ballCount * BALL_FLOATS
+};
+
+// Creates and owns the segment; unlinks it on destruction. A segment of the
+// same name is only replaced when the process that created it is gone;
+// otherwise the name is reported as in use.
+class Publisher {
+public:
+    // `name` is a shm_open name such as "/brainrot"
+    Publisher(const std::string& name, uint32_t capacity, uint32_t slotCount = 4);
+    ~Publisher();
+
+    Publisher(const Publisher&) = delete;
+    Publisher& operator=(const Publisher&) = delete;
+
+    // Writes one tick from packed instance data, `stride` floats per ball of
+    // which the first BALL_FLOATS are exported. Balls beyond the capacity are
+    // dropped and the slot reports the full population. Different ticks may be published concurrently as long as they
+    // map to different slots.
+    void publish(uint64_t tick, const float* balls, size_t ballCount, float wallRadius, size_t stride = BALL_FLOATS);
+
+    uint32_t capacity() const { return header->capacity; }
+
+private:
+    std::string name;
+    void* memory = nullptr;
+    size_t size = 0;
+    RingHeader* header = nullptr;
+};
+
+// Attaches to a published segment read-only.
+class Reader {
+public:
+    explicit Reader(const std::string& name);
+    ~Reader();
+
+    Reader(const Reader&) = delete;
+    Reader& operator=(const Reader&) = delete;
+
+    // Newest complete tick, 0 before the first
+    uint64_t latestTick() const;
+
+    // Copies the newest tick into `frame`. Returns false when nothing has been
+    // published yet or the producer kept overwriting the slot while reading.
+    bool readLatest(Frame& frame) const;
+
+    // Copies a specific tick if it is still in the ring
+    bool read(uint64_t tick, Frame& frame) const;
+
+    uint32_t capacity() const { return header->capacity; }
+    uint32_t slotCount() const { return header->slotCount; }
+
+private:
+    const void* memory = nullptr;
+    size_t size = 0;
+    const RingHeader* header = nullptr;
+};
+
+}
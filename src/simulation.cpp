@@ -0,0 +1,523 @@
+#include "simulation.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <random>
+
+#include "container.h"
+#include "obstacles.h"
+#include "perf_counters.h"
+
+namespace {
+
+uint32_t mixBits(uint32_t h) {
+    h ^= h >> 16;
+    h *= 0x85ebca6bu;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35u;
+    h ^= h >> 16;
+    return h;
+}
+
+uint32_t floatBits(float value) {
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+// Maps the top 24 bits of a hash to [-1, 1)
+float signedUnit(uint32_t h) {
+    return static_cast<float>(h >> 8) * (2.0f / 16777216.0f) - 1.0f;
+}
+
+// Small, fast generator for bulk spawns; streams seeded from different values are
+// independent for practical purposes
+struct SplitMix64 {
+    uint64_t state;
+
+    uint64_t next() {
+        uint64_t z = (state += 0x9e3779b97f4a7c15ull);
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+        return z ^ (z >> 31);
+    }
+
+    // Two floats in [0, 1) from one draw
+    void units(float& a, float& b) {
+        uint64_t bits = next();
+        a = static_cast<float>(bits >> 40) * (1.0f / 16777216.0f);
+        b = static_cast<float>((bits >> 8) & 0xffffffu) * (1.0f / 16777216.0f);
+    }
+};
+
+// Uniform position over the disk the balls fit in: the radius of a uniform point
+// has density proportional to r, so r = R * sqrt(u) needs no rejection loop
+void placeInDisk(Ball& ball, float u, float turn, float wallRadius) {
+    float distance = (wallRadius - BALL_RADIUS) * std::sqrt(u);
+    float angle = turn * 6.28318531f;
+    ball.x = distance * std::cos(angle);
+    ball.y = distance * std::sin(angle);
+}
+
+// Draws after which a spawn gives up on landing inside a non-circular container
+const int SPAWN_ATTEMPTS = 64;
+// Steps along the field normal that move a ball back inside the container
+const int PLACE_STEPS = 8;
+
+// Puts a ball given in the container's frame, where the wall has its unscaled
+// size, at the container's pose
+void toWorld(Ball& ball, float x, float y, const ContainerTransform& transform) {
+    if (!transform.moving) {
+        ball.x = x;
+        ball.y = y;
+        return;
+    }
+    x *= transform.scale;
+    y *= transform.scale;
+    ball.x = transform.x + transform.cosAngle * x - transform.sinAngle * y;
+    ball.y = transform.y + transform.sinAngle * x + transform.cosAngle * y;
+}
+
+void bounceJitter(const Ball& ball, uint32_t seed, float& randX, float& randY) {
+    uint32_t h = mixBits(seed ^ floatBits(ball.x));
+    h = mixBits(h ^ floatBits(ball.y));
+    h = mixBits(h ^ floatBits(ball.dx));
+    h = mixBits(h ^ floatBits(ball.dy));
+    randX = signedUnit(h);
+    randY = signedUnit(mixBits(h + 0x9e3779b9u));
+}
+
+bool collideWithMovingWall(Ball& ball, float wallRadius, uint32_t seed, const SimParams& params) {
+    const ContainerTransform& transform = params.transform;
+    float offsetX = ball.x - transform.x;
+    float offsetY = ball.y - transform.y;
+
+    // Ball position in the container frame, in world units
+    Ball local = ball;
+    local.x = transform.cosAngle * offsetX + transform.sinAngle * offsetY;
+    local.y = -transform.sinAngle * offsetX + transform.cosAngle * offsetY;
+
+    float distance = 0.0f;
+    float distanceFromCenter = 0.0f;
+    if (params.container) {
+        distance = params.container->sample(local.x / transform.scale, local.y / transform.scale);
+        if (distance * transform.scale + ball.radius <= 0.0f) {
+            return false;
+        }
+    }
+    else {
+        distanceFromCenter = std::sqrt(local.x * local.x + local.y * local.y);
+        if (distanceFromCenter + ball.radius <= wallRadius * transform.scale) {
+            return false;
+        }
+    }
+
+    // Velocity of the wall where the ball touches it: translation, rotation and growth
+    float growth = transform.scaleRate / transform.scale;
+    float wallVx = transform.vx - transform.angularVelocity * offsetY + growth * offsetX;
+    float wallVy = transform.vy + transform.angularVelocity * offsetX + growth * offsetY;
+    float relativeX = ball.dx - wallVx;
+    float relativeY = ball.dy - wallVy;
+    local.dx = transform.cosAngle * relativeX + transform.sinAngle * relativeY;
+    local.dy = -transform.sinAngle * relativeX + transform.cosAngle * relativeY;
+
+    if (params.container) {
+        local.x /= transform.scale;
+        local.y /= transform.scale;
+        bounceOffField(local, *params.container, distance, seed, params.centerBias, transform.scale,
+            params.momentumIncrement);
+        local.x *= transform.scale;
+        local.y *= transform.scale;
+    }
+    else {
+        bounceOffWall(local, wallRadius * transform.scale, distanceFromCenter, seed, params.centerBias,
+            params.momentumIncrement);
+    }
+
+    ball.x = transform.x + transform.cosAngle * local.x - transform.sinAngle * local.y;
+    ball.y = transform.y + transform.sinAngle * local.x + transform.cosAngle * local.y;
+    ball.dx = transform.cosAngle * local.dx - transform.sinAngle * local.dy + wallVx;
+    ball.dy = transform.sinAngle * local.dx + transform.cosAngle * local.dy + wallVy;
+    ball.addedMomentum = local.addedMomentum;
+    return true;
+}
+
+}
+
+void integrateBall(Ball& ball, float adjustedDeltaTime, float gravity) {
+    // Apply gravity
+    ball.dy -= gravity * adjustedDeltaTime;
+
+    // Update ball position
+    ball.x += ball.dx * adjustedDeltaTime;
+    ball.y += ball.dy * adjustedDeltaTime;
+}
+
+// Puts a ball that crossed the circular wall back on it and sends it off with
+// its reflection blended with a pull toward the center and a random kick
+void bounceOffWall(Ball& ball, float wallRadius, float distanceFromCenter, uint32_t seed, float centerBias,
+    float momentumIncrement) {
+    // Normalize the ball's position to the wall
+    float angle = std::atan2(ball.y, ball.x);
+    ball.x = (wallRadius - ball.radius) * std::cos(angle);
+    ball.y = (wallRadius - ball.radius) * std::sin(angle);
+
+    // Calculate the normal vector of the wall at the point of collision
+    float nx = ball.x / distanceFromCenter;
+    float ny = ball.y / distanceFromCenter;
+
+    // Calculate the dot product of velocity and normal
+    float dotProduct = ball.dx * nx + ball.dy * ny;
+
+    // Calculate the reflection vector
+    float rx = ball.dx - 2 * dotProduct * nx;
+    float ry = ball.dy - 2 * dotProduct * ny;
+
+    // Add a component directed towards the center
+    float centerX = -ball.x / distanceFromCenter;
+    float centerY = -ball.y / distanceFromCenter;
+
+    // Add random variation
+    float randX, randY;
+    bounceJitter(ball, seed, randX, randY);
+    randX *= RANDOM_FACTOR;
+    randY *= RANDOM_FACTOR;
+
+    // Combine reflection, center-directed, and random components
+    ball.dx = rx * (1 - centerBias) + centerX * centerBias + randX;
+    ball.dy = ry * (1 - centerBias) + centerY * centerBias + randY;
+
+    // Normalize and apply speed
+    float speed = std::sqrt(ball.dx * ball.dx + ball.dy * ball.dy);
+    ball.dx /= speed;
+    ball.dy /= speed;
+
+    // Increase the added momentum
+    ball.addedMomentum = std::min(ball.addedMomentum + momentumIncrement, MAX_ADDED_MOMENTUM);
+
+    // Apply the added momentum
+    float totalMomentum = 1.05f + ball.addedMomentum;
+    ball.dx *= totalMomentum;
+    ball.dy *= totalMomentum;
+}
+
+// The circle bounce with the field gradient as the wall normal and the inward
+// normal in place of the direction to the center
+void bounceOffField(Ball& ball, const DistanceField& field, float distance, uint32_t seed, float centerBias,
+    float scale, float momentumIncrement) {
+    float nx, ny;
+    field.normal(ball.x, ball.y, nx, ny);
+
+    // Move the ball back along the normal until it just touches the wall
+    float overlap = distance + ball.radius / scale;
+    ball.x -= nx * overlap;
+    ball.y -= ny * overlap;
+
+    float dotProduct = ball.dx * nx + ball.dy * ny;
+    float rx = ball.dx - 2 * dotProduct * nx;
+    float ry = ball.dy - 2 * dotProduct * ny;
+
+    float randX, randY;
+    bounceJitter(ball, seed, randX, randY);
+    randX *= RANDOM_FACTOR;
+    randY *= RANDOM_FACTOR;
+
+    ball.dx = rx * (1 - centerBias) - nx * centerBias + randX;
+    ball.dy = ry * (1 - centerBias) - ny * centerBias + randY;
+
+    float speed = std::sqrt(ball.dx * ball.dx + ball.dy * ball.dy);
+    ball.dx /= speed;
+    ball.dy /= speed;
+
+    ball.addedMomentum = std::min(ball.addedMomentum + momentumIncrement, MAX_ADDED_MOMENTUM);
+    float totalMomentum = 1.05f + ball.addedMomentum;
+    ball.dx *= totalMomentum;
+    ball.dy *= totalMomentum;
+}
+
+bool collideWithWall(Ball& ball, float wallRadius, uint32_t seed, const SimParams& params) {
+    if (params.transform.moving) {
+        return collideWithMovingWall(ball, wallRadius, seed, params);
+    }
+    if (params.container) {
+        float distance = params.container->sample(ball.x, ball.y);
+        if (distance + ball.radius > 0.0f) {
+            bounceOffField(ball, *params.container, distance, seed, params.centerBias, 1.0f, params.momentumIncrement);
+            return true;
+        }
+        return false;
+    }
+
+    float distanceFromCenter = std::sqrt(ball.x * ball.x + ball.y * ball.y);
+    if (distanceFromCenter + ball.radius > wallRadius) {
+        bounceOffWall(ball, wallRadius, distanceFromCenter, seed, params.centerBias, params.momentumIncrement);
+        return true;
+    }
+    return false;
+}
+
+// Gradient through the palette from the center to the edge; with RAINBOW, red
+// to purple. Stops of 0 and 1 make the blend exact, as the fixed gradient was.
+void setColorAt(Ball& ball, float x, float y, float wallRadius, const Palette& palette) {
+    float distanceFromCenter = std::sqrt(x * x + y * y);
+    float normalizedDistance = distanceFromCenter / wallRadius;
+
+    int segment;
+    float t;
+    if (normalizedDistance < 0.33f) {
+        segment = 0;
+        t = normalizedDistance * 3.0f;
+    }
+    else if (normalizedDistance < 0.66f) {
+        segment = 1;
+        t = (normalizedDistance - 0.33f) * 3.0f;
+    }
+    else {
+        segment = 2;
+        t = (normalizedDistance - 0.66f) * 3.0f;
+    }
+    const float* from = palette.stops[segment];
+    const float* to = palette.stops[segment + 1];
+    ball.r = from[0] + (to[0] - from[0]) * t;
+    ball.g = from[1] + (to[1] - from[1]) * t;
+    ball.b = from[2] + (to[2] - from[2]) * t;
+}
+
+void limitSpeed(Ball& ball) {
+    float currentSpeed = std::sqrt(ball.dx * ball.dx + ball.dy * ball.dy);
+    if (currentSpeed > MAX_SPEED) {
+        ball.dx = (ball.dx / currentSpeed) * MAX_SPEED;
+        ball.dy = (ball.dy / currentSpeed) * MAX_SPEED;
+    }
+}
+
+Ball createRandomBall(float wallRadius) {
+    static std::random_device rd;
+    static std::mt19937 gen(rd());
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    std::uniform_real_distribution<float> vel(-0.25f, 0.25f);
+
+    Ball ball;
+    placeInDisk(ball, unit(gen), unit(gen), wallRadius);
+
+    ball.dx = vel(gen);
+    ball.dy = vel(gen);
+    ball.addedMomentum = 1.05f;
+
+    // Colored like every other ball at rest, so a duplicate spawned on the first tick copies a defined color
+    setColorAt(ball, ball.x, ball.y, wallRadius);
+    return ball;
+}
+
+void createRandomBalls(Ball* balls, size_t count, float wallRadius, uint64_t stream, const SimParams& params) {
+    SplitMix64 gen{ stream };
+    const ContainerTransform& transform = params.transform;
+    float scale = transform.moving ? transform.scale : 1.0f;
+    for (size_t i = 0; i < count; ++i) {
+        Ball& ball = balls[i];
+        float u, turn, vx, vy;
+        // The container fits in the disk; redraw while a non-circular one's wall cuts the ball
+        for (int attempt = 1;; ++attempt) {
+            gen.units(u, turn);
+            placeInDisk(ball, u, turn, wallRadius * scale);
+            if (!params.container || attempt == SPAWN_ATTEMPTS
+                || params.container->sample(ball.x / scale, ball.y / scale) + BALL_RADIUS / scale <= 0.0f) {
+                break;
+            }
+        }
+        gen.units(vx, vy);
+        toWorld(ball, ball.x / scale, ball.y / scale, transform);
+        ball.dx = vx * 0.5f - 0.25f;
+        ball.dy = vy * 0.5f - 0.25f;
+        ball.addedMomentum = 1.05f;
+        setColorAt(ball, ball.x, ball.y, wallRadius);
+    }
+}
+
+Ball createBallAt(float x, float y, float wallRadius, const SimParams& params) {
+    static thread_local std::mt19937 gen(std::random_device{}());
+    std::uniform_real_distribution<float> vel(-0.25f, 0.25f);
+
+    // Work in the container's frame, where the wall has its unscaled size
+    const ContainerTransform& transform = params.transform;
+    float scale = 1.0f;
+    if (transform.moving) {
+        float offsetX = x - transform.x;
+        float offsetY = y - transform.y;
+        scale = transform.scale;
+        x = (transform.cosAngle * offsetX + transform.sinAngle * offsetY) / scale;
+        y = (-transform.sinAngle * offsetX + transform.cosAngle * offsetY) / scale;
+    }
+    float radius = BALL_RADIUS / scale;
+    // The container fits in the circle of the wall radius, and its field covers that circle
+    float distanceFromCenter = std::sqrt(x * x + y * y);
+    float maxDistance = wallRadius - radius;
+    if (distanceFromCenter > maxDistance) {
+        x *= maxDistance / distanceFromCenter;
+        y *= maxDistance / distanceFromCenter;
+    }
+    if (params.container) {
+        for (int step = 0; step < PLACE_STEPS; ++step) {
+            float distance = params.container->sample(x, y);
+            if (distance + radius <= 0.0f) {
+                break;
+            }
+            float nx, ny;
+            params.container->normal(x, y, nx, ny);
+            x -= nx * (distance + radius);
+            y -= ny * (distance + radius);
+        }
+    }
+
+    Ball ball;
+    toWorld(ball, x, y, transform);
+
+    ball.dx = vel(gen);
+    ball.dy = vel(gen);
+    ball.addedMomentum = 1.05f;
+    setColorAt(ball, ball.x, ball.y, wallRadius);
+    return ball;
+}
+
+Ball createDuplicateBall(const Ball& original, float momentumReduction) {
+    Ball newBall = original;
+    newBall.dx *= momentumReduction;
+    newBall.dy *= momentumReduction;
+    newBall.addedMomentum = 1.05f;  // Reset added momentum for the new ball
+    newBall.radius = BALL_RADIUS;  // A duplicate is a new ball, not a copy of a merged one
+    return newBall;
+}
+
+uint32_t tickSeed(uint32_t sessionSeed, uint64_t tick) {
+    uint32_t h = mixBits(sessionSeed ^ static_cast<uint32_t>(tick));
+    return mixBits(h ^ static_cast<uint32_t>(tick >> 32) ^ 0x5bd1e995u);
+}
+
+size_t updateBalls(std::vector<Ball>& balls, float wallRadius, float deltaTime, uint32_t seed,
+    const SimParams& params) {
+    // Adjust the delta time based on the simulation speed
+    float adjustedDeltaTime = deltaTime * SIMULATION_SPEED;
+
+    std::vector<Ball> newBalls;
+    size_t wallHits = 0;
+
+    for (size_t i = 0; i < balls.size(); ++i) {
+        Ball& ball = balls[i];
+
+        integrateBall(ball, adjustedDeltaTime, params.gravity);
+
+        if (params.obstacles) {
+            params.obstacles->collide(ball);
+        }
+
+        // Ball collision with the container wall
+        if (collideWithWall(ball, wallRadius, seed, params)) {
+            // Count the hit; the sound is played when this tick is presented
+            wallHits++;
+
+            // Create a duplicate ball with slightly reduced momentum
+            if (params.duplicateOnHit && balls.size() + newBalls.size() < MAX_BALLS) {
+                newBalls.push_back(createDuplicateBall(ball, params.duplicateMomentum));
+            }
+        }
+
+        for (auto& ball : balls) {
+            setColorAt(ball, ball.x, ball.y, wallRadius, params.palette);
+        }
+
+        // Limit maximum speed
+        limitSpeed(ball);
+    }
+
+    // Add the new balls to the main vector
+    balls.insert(balls.end(), newBalls.begin(), newBalls.end());
+    return wallHits;
+}
+
+size_t updateBallRange(Ball* balls, size_t count, float wallRadius, float deltaTime, uint32_t seed,
+    SpawnBuffer& duplicates, const SimParams& params, std::vector<WallHit>* wallHits) {
+    float adjustedDeltaTime = deltaTime * SIMULATION_SPEED;
+
+    // A range holds one species; its rules are loop constants
+    const float gravity = params.gravity;
+    const float duplicateMomentum = params.duplicateMomentum;
+    const Palette palette = params.palette;
+
+    // Split into passes so each loop stays simple; scratch is reused per worker
+    thread_local std::vector<float> startPositions;
+    thread_local std::vector<uint32_t> hits;
+    startPositions.resize(count * 2);
+    hits.clear();
+
+    {
+        perf::Scope scope(perf::Phase::Integrate);
+        for (size_t i = 0; i < count; ++i) {
+            startPositions[2 * i] = balls[i].x;
+            startPositions[2 * i + 1] = balls[i].y;
+            integrateBall(balls[i], adjustedDeltaTime, gravity);
+        }
+    }
+
+    {
+        perf::Scope scope(perf::Phase::Wall);
+        for (size_t i = 0; i < count; ++i) {
+            Ball& ball = balls[i];
+            if (params.obstacles) {
+                params.obstacles->collide(ball);
+            }
+            float dx = ball.dx;
+            float dy = ball.dy;
+            if (collideWithWall(ball, wallRadius, seed, params)) {
+                hits.push_back(static_cast<uint32_t>(i));
+                if (wallHits) {
+                    wallHits->push_back({ static_cast<uint32_t>(i), ball.x, ball.y, std::sqrt(dx * dx + dy * dy) });
+                }
+            }
+        }
+    }
+
+    // A duplicate carries the color its parent had before moving, as in the reference update
+    if (params.duplicateOnHit) {
+        perf::Scope scope(perf::Phase::Spawn);
+        for (uint32_t i : hits) {
+            Ball duplicate = createDuplicateBall(balls[i], duplicateMomentum);
+            setColorAt(duplicate, startPositions[2 * i], startPositions[2 * i + 1], wallRadius, palette);
+            duplicates.push_back(duplicate);
+        }
+    }
+
+    {
+        perf::Scope scope(perf::Phase::Color);
+        for (size_t i = 0; i < count; ++i) {
+            setColorAt(balls[i], balls[i].x, balls[i].y, wallRadius, palette);
+            limitSpeed(balls[i]);
+        }
+    }
+
+    return hits.size();
+}
+
+BallStore BallStore::partitioned(int nodeCount, int speciesCount) {
+    BallStore store;
+    int slabsPerSpecies = std::max(1, nodeCount);
+    store.slabs.resize(static_cast<size_t>(slabsPerSpecies) * std::max(1, speciesCount));
+    for (size_t i = 0; i < store.slabs.size(); ++i) {
+        store.slabs[i].species = static_cast<int>(i) / slabsPerSpecies;
+        store.slabs[i].node = nodeCount > 0 ? static_cast<int>(i) % slabsPerSpecies : -1;
+    }
+    return store;
+}
+
+size_t BallStore::size() const {
+    size_t total = 0;
+    for (const auto& slab : slabs) {
+        total += slab.balls.size();
+    }
+    return total;
+}
+
+BallSlab& BallStore::smallestSlab() {
+    return *std::min_element(slabs.begin(), slabs.end(),
+        [](const BallSlab& a, const BallSlab& b) { return a.balls.size() < b.balls.size(); });
+}
@@ -0,0 +1,148 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "memory_tracking.h"
+
+class DistanceField;
+class ObstacleField;
+
+const float BALL_RADIUS = 0.01f;
+const float SIMULATION_SPEED = 0.5f;  // Adjust this to slow down the simulation (lower = slower)
+
+const size_t MAX_BALLS = 1000;
+const size_t MAX_SPAWN_BALLS = 100000;  // Most balls keyboard and scripts may add in one tick
+const float MOMENTUM_INCREMENT = 0.05f;
+const float MAX_ADDED_MOMENTUM = 5.0f;
+const float GRAVITY = 1.8f;
+const float CENTER_BIAS = 0.5f;  // Strength of the center-directed bounce (0 to 1)
+const float RANDOM_FACTOR = 0.4f;  // Strength of random variation in bounce direction
+const float DUPLICATE_MOMENTUM = 0.95f;  // Velocity scale of the ball spawned on a wall hit
+const float MAX_SPEED = 10.0f;
+const float MAX_BALL_RADIUS = 0.2f;  // Merged balls stop growing here
+
+// Ball colors by distance from the center: the gradient runs through the four
+// stops at 0, 0.33, 0.66 and 1 of the wall radius
+struct Palette {
+    float stops[4][3];
+};
+
+const Palette RAINBOW = { { { 1.0f, 0.0f, 0.0f }, { 1.0f, 1.0f, 0.0f }, { 0.0f, 1.0f, 1.0f }, { 1.0f, 0.0f, 1.0f } } };
+
+// Pose of the container at the end of a tick, and its rate of change per unit
+// of simulated time (the time balls integrate over)
+struct ContainerTransform {
+    bool moving = false;  // False = fixed at the origin; the rest is ignored
+    float x = 0.0f;
+    float y = 0.0f;
+    float cosAngle = 1.0f;  // Rotation, counterclockwise
+    float sinAngle = 0.0f;
+    float scale = 1.0f;
+    float vx = 0.0f;
+    float vy = 0.0f;
+    float angularVelocity = 0.0f;
+    float scaleRate = 0.0f;
+};
+
+// Parameters that can change between ticks; defaults are the constants above
+struct SimParams {
+    float gravity = GRAVITY;
+    float centerBias = CENTER_BIAS;  // 0 to 1
+    const DistanceField* container = nullptr;  // Container shape; null = circle of the wall radius
+    ContainerTransform transform;
+    const ObstacleField* obstacles = nullptr;  // Static pegs and segments, fixed in world space
+    bool coalesce = false;  // Balls that run into each other merge; see mergeSets
+
+    // Rules of the species being stepped; see Species::apply
+    float momentumIncrement = MOMENTUM_INCREMENT;
+    float duplicateMomentum = DUPLICATE_MOMENTUM;
+    bool duplicateOnHit = true;
+    Palette palette = RAINBOW;
+};
+
+// Stable identity of a ball across ticks; see BallHandles
+using BallHandle = uint32_t;
+const BallHandle NO_HANDLE = 0;
+
+struct Ball {
+    float x, y;
+    float dx, dy;
+    float r, g, b;  // Color
+    float addedMomentum;  // New variable to store added momentum
+    float radius = BALL_RADIUS;  // Mass is proportional to radius squared
+};
+
+// A ball that hit the wall during a tick
+struct WallHit {
+    uint32_t ball;  // Index in its slab after the tick
+    float x, y;     // Point on the wall it was put back on
+    float speed;    // Speed at impact
+};
+
+// Storage for live balls, and for balls waiting to be added to it
+using BallVector = memory::TaggedVector<Ball, memory::Tag::Balls>;
+using SpawnBuffer = memory::TaggedVector<Ball, memory::Tag::Spawn>;
+using HandleVector = memory::TaggedVector<BallHandle, memory::Tag::Balls>;
+
+Ball createRandomBall(float wallRadius);
+// Fills balls[0, count) with random balls spread uniformly over the container
+// of `params` in its pose params.transform, drawn from the generator stream
+// `stream`. Ranges filled from different streams can run on different threads.
+void createRandomBalls(Ball* balls, size_t count, float wallRadius, uint64_t stream, const SimParams& params = {});
+// New ball at (x, y) with a small random velocity, moved inside the container of `params` if needed
+Ball createBallAt(float x, float y, float wallRadius, const SimParams& params = {});
+Ball createDuplicateBall(const Ball& original, float momentumReduction);
+
+// Steps of the update, in the order the kernels apply them; exposed for benchmarks
+void integrateBall(Ball& ball, float adjustedDeltaTime, float gravity);
+void bounceOffWall(Ball& ball, float wallRadius, float distanceFromCenter, uint32_t seed, float centerBias,
+    float momentumIncrement = MOMENTUM_INCREMENT);
+// Same bounce against a distance field wall; `distance` is the field at the
+// ball's center. Position and distance are in field units, `scale` world units each.
+void bounceOffField(Ball& ball, const DistanceField& field, float distance, uint32_t seed, float centerBias,
+    float scale = 1.0f, float momentumIncrement = MOMENTUM_INCREMENT);
+// Bounces the ball if it touches the container wall. A moving container is
+// handled in its own frame: the ball bounces off it with its velocity relative
+// to the wall and then takes on the wall's velocity. Returns true on a hit.
+bool collideWithWall(Ball& ball, float wallRadius, uint32_t seed, const SimParams& params);
+void setColorAt(Ball& ball, float x, float y, float wallRadius, const Palette& palette = RAINBOW);
+void limitSpeed(Ball& ball);
+
+// Seed for the wall-bounce jitter of one tick. Jitter is hashed from this seed
+// and the ball's own state rather than drawn from a shared generator, so every
+// update path produces the same bounces regardless of order or thread count.
+uint32_t tickSeed(uint32_t sessionSeed, uint64_t tick);
+
+// Reference update of all balls in storage order. Returns the number of wall hits.
+size_t updateBalls(std::vector<Ball>& balls, float wallRadius, float deltaTime, uint32_t seed,
+    const SimParams& params = {});
+
+// Advances balls[0, count) one tick, equivalent to the reference update for
+// those balls. Duplicates spawned by wall hits are appended to `duplicates`
+// in ball order; the caller applies the MAX_BALLS budget. With `hits`, every
+// wall hit is appended to it, indexed within the range. Returns the number of wall hits.
+size_t updateBallRange(Ball* balls, size_t count, float wallRadius, float deltaTime, uint32_t seed,
+    SpawnBuffer& duplicates, const SimParams& params = {}, std::vector<WallHit>* wallHits = nullptr);
+
+// Balls owned by one NUMA node. The slab is only resized and written by
+// workers of that node so its pages are first touched there.
+struct BallSlab {
+    int node = -1;  // Node index, or -1 when storage is not partitioned
+    int species = 0;  // Every ball of a slab is of one species
+    BallVector balls;
+    HandleVector handles;  // handles[i] names balls[i] while a BallStepper tracks handles; empty otherwise
+};
+
+struct BallStore {
+    std::vector<BallSlab> slabs;
+
+    // For each species in turn, one slab per node index, or a single unowned
+    // slab when nodeCount is 0
+    static BallStore partitioned(int nodeCount, int speciesCount = 1);
+
+    size_t size() const;
+    // Slab that should receive newly spawned balls
+    BallSlab& smallestSlab();
+};
@@ -0,0 +1,149 @@
+#include "spatial_grid.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+const uint32_t SPARE_SLOTS = 8;  // Free slots per cell on top of half its balls
+const size_t REBUILD_DIVISOR = 16;  // update() rebuilds once more than count / REBUILD_DIVISOR balls changed
+const size_t SAMPLE_BALLS = 1024;  // Balls update() scans before trusting the changed fraction seen so far
+
+}
+
+SpatialGrid::SpatialGrid(float extent, float cellSize) {
+    reset(extent, cellSize);
+}
+
+void SpatialGrid::reset(float extent, float cellSize) {
+    if (extent == this->extent && cellSize == this->cellSize) {
+        return;
+    }
+    this->extent = extent;
+    this->cellSize = cellSize;
+    inverseCellSize = 1.0f / cellSize;
+    side = std::max(1, static_cast<int>(std::ceil(2.0f * extent * inverseCellSize)));
+    starts.assign(static_cast<size_t>(side) * side + 1, 0);
+    ends.assign(static_cast<size_t>(side) * side, 0);
+    sorted.clear();
+    built = false;
+}
+
+int SpatialGrid::clampCell(float coordinate) const {
+    // Truncating differs from floor only below zero, which clamps to the first cell either way
+    int cell = static_cast<int>((coordinate + extent) * inverseCellSize);
+    return std::clamp(cell, 0, side - 1);
+}
+
+int SpatialGrid::cellOf(float x, float y) const {
+    return clampCell(y) * side + clampCell(x);
+}
+
+void SpatialGrid::build(const Ball* balls, size_t count) {
+    size_t cellCount = static_cast<size_t>(side) * side;
+    std::fill(ends.begin(), ends.end(), 0);
+    cellOfBall.resize(count);
+    slotOfBall.resize(count);
+    for (size_t i = 0; i < count; ++i) {
+        int cell = cellOf(balls[i].x, balls[i].y);
+        cellOfBall[i] = static_cast<uint32_t>(cell);
+        ends[cell]++;
+    }
+    starts[0] = 0;
+    for (size_t cell = 0; cell < cellCount; ++cell) {
+        starts[cell + 1] = starts[cell] + ends[cell] + ends[cell] / 2 + SPARE_SLOTS;
+        ends[cell] = starts[cell];
+    }
+
+    // Scatter in ball order, so each cell lists its balls in ascending index order
+    sorted.resize(starts[cellCount]);
+    for (size_t i = 0; i < count; ++i) {
+        uint32_t slot = ends[cellOfBall[i]]++;
+        sorted[slot] = static_cast<uint32_t>(i);
+        slotOfBall[i] = slot;
+    }
+    built = true;
+    changedCount = count;
+}
+
+bool SpatialGrid::update(const Ball* balls, size_t count) {
+    size_t previous = cellOfBall.size();
+    if (!built || count < previous) {
+        build(balls, count);
+        return true;
+    }
+
+    // Compact list of the balls that left their cell; past the limit a rebuild is cheaper. Ball order
+    // is unrelated to position, so a prefix that already changed too much predicts the rest.
+    size_t limit = count / REBUILD_DIVISOR;
+    size_t added = count - previous;
+    changed.clear();
+    bool tooMany = added > limit;
+    for (size_t i = 0; i < previous && !tooMany; ++i) {
+        if (static_cast<uint32_t>(cellOf(balls[i].x, balls[i].y)) != cellOfBall[i]) {
+            changed.push_back(static_cast<uint32_t>(i));
+            tooMany = changed.size() + added > limit || (i >= SAMPLE_BALLS && changed.size() * REBUILD_DIVISOR > i);
+        }
+    }
+    if (tooMany) {
+        build(balls, count);
+        return true;
+    }
+    for (uint32_t i : changed) {
+        remove(i);
+    }
+    cellOfBall.resize(count);
+    slotOfBall.resize(count);
+    for (size_t i = previous; i < count; ++i) {
+        changed.push_back(static_cast<uint32_t>(i));
+    }
+    for (uint32_t i : changed) {
+        if (!insert(i, static_cast<uint32_t>(cellOf(balls[i].x, balls[i].y)))) {
+            build(balls, count);
+            return true;
+        }
+    }
+    changedCount = changed.size();
+    return false;
+}
+
+bool SpatialGrid::insert(uint32_t ball, uint32_t cell) {
+    if (ends[cell] == starts[cell + 1]) {
+        return false;
+    }
+    uint32_t slot = ends[cell]++;
+    sorted[slot] = ball;
+    cellOfBall[ball] = cell;
+    slotOfBall[ball] = slot;
+    return true;
+}
+
+void SpatialGrid::remove(uint32_t ball) {
+    // The cell's last ball takes over the freed slot
+    uint32_t slot = slotOfBall[ball];
+    uint32_t last = --ends[cellOfBall[ball]];
+    uint32_t moved = sorted[last];
+    sorted[slot] = moved;
+    slotOfBall[moved] = slot;
+}
+
+void SpatialGrid::query(const Ball* balls, float x, float y, float radius, std::vector<uint32_t>& out) const {
+    int minX = clampCell(x - radius);
+    int maxX = clampCell(x + radius);
+    int minY = clampCell(y - radius);
+    int maxY = clampCell(y + radius);
+    float radiusSquared = radius * radius;
+    for (int cy = minY; cy <= maxY; ++cy) {
+        for (int cx = minX; cx <= maxX; ++cx) {
+            int cell = cy * side + cx;
+            for (uint32_t i = starts[cell]; i < ends[cell]; ++i) {
+                uint32_t index = sorted[i];
+                float dx = balls[index].x - x;
+                float dy = balls[index].y - y;
+                if (dx * dx + dy * dy <= radiusSquared) {
+                    out.push_back(index);
+                }
+            }
+        }
+    }
+}
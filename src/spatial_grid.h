@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "simulation.h"
+
+// Uniform grid over the square [-extent, extent]^2. build() buckets ball
+// indices by cell with a counting sort, so the balls of one cell are contiguous
+// in `entries` and a radius query only touches the cells its circle overlaps.
+// Every cell keeps a few spare slots so update() can move balls between cells
+// in place.
+class SpatialGrid {
+public:
+    explicit SpatialGrid(float extent = 1.0f, float cellSize = 0.05f);
+
+    // Changes the covered area or the cell size; the grid must be rebuilt
+    void reset(float extent, float cellSize);
+
+    // Buckets balls[0, count). Balls outside the square land in the border cells.
+    void build(const Ball* balls, size_t count);
+
+    // Brings the grid up to date with balls[0, count), moving only the balls
+    // whose cell changed since the last build() or update(); new balls are
+    // the ones past the previous count. Falls back to build() when the count
+    // shrank, when too many balls changed cell or when a cell runs out of
+    // spare slots. Returns true when it rebuilt. Afterwards the balls of a
+    // cell are no longer in index order.
+    bool update(const Ball* balls, size_t count);
+
+    // Balls update() moved or added, or every ball after a rebuild
+    size_t lastChanged() const { return changedCount; }
+
+    // Appends the indices of the balls whose centers lie within `radius` of (x, y).
+    // `balls` must be the array the grid was built from.
+    void query(const Ball* balls, float x, float y, float radius, std::vector<uint32_t>& out) const;
+
+    int cellOf(float x, float y) const;
+    int cellsPerSide() const { return side; }
+    float getCellSize() const { return cellSize; }
+
+    // Balls of a cell are entries()[cellStart(cell), cellEnd(cell))
+    uint32_t cellStart(int cell) const { return starts[cell]; }
+    uint32_t cellEnd(int cell) const { return ends[cell]; }
+    const uint32_t* entries() const { return sorted.data(); }
+
+private:
+    int clampCell(float coordinate) const;
+    bool insert(uint32_t ball, uint32_t cell);
+    void remove(uint32_t ball);
+
+    float extent = 0.0f;
+    float cellSize = 0.0f;
+    float inverseCellSize = 0.0f;
+    int side = 0;
+    bool built = false;
+    std::vector<uint32_t> starts;       // side * side + 1 offsets into `sorted`; a cell owns [start, next start)
+    std::vector<uint32_t> ends;         // End of each cell's used slots
+    std::vector<uint32_t> sorted;       // Ball indices in cell order, with spare slots after each cell
+    std::vector<uint32_t> cellOfBall;   // Cell each ball was filed under
+    std::vector<uint32_t> slotOfBall;   // Its position in `sorted`
+    std::vector<uint32_t> changed;      // Scratch for update()
+    size_t changedCount = 0;
+};
@@ -0,0 +1,107 @@
+#include "species.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <fmt/core.h>
+
+SimParams Species::apply(SimParams params) const {
+    params.gravity *= gravityScale;
+    params.duplicateMomentum = duplicateMomentum;
+    params.momentumIncrement = momentumIncrement;
+    params.duplicateOnHit = duplicates;
+    params.palette = palette;
+    return params;
+}
+
+Species speciesPreset(const std::string& name) {
+    Species species;
+    species.name = name;
+    if (name == "classic") {
+        return species;
+    }
+    if (name == "floaty") {
+        species.gravityScale = 0.35f;
+        species.duplicateMomentum = 0.9f;
+        species.momentumIncrement = 0.02f;
+        species.palette = { { { 0.2f, 0.4f, 1.0f }, { 0.0f, 0.8f, 1.0f }, { 0.7f, 1.0f, 1.0f }, { 0.6f, 0.3f, 1.0f } } };
+        return species;
+    }
+    if (name == "heavy") {
+        species.gravityScale = 2.0f;
+        species.duplicateMomentum = 0.8f;
+        species.momentumIncrement = 0.08f;
+        species.palette = { { { 0.6f, 0.0f, 0.0f }, { 1.0f, 0.4f, 0.0f }, { 1.0f, 0.9f, 0.0f }, { 1.0f, 1.0f, 0.8f } } };
+        return species;
+    }
+    if (name == "sterile") {
+        species.duplicates = false;
+        species.momentumIncrement = 0.0f;
+        species.palette = { { { 0.9f, 0.9f, 0.9f }, { 0.7f, 0.7f, 0.7f }, { 0.5f, 0.5f, 0.5f }, { 0.3f, 0.3f, 0.3f } } };
+        return species;
+    }
+    throw std::runtime_error(fmt::format("Unknown species {}; expected classic, floaty, heavy or sterile", name));
+}
+
+std::vector<Species> parseSpecies(const std::string& list) {
+    std::vector<Species> species;
+    size_t begin = 0;
+    while (begin <= list.size()) {
+        size_t end = list.find(',', begin);
+        end = end == std::string::npos ? list.size() : end;
+        std::string entry = list.substr(begin, end - begin);
+        size_t colon = entry.find(':');
+        Species preset = speciesPreset(entry.substr(0, colon));
+        // Each species has its own slabs and metrics, keyed by name
+        for (const auto& s : species) {
+            if (s.name == preset.name) {
+                throw std::runtime_error(fmt::format("Species {} is listed twice", preset.name));
+            }
+        }
+        if (colon != std::string::npos) {
+            preset.spawnShare = std::stof(entry.substr(colon + 1));
+            if (!(preset.spawnShare >= 0.0f)) {
+                throw std::runtime_error(fmt::format("Bad spawn share in {}", entry));
+            }
+        }
+        species.push_back(preset);
+        begin = end + 1;
+    }
+    return species;
+}
+
+std::vector<size_t> splitByShare(size_t count, const std::vector<Species>& species) {
+    std::vector<size_t> counts(species.size(), 0);
+    double total = 0.0;
+    for (const auto& s : species) {
+        total += s.spawnShare;
+    }
+    if (species.empty() || total <= 0.0) {
+        if (!species.empty()) {
+            counts[0] = count;
+        }
+        return counts;
+    }
+
+    std::vector<double> fractions(species.size());
+    size_t assigned = 0;
+    for (size_t i = 0; i < species.size(); ++i) {
+        double exact = static_cast<double>(count) * species[i].spawnShare / total;
+        counts[i] = static_cast<size_t>(std::floor(exact));
+        fractions[i] = exact - static_cast<double>(counts[i]);
+        assigned += counts[i];
+    }
+    // Ties go to the earlier species, so the split is the same on every run
+    while (assigned < count) {
+        size_t best = 0;
+        for (size_t i = 1; i < species.size(); ++i) {
+            if (fractions[i] > fractions[best]) {
+                best = i;
+            }
+        }
+        counts[best]++;
+        fractions[best] = -1.0;
+        assigned++;
+    }
+    return counts;
+}
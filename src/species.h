@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "simulation.h"
+
+// Rule set shared by every ball of a species. Balls of one species live in
+// their own slabs, so kernels run on one species at a time with its rules as
+// loop constants.
+struct Species {
+    std::string name;
+    float gravityScale = 1.0f;
+    float duplicateMomentum = DUPLICATE_MOMENTUM;
+    float momentumIncrement = MOMENTUM_INCREMENT;
+    bool duplicates = true;   // Spawns a duplicate on every wall hit
+    float spawnShare = 1.0f;  // Relative share of new balls
+    Palette palette = RAINBOW;
+
+    // The tick's parameters with this species' rules applied
+    SimParams apply(SimParams params) const;
+};
+
+// Built-in species: classic (the original rules), floaty, heavy and sterile.
+// Throws for any other name.
+Species speciesPreset(const std::string& name);
+
+// Comma-separated preset names, each optionally followed by :SHARE, e.g.
+// "classic,heavy:0.5". Throws on unknown or repeated names and on bad shares.
+std::vector<Species> parseSpecies(const std::string& list);
+
+// Splits `count` over the species in proportion to their spawn shares,
+// handing the rounding remainder out by largest fraction
+std::vector<size_t> splitByShare(size_t count, const std::vector<Species>& species);
@@ -0,0 +1,68 @@
+#include "state_hash.h"
+
+#include <cmath>
+#include <cstring>
+#include <fmt/core.h>
+
+namespace {
+
+const uint64_t FNV_OFFSET = 0xcbf29ce484222325ull;
+const uint64_t FNV_PRIME = 0x100000001b3ull;
+
+uint64_t hashFloats(uint64_t hash, const Ball& ball) {
+    const float fields[] = { ball.x, ball.y, ball.dx, ball.dy, ball.r, ball.g, ball.b, ball.addedMomentum, ball.radius };
+    for (float field : fields) {
+        uint32_t bits;
+        std::memcpy(&bits, &field, sizeof(bits));
+        for (int byte = 0; byte < 4; ++byte) {
+            hash = (hash ^ ((bits >> (8 * byte)) & 0xffu)) * FNV_PRIME;
+        }
+    }
+    return hash;
+}
+
+bool sameField(float expected, float actual, float tolerance) {
+    if (tolerance == 0.0f) {
+        return std::memcmp(&expected, &actual, sizeof(float)) == 0;
+    }
+    return std::fabs(expected - actual) <= tolerance;
+}
+
+}
+
+uint64_t hashBalls(const Ball* balls, size_t count) {
+    uint64_t hash = FNV_OFFSET;
+    for (size_t i = 0; i < count; ++i) {
+        hash = hashFloats(hash, balls[i]);
+    }
+    return hash;
+}
+
+uint64_t hashStore(const BallStore& store) {
+    uint64_t hash = FNV_OFFSET;
+    for (const auto& slab : store.slabs) {
+        for (const auto& ball : slab.balls) {
+            hash = hashFloats(hash, ball);
+        }
+    }
+    return hash;
+}
+
+size_t firstDivergence(const Ball* expected, const Ball* actual, size_t count, float tolerance) {
+    for (size_t i = 0; i < count; ++i) {
+        const Ball& a = expected[i];
+        const Ball& b = actual[i];
+        if (!sameField(a.x, b.x, tolerance) || !sameField(a.y, b.y, tolerance)
+            || !sameField(a.dx, b.dx, tolerance) || !sameField(a.dy, b.dy, tolerance)
+            || !sameField(a.r, b.r, tolerance) || !sameField(a.g, b.g, tolerance) || !sameField(a.b, b.b, tolerance)
+            || !sameField(a.addedMomentum, b.addedMomentum, tolerance) || !sameField(a.radius, b.radius, tolerance)) {
+            return i;
+        }
+    }
+    return count;
+}
+
+std::string describeBall(const Ball& ball) {
+    return fmt::format("pos ({:.9g}, {:.9g}) vel ({:.9g}, {:.9g}) color ({:.9g}, {:.9g}, {:.9g}) momentum {:.9g} radius {:.9g}",
+        ball.x, ball.y, ball.dx, ball.dy, ball.r, ball.g, ball.b, ball.addedMomentum, ball.radius);
+}
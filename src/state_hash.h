@@ -0,0 +1,19 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "simulation.h"
+
+// Order-sensitive 64-bit hash of every field of every ball, bit for bit. Two
+// update paths that agree on the hash after each tick produced the same state.
+uint64_t hashBalls(const Ball* balls, size_t count);
+// Hash of all slabs in slab order, as if they were one array
+uint64_t hashStore(const BallStore& store);
+
+// Index of the first ball whose fields differ by more than `tolerance`
+// (0 = bit-exact), or `count` when the first `count` balls all agree
+size_t firstDivergence(const Ball* expected, const Ball* actual, size_t count, float tolerance);
+
+std::string describeBall(const Ball& ball);
@@ -0,0 +1,134 @@
+#include "thread_pool.h"
+
+#include <algorithm>
+
+#include "numa.h"
+
+namespace {
+
+thread_local int workerNode = -1;
+
+}
+
+ThreadPool::ThreadPool(unsigned workerCount, const NumaTopology* topology) {
+    std::vector<WorkerPlacement> placements(std::max(1u, workerCount));
+    if (topology) {
+        placeOnNodes(*topology, placements);
+    }
+    start(placements);
+}
+
+ThreadPool::ThreadPool(const std::vector<WorkerPlacement>& placements) {
+    start(placements.empty() ? std::vector<WorkerPlacement>(1) : placements);
+}
+
+void ThreadPool::start(const std::vector<WorkerPlacement>& placements) {
+    int nodes = 0;
+    for (const auto& placement : placements) {
+        nodes = std::max(nodes, placement.node + 1);
+    }
+    queues.resize(nodes + 1);
+
+    for (const auto& placement : placements) {
+        workers.emplace_back([this, placement] {
+            if (!placement.cpus.empty()) {
+                pinCurrentThread(placement.cpus);
+            }
+            workerNode = placement.node;
+            workerLoop(placement.node);
+        });
+    }
+}
+
+void ThreadPool::placeOnNodes(const NumaTopology& topology, std::vector<WorkerPlacement>& placements) {
+    // Interleave nodes CPU by CPU so every node gets workers in proportion to its CPU count
+    size_t round = 0;
+    size_t assigned = 0;
+    while (assigned < placements.size()) {
+        bool any = false;
+        for (size_t node = 0; node < topology.nodes.size() && assigned < placements.size(); ++node) {
+            if (round < topology.nodes[node].cpus.size()) {
+                placements[assigned].node = static_cast<int>(node);
+                placements[assigned].cpus = topology.nodes[node].cpus;
+                assigned++;
+                any = true;
+            }
+        }
+        // More workers than CPUs: start over from the first CPU of each node
+        round = any ? round + 1 : 0;
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    taskAvailable.notify_all();
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+unsigned ThreadPool::defaultWorkerCount() {
+    unsigned hardwareThreads = std::thread::hardware_concurrency();
+    return hardwareThreads > 1 ? hardwareThreads - 1 : 1;
+}
+
+int ThreadPool::currentWorkerNode() {
+    return workerNode;
+}
+
+void ThreadPool::enqueue(std::function<void()> task) {
+    enqueue(std::move(task), -1);
+}
+
+void ThreadPool::enqueue(std::function<void()> task, int node) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        size_t queue = node >= 0 && node < nodeCount() ? static_cast<size_t>(node) : queues.size() - 1;
+        queues[queue].push_back(std::move(task));
+        queuedCount++;
+    }
+    // Any idle worker may take it, so a targeted task never waits for a busy node
+    taskAvailable.notify_one();
+}
+
+bool ThreadPool::takeTask(int node, std::function<void()>& task) {
+    auto takeFrom = [&](size_t queue) {
+        if (queues[queue].empty()) {
+            return false;
+        }
+        task = std::move(queues[queue].front());
+        queues[queue].pop_front();
+        queuedCount--;
+        return true;
+    };
+
+    if (node >= 0 && takeFrom(static_cast<size_t>(node))) {
+        return true;
+    }
+    if (takeFrom(queues.size() - 1)) {
+        return true;
+    }
+    for (size_t queue = 0; queue + 1 < queues.size(); ++queue) {
+        if (takeFrom(queue)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void ThreadPool::workerLoop(int node) {
+    for (;;) {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            taskAvailable.wait(lock, [this] { return stopping || queuedCount > 0; });
+            if (!takeTask(node, task)) {
+                return;
+            }
+        }
+        task();
+    }
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+struct NumaTopology;
+
+// Where one worker runs: its NUMA node index (-1 for none) and the CPUs it is
+// pinned to (empty for unpinned)
+struct WorkerPlacement {
+    int node = -1;
+    std::vector<int> cpus;
+};
+
+class ThreadPool {
+public:
+    // With a topology, workers are spread over its nodes in proportion to their
+    // CPU counts and pinned to their node, and node-targeted tasks are preferred
+    // by that node's workers.
+    explicit ThreadPool(unsigned workerCount = defaultWorkerCount(), const NumaTopology* topology = nullptr);
+    explicit ThreadPool(const std::vector<WorkerPlacement>& placements);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // Queues a task for any worker.
+    void enqueue(std::function<void()> task);
+
+    // Queues a task for the workers of a node index. Workers drain their own
+    // node's queue and shared tasks first and only steal from other nodes when idle.
+    void enqueue(std::function<void()> task, int node);
+
+    unsigned size() const { return static_cast<unsigned>(workers.size()); }
+    int nodeCount() const { return static_cast<int>(queues.size()) - 1; }
+
+    // Node index the calling pool worker is bound to, or -1 outside a node-bound worker
+    static int currentWorkerNode();
+
+    // One worker per hardware thread, leaving one for the render thread.
+    static unsigned defaultWorkerCount();
+
+    // Binds each placement to a node in proportion to the nodes' CPU counts and
+    // pins it to that node's CPUs.
+    static void placeOnNodes(const NumaTopology& topology, std::vector<WorkerPlacement>& placements);
+
+private:
+    void start(const std::vector<WorkerPlacement>& placements);
+    void workerLoop(int node);
+    bool takeTask(int node, std::function<void()>& task);
+
+    std::vector<std::thread> workers;
+    std::vector<std::deque<std::function<void()>>> queues;  // One per node, then the shared queue
+    size_t queuedCount = 0;
+    std::mutex mutex;
+    std::condition_variable taskAvailable;
+    bool stopping = false;
+};